@@ -1,5 +1,6 @@
 #include "HairGenerics.hlsli"
 #include "HelperMethods.hlsli"
+#include "HairShared.h"
 struct ShaderVertex
 {
 	float3 Position;	    // The position of the vertex
@@ -12,48 +13,44 @@ struct ShaderVertex
 cbuffer HAIR_CONSTANT_BUFFER	: register(b0)
 {
 	float length;
-	float width;
+	int numOfStrands;
+	int vertsPerStrand;
+	float stateScale;		// See HairPacking.h
 }
 
-RWStructuredBuffer<HairStrand> hairData	: register(u0);
+RWStructuredBuffer<HairPackedVertex> hairData	: register(u0);
+RWStructuredBuffer<HairRestVertex> restData	: register(u1);
 StructuredBuffer<ShaderVertex> vertexData;
 
 
-[numthreads(8, 8, 1)]
+// One thread per strand vertex, the strand is a straight line along the normal
+[numthreads(64, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-	int index = DTid;
-	int cornerID = index % 5;
-	float3 offSets[5];
-	float2 UVs[5];
+	int index = DTid.x;
+	int strand = index / vertsPerStrand;
+	if (strand >= numOfStrands)
+		return;
+	int segmentID = index % vertsPerStrand;
+	float alongStrand = segmentID / (float)(vertsPerStrand - 1);
 
-	ShaderVertex currentVert = vertexData[index / 5];
-	float randomVariance = 1.0f + (random(UVs[cornerID]) * 0.3f - 0.15f);
+	ShaderVertex currentVert = vertexData[strand];
+
+	// Seeded per strand so every vertex of a strand agrees on its length
+	float randomVariance = 1.0f + (random(currentVert.UV) * 0.3f - 0.15f);
 	float lengthScalar = randomVariance * length;
 
 	float3 lengthVector = normalize(currentVert.Normal) * lengthScalar;
 
-	UVs[0] = float2(0, 0);
-	UVs[1] = float2(0, 0.5f);
-	UVs[2] = float2(1, 0);
-	UVs[3] = float2(1, 0.5f);
-	UVs[4] = float2(0.5f, 1);
-
-	offSets[0] = float3(-width / 2.0f, 0, 0.0f);
-	offSets[1] = float3(-width / 2.0f, 0, 0) + (lengthVector * 0.5f);
-	offSets[2] = float3(width / 2.0f, 0.0f, 0.0f);
-	offSets[3] = float3(width / 2.0f, 0, 0) + (lengthVector * 0.5f);
-	offSets[4] = lengthVector;
-
-
-	HairStrand newStrand;
-	newStrand.Position = currentVert.Position + offSets[cornerID];
-	newStrand.Normal = currentVert.Normal;
-	newStrand.UV = UVs[cornerID];
-	newStrand.Tangent = currentVert.Tangent;
-	newStrand.Speed = float3(0, 0, 0);
-	newStrand.Acceleration = float3(0, 0, 0);
-	newStrand.OriginalPosition = currentVert.Position + offSets[cornerID];
-
-	hairData[index] = newStrand;
-}
\ No newline at end of file
+	float3 position = currentVert.Position + lengthVector * alongStrand;
+
+	// The ribbon is built in HairVS, UV.x gets filled in there
+	HairRestVertex restInfo;
+	restInfo.OriginalPosition = position;
+	restInfo.Normal = currentVert.Normal;
+	restInfo.UV = float2(0, alongStrand);
+	restInfo.Tangent = currentVert.Tangent;
+
+	hairData[index] = HairPackVertex(position, position, currentVert.Position, stateScale);
+	restData[index] = restInfo;
+}
@@ -418,6 +418,7 @@ HRESULT DXCore::Run()
 
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
+	Shutdown();
 	return (HRESULT)msg.wParam;
 }
 
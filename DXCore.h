@@ -43,6 +43,8 @@ public:
 	virtual void Init() = 0;
 	virtual void Update(float deltaTime, float totalTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
+	// After the loop ends, while the device is still alive
+	virtual void Shutdown() {}
 
 protected:
 	HINSTANCE	hInstance;		// The handle to the application
@@ -21,6 +21,7 @@ Emitter::Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLif
 	startingVelocity = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 	acceleration = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 	velocityRange = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	windInfluence = 1.0f;
 
 	totalParticlesAmount = NumOfParticles;
 
@@ -163,6 +164,23 @@ void Emitter::UpdateParticle(int index, float time)
 	float lifeTime = particles[index].Time += time;
 	particles[index].Age = particles[index].Time / lifetimeOfParticle;
 
+	// ParticleVS moves particles analytically from where they started, so the
+	// wind's drift is added to the start position instead of the velocity
+	if (wind)
+	{
+		// Same as ParticleVS, which runs on Age
+		Particle& p = particles[index];
+		float t = p.Age;
+		DirectX::XMFLOAT3 current(
+			p.Position.x + p.Velocity.x * t + acceleration.x * t * t / 2.0f,
+			p.Position.y + p.Velocity.y * t + acceleration.y * t * t / 2.0f,
+			p.Position.z + p.Velocity.z * t + acceleration.z * t * t / 2.0f);
+		DirectX::XMFLOAT3 windVelocity = wind->Sample(current);
+		p.Position.x += windVelocity.x * windInfluence * time;
+		p.Position.y += windVelocity.y * windInfluence * time;
+		p.Position.z += windVelocity.z * windInfluence * time;
+	}
+
 	if (lifeTime >= lifetimeOfParticle)
 	{
 		firstLiveIndex++;
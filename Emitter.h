@@ -5,6 +5,7 @@
 #include "Camera.h"
 #include <wrl/client.h>
 #include "SimpleShader.h"
+#include "WindField.h"
 #include <memory>
 
 struct Particle
@@ -43,6 +44,9 @@ private:
 	DirectX::XMFLOAT3 acceleration;
 	DirectX::XMFLOAT3 velocityRange;
 
+	std::shared_ptr<WindField> wind;
+	float windInfluence;
+
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 
@@ -65,6 +69,8 @@ public:
 	void SetStartingVelocity(DirectX::XMFLOAT3 newStartingVel) { startingVelocity = newStartingVel; }
 	void SetAcceleration(DirectX::XMFLOAT3 newAcceleration) { acceleration = newAcceleration; }
 	void SetVelocityRange(DirectX::XMFLOAT3 newVelocityRange) { velocityRange = newVelocityRange; }
+	// Live particles drift with the wind, influence 1 = carried at the full wind speed
+	void SetWindField(std::shared_ptr<WindField> newWind, float influence = 1.0f) { wind = newWind; windInfluence = influence; }
 
 	Transform* GetTransform() { return myTransform; }
 };
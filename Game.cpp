@@ -1,6 +1,7 @@
 
 #include <stdlib.h>     // For seeding random and rand()
 #include <time.h>       // For grabbing time (to seed random)
+#include <unordered_set>
 
 #include "Game.h"
 #include "Vertex.h"
@@ -77,6 +78,26 @@ Game::~Game()
 	delete &Assets::GetInstance();
 }
 
+// --------------------------------------------------------
+// Called once the game loop has ended, before the
+// destructor. Writes anything regrown or repainted this
+// run, so the next start maps its groom straight in.
+// Entities share meshes, each one is baked once.
+// --------------------------------------------------------
+void Game::Shutdown()
+{
+	std::unordered_set<Mesh*> baked;
+	for (auto& entity : entities)
+	{
+		std::shared_ptr<Mesh> mesh = entity->GetMesh();
+		if (entity->GetHair() && mesh->GetHairGroomDirty() && baked.insert(mesh.get()).second)
+		{
+			printf("Baking hair groom for %s\n", mesh->GetHairGroomPath().c_str());
+			mesh->BakeHairGroom(device, context);
+		}
+	}
+}
+
 // --------------------------------------------------------
 // Called once per program, after DirectX and the window
 // are initialized but before the game loop.
@@ -102,7 +123,9 @@ void Game::Init()
 		3.0f,		// Move speed
 		1.0f,		// Mouse look
 		this->width / (float)this->height); // Aspect ratio
-	DXRenderer = std::make_unique<Renderer>(device, context, swapChain, backBufferRTV, depthStencilView, width, height, sky, terrain, entities, emitter, lights, hWnd);
+	DXRenderer = std::make_unique<Renderer>(device, context, swapChain, backBufferRTV, depthStencilView, width, height, sky, terrain, windField, entities, emitter, lights, hWnd);
+	DXRenderer->CreateHairShading(GetFullPathTo("HairShading.lut"));
+	DXRenderer->SetHairRegressionFolder(GetFullPathTo("../../Assets/Models/"));
 }
 
 
@@ -385,6 +408,10 @@ void Game::LoadAssetsAndCreateEntities()
 	emitter.push_back(testEmitter2);
 	emitter.push_back(testEmitter3);
 
+	windField = std::make_shared<WindField>(device, context);
+	for (auto e : emitter)
+		e->SetWindField(windField);
+
 	for (auto e : entities)
 	{
 		e->CreateHair(device, context);
@@ -514,9 +541,18 @@ void Game::Update(float deltaTime, float totalTime)
 		currentForce.x = 1.0f;
 	else if (input.KeyDown(VK_LEFT))
 		currentForce.x = -1.0f;
+
+	// Scroll the wind once, everything below samples the same field
+	windField->Update(deltaTime, camera->GetTransform()->GetPosition());
+
+	// Pick hair detail from how big each entity is on screen before simulating.
+	// Every entity has its own hair state, even when the groom is shared with others
 	for (auto e : entities) {
-		if (e->GetMesh()->GetHasFur()) {
-			e->GetMesh()->SimulateHair(context, device, deltaTime, currentForce);
+		std::shared_ptr<HairInstance> hair = e->GetHair();
+		if (hair) {
+			e->GetMesh()->ResetHairLOD(*hair);
+			e->GetMesh()->RequestHairLOD(*hair, e->GetTransform()->GetWorldMatrix(), camera->GetView(), camera->GetProjection());
+			e->GetMesh()->SimulateHair(context, *hair, deltaTime, currentForce, e->GetTransform()->GetWorldMatrix(), e->GetTransform()->GetPreviousWorldMatrix(), windField);
 		}
 	}
 
@@ -12,6 +12,7 @@
 #include "Renderer.h"
 #include "Emitter.h"
 #include "Terrain.h"
+#include "WindField.h"
 
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
@@ -31,6 +32,7 @@ public:
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
+	void Shutdown();
 
 private:
 
@@ -56,6 +58,9 @@ private:
 	std::shared_ptr<Sky> sky;
 	std::shared_ptr<Terrain> terrain;
 
+	// One wind field for every furred entity and emitter
+	std::shared_ptr<WindField> windField;
+
 	// General helpers for setup and drawing
 	void GenerateLights();
 
@@ -16,6 +16,7 @@ void GameEntity::SetMaterial(std::shared_ptr<Material> newMaterial)
 	material = newMaterial;
 }
 Transform* GameEntity::GetTransform() { return &transform; }
+std::shared_ptr<HairInstance> GameEntity::GetHair() { return hair; }
 
 
 void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
@@ -31,5 +32,5 @@ void GameEntity::CreateHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microso
 {
 	if (!mesh->GetHasFur())
 		return;
-	mesh->SetBuffersAndCreateHair(device, context);
+	hair = mesh->CreateHairInstance(device, context);
 }
@@ -17,6 +17,8 @@ public:
 	std::shared_ptr<Material> GetMaterial();
 	void SetMaterial(std::shared_ptr<Material> newMaterial);
 	Transform* GetTransform();
+	// Null unless the mesh has fur and CreateHair was called
+	std::shared_ptr<HairInstance> GetHair();
 
 	virtual void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
 	void CreateHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
@@ -25,6 +27,7 @@ private:
 
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	std::shared_ptr<HairInstance> hair;	// The mesh holds the groom, this is only what this entity simulates
 	Transform transform;
 };
 
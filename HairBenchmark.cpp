@@ -0,0 +1,126 @@
+#include "HairBenchmark.h"
+#include "HairVoxelGrid.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+unsigned int HairBenchmark::GetBytesPerStrand(int vertsPerStrand)
+{
+	// Packed state in and out as the GPU ring holds it, plus the original position from the rest stream
+	unsigned int bytesPerVertex = sizeof(HairPackedVertex) * 2 + sizeof(XMFLOAT3);
+	return bytesPerVertex * vertsPerStrand;
+}
+
+unsigned int HairBenchmark::GetAoSBytesPerStrand(int vertsPerStrand)
+{
+	// The whole interleaved struct was read and written back
+	return aosHairStrandSize * 2 * vertsPerStrand;
+}
+
+HairBenchmarkResult HairBenchmark::Run(int numOfStrands, int steps, int vertsPerStrand)
+{
+	vertsPerStrand = std::min(std::max(vertsPerStrand, 2), HAIR_MAX_VERTS_PER_STRAND);
+
+	// Pushed sideways so nothing comes to rest
+	std::vector<HairSimVertex> simData;
+	std::vector<HairRestVertex> restData;
+	CreateTestGroom(numOfStrands, vertsPerStrand, simData, restData);
+
+	HairSolverSettings settings = HairSimulator::GetDefaultSettings();
+	HairExternalForces forces = {};
+	forces.Force = XMFLOAT3(1.0f, 0, 0);
+
+	// Around the whole row, with room for it to swing
+	std::vector<int> allStrands(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		allStrands[i] = i;
+	float rowLength = numOfStrands * 0.01f;
+	float strandLength = (vertsPerStrand - 1) * 0.1f;
+	HairVoxelGrid voxels;
+	voxels.SetBounds(XMFLOAT3(rowLength * 0.5f, strandLength * 0.5f, 0), std::max(rowLength, strandLength) * 0.5f + strandLength);
+
+	std::chrono::duration<double, std::milli> solverTime(0);
+	std::chrono::duration<double, std::milli> voxelTime(0);
+	for (int i = 0; i < steps; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		voxels.Splat(&simData[0], allStrands.data(), numOfStrands, vertsPerStrand, 1.0f / 60.0f);
+		voxels.Apply(&simData[0], allStrands.data(), numOfStrands, vertsPerStrand, settings, 1.0f / 60.0f);
+		auto middle = std::chrono::high_resolution_clock::now();
+		HairSimulator::Simulate(&simData[0], &restData[0], numOfStrands, vertsPerStrand, settings, forces, 1.0f / 60.0f);
+		auto end = std::chrono::high_resolution_clock::now();
+		voxelTime += middle - start;
+		solverTime += end - middle;
+	}
+
+	HairBenchmarkResult result = {};
+	result.numOfStrands = numOfStrands;
+	result.vertsPerStrand = vertsPerStrand;
+	result.steps = steps;
+	result.millisecondsPerStep = solverTime.count() / std::max(steps, 1);
+	result.voxelMillisecondsPerStep = voxelTime.count() / std::max(steps, 1);
+	result.bytesPerStrand = GetBytesPerStrand(vertsPerStrand);
+	result.aosBytesPerStrand = GetAoSBytesPerStrand(vertsPerStrand);
+	return result;
+}
+
+HairQuantizationResult HairBenchmark::MeasureQuantization(int numOfStrands, int steps, int vertsPerStrand)
+{
+	vertsPerStrand = std::min(std::max(vertsPerStrand, 2), HAIR_MAX_VERTS_PER_STRAND);
+
+	std::vector<HairSimVertex> reference;
+	std::vector<HairRestVertex> restData;
+	CreateTestGroom(numOfStrands, vertsPerStrand, reference, restData);
+	std::vector<HairSimVertex> quantized = reference;
+	float scale = (vertsPerStrand - 1) * 0.1f * HAIR_PACKED_POSITION_RANGE;
+
+	// Pushed one way then the other so the motion goes through its whole range
+	HairSolverSettings settings = HairSimulator::GetDefaultSettings();
+	HairExternalForces forces = {};
+	HairQuantizationResult result = {};
+	for (int i = 0; i < steps; i++)
+	{
+		forces.Force = XMFLOAT3((i / 30) % 2 ? -1.0f : 1.0f, 0, 0.5f);
+		HairSimulator::Simulate(&reference[0], &restData[0], numOfStrands, vertsPerStrand, settings, forces, HAIR_FIXED_TIMESTEP);
+		HairSimulator::Simulate(&quantized[0], &restData[0], numOfStrands, vertsPerStrand, settings, forces, HAIR_FIXED_TIMESTEP);
+
+		double errorSum = 0;
+		for (int v = 0; v < (int)quantized.size(); v++)
+		{
+			const XMFLOAT3& root = restData[v - v % vertsPerStrand].OriginalPosition;
+			quantized[v] = HairUnpackVertex(HairPackVertex(quantized[v].Position, quantized[v].PreviousPosition, root, scale), root, scale);
+
+			float error = XMVectorGetX(XMVector3Length(XMLoadFloat3(&quantized[v].Position) - XMLoadFloat3(&reference[v].Position)));
+			result.maxPositionError = std::max(result.maxPositionError, error);
+			errorSum += error;
+		}
+		result.meanPositionError = (float)(errorSum / std::max((int)quantized.size(), 1));
+	}
+
+	result.numOfStrands = numOfStrands;
+	result.vertsPerStrand = vertsPerStrand;
+	result.steps = steps;
+	result.scale = scale;
+	result.packedBytesPerVertex = sizeof(HairPackedVertex);
+	result.floatBytesPerVertex = sizeof(HairSimVertex);
+	return result;
+}
+
+void HairBenchmark::CreateTestGroom(int numOfStrands, int vertsPerStrand, std::vector<HairSimVertex>& simData, std::vector<HairRestVertex>& restData)
+{
+	simData.resize(numOfStrands * vertsPerStrand);
+	restData.resize(numOfStrands * vertsPerStrand);
+	for (int i = 0; i < (int)simData.size(); i++)
+	{
+		int strand = i / vertsPerStrand;
+		int segment = i % vertsPerStrand;
+		restData[i] = {};
+		restData[i].OriginalPosition = XMFLOAT3(strand * 0.01f, segment * 0.1f, 0);
+		restData[i].Normal = XMFLOAT3(0, 1, 0);
+		simData[i] = {};
+		simData[i].Position = restData[i].OriginalPosition;
+		simData[i].PreviousPosition = restData[i].OriginalPosition;
+	}
+}
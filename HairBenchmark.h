@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "HairSimulator.h"
+
+// Timing and memory traffic of a CPU simulation run
+struct HairBenchmarkResult
+{
+	int numOfStrands;
+	int vertsPerStrand;
+	int steps;
+	double millisecondsPerStep;
+	double voxelMillisecondsPerStep;	// Splatting and applying the HairVoxelGrid, on top of the solver
+	unsigned int bytesPerStrand;		// Moved per strand per step with the hot/cold split
+	unsigned int aosBytesPerStrand;	// What the old single HairStrand struct moved
+};
+
+// How far the packed state ring drifts from full floats
+struct HairQuantizationResult
+{
+	int numOfStrands;
+	int vertsPerStrand;
+	int steps;
+	float scale;					// Of the packed offsets, see HairPacking.h
+	float maxPositionError;			// Worst any vertex got over the whole run
+	float meanPositionError;		// Over every vertex after the last step
+	unsigned int packedBytesPerVertex;
+	unsigned int floatBytesPerVertex;
+};
+
+// --------------------------------------------------------
+// Measurements of the CPU hair solver on a synthetic groom
+//
+// Each of these runs for seconds, so call them off the
+// UI thread. Nothing here touches a device.
+// --------------------------------------------------------
+class HairBenchmark
+{
+public:
+	// Simulates a synthetic groom on the CPU and reports time and bandwidth per strand
+	static HairBenchmarkResult Run(int numOfStrands, int steps, int vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1);
+	// Simulates the synthetic groom twice, once packing and unpacking the state after every
+	// step like the GPU ring does, and compares the two
+	static HairQuantizationResult MeasureQuantization(int numOfStrands, int steps, int vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1);
+
+	// Bytes one simulation step reads and writes for a single strand
+	static unsigned int GetBytesPerStrand(int vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1);
+	static unsigned int GetAoSBytesPerStrand(int vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1);
+
+	// A row of strands pointing up, 0.1 long segments
+	static void CreateTestGroom(int numOfStrands, int vertsPerStrand, std::vector<HairSimVertex>& simData, std::vector<HairRestVertex>& restData);
+
+private:
+	// Size of the old interleaved HairStrand (every member a float, 17 of them)
+	static const unsigned int aosHairStrandSize = 17 * sizeof(float);
+};
@@ -0,0 +1,220 @@
+#include "HairClusters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Spreads the low 10 bits out to every third bit
+static unsigned int SpreadBits(unsigned int x)
+{
+	x &= 0x3FF;
+	x = (x | (x << 16)) & 0x030000FF;
+	x = (x | (x << 8)) & 0x0300F00F;
+	x = (x | (x << 4)) & 0x030C30C3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+HairClusters::HairClusters() :
+	clusterSize(HAIR_CLUSTER_STRANDS)
+{
+}
+
+void HairClusters::SortStrands(const XMFLOAT3* roots, int numOfStrands, std::vector<int>& order)
+{
+	order.resize(numOfStrands);
+	if (numOfStrands == 0)
+		return;
+
+	XMVECTOR rootMin = XMLoadFloat3(&roots[0]);
+	XMVECTOR rootMax = rootMin;
+	for (int i = 1; i < numOfStrands; i++)
+	{
+		rootMin = XMVectorMin(rootMin, XMLoadFloat3(&roots[i]));
+		rootMax = XMVectorMax(rootMax, XMLoadFloat3(&roots[i]));
+	}
+	XMVECTOR toGrid = XMVectorReciprocal(XMVectorMax(rootMax - rootMin, XMVectorReplicate(FLT_EPSILON))) * 1023.0f;
+
+	// 10 bits an axis, stable so strands on the same code keep their sampled order
+	std::vector<unsigned int> codes(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+	{
+		XMFLOAT3 cell;
+		XMStoreFloat3(&cell, (XMLoadFloat3(&roots[i]) - rootMin) * toGrid);
+		codes[i] = SpreadBits((unsigned int)cell.x) | (SpreadBits((unsigned int)cell.y) << 1) | (SpreadBits((unsigned int)cell.z) << 2);
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&codes](int a, int b) { return codes[a] < codes[b]; });
+}
+
+void HairClusters::Build(const XMFLOAT3* roots, const XMFLOAT3* normals, int numOfStrands, float reach, int clusterSize)
+{
+	this->clusterSize = std::max(clusterSize, 1);
+	int count = (numOfStrands + this->clusterSize - 1) / this->clusterSize;
+	clusters.resize(count);
+	visibility.assign(count, 1);
+	lastVisibility.assign(count, 1);
+
+	for (int c = 0; c < count; c++)
+	{
+		HairCluster& cluster = clusters[c];
+		cluster.FirstStrand = c * this->clusterSize;
+		cluster.NumOfStrands = std::min(this->clusterSize, numOfStrands - cluster.FirstStrand);
+
+		XMVECTOR rootMin = XMLoadFloat3(&roots[cluster.FirstStrand]);
+		XMVECTOR rootMax = rootMin;
+		XMVECTOR normalSum = XMVectorZero();
+		for (int i = cluster.FirstStrand; i < cluster.FirstStrand + cluster.NumOfStrands; i++)
+		{
+			rootMin = XMVectorMin(rootMin, XMLoadFloat3(&roots[i]));
+			rootMax = XMVectorMax(rootMax, XMLoadFloat3(&roots[i]));
+			normalSum += XMLoadFloat3(&normals[i]);
+		}
+		XMVECTOR center = (rootMin + rootMax) * 0.5f;
+		XMStoreFloat3(&cluster.Center, center);
+		cluster.Radius = XMVectorGetX(XMVector3Length(rootMax - center)) + reach;
+
+		// The cone has to hold every normal, opposing normals can't face away together
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		float minDot = 1.0f;
+		for (int i = cluster.FirstStrand; i < cluster.FirstStrand + cluster.NumOfStrands; i++)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, XMVector3Normalize(XMLoadFloat3(&normals[i])))));
+		XMStoreFloat3(&cluster.ConeAxis, axis);
+		cluster.ConeCutoff = minDot <= 0 || XMVectorGetX(XMVector3LengthSq(normalSum)) == 0 ? 1.0f : sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+void HairClusters::UpdateBounds(const HairSimVertex* simData, int vertsPerStrand, float margin)
+{
+	std::vector<HairClusterBounds> bounds(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+		int first = clusters[c].FirstStrand * vertsPerStrand;
+		int last = first + clusters[c].NumOfStrands * vertsPerStrand;
+		for (int v = first; v < last; v++)
+		{
+			boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&simData[v].Position));
+			boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&simData[v].Position));
+		}
+		XMStoreFloat3(&bounds[c].Min, boundsMin);
+		XMStoreFloat3(&bounds[c].Max, boundsMax);
+	}
+	UpdateBounds(bounds.data(), margin);
+}
+
+void HairClusters::UpdateBounds(const HairClusterBounds* bounds, float margin)
+{
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		XMVECTOR boundsMin = XMLoadFloat3(&bounds[c].Min);
+		XMVECTOR boundsMax = XMLoadFloat3(&bounds[c].Max);
+		XMVECTOR center = (boundsMin + boundsMax) * 0.5f;
+		XMStoreFloat3(&clusters[c].Center, center);
+		clusters[c].Radius = XMVectorGetX(XMVector3Length(boundsMax - center)) + margin;
+	}
+}
+
+void HairClusters::ResetVisibility()
+{
+	lastVisibility.swap(visibility);
+	visibility.assign(clusters.size(), 0);
+}
+
+void HairClusters::AddView(XMFLOAT4X4 world, XMFLOAT4X4 view, XMFLOAT4X4 projection, bool cullBackfacing)
+{
+	// Frustum planes straight out of the combined matrix (Gribb & Hartmann), so they're in object space.
+	// Row vectors, so the planes come from its columns
+	XMMATRIX worldView = XMLoadFloat4x4(&world) * XMLoadFloat4x4(&view);
+	XMMATRIX columns = XMMatrixTranspose(worldView * XMLoadFloat4x4(&projection));
+	XMVECTOR planes[6] =
+	{
+		columns.r[3] + columns.r[0],
+		columns.r[3] - columns.r[0],
+		columns.r[3] + columns.r[1],
+		columns.r[3] - columns.r[1],
+		columns.r[2],
+		columns.r[3] - columns.r[2]
+	};
+	for (int p = 0; p < 6; p++)
+		planes[p] = planes[p] / XMVector3Length(planes[p]);
+
+	XMVECTOR camera = XMMatrixInverse(0, worldView).r[3];
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		if (visibility[c])
+			continue;
+		const HairCluster& cluster = clusters[c];
+		XMVECTOR center = XMVectorSetW(XMLoadFloat3(&cluster.Center), 1.0f);
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+			inside = XMVectorGetX(XMVector4Dot(planes[p], center)) >= -cluster.Radius;
+		if (!inside)
+			continue;
+
+		// Every root's surface faces away from anywhere in the sphere, so the mesh is in front of it
+		if (cullBackfacing && cluster.ConeCutoff < 1.0f)
+		{
+			XMVECTOR toCluster = XMVectorSetW(center - camera, 0);
+			float along = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&cluster.ConeAxis)));
+			if (along >= cluster.ConeCutoff * XMVectorGetX(XMVector3Length(toCluster)) + cluster.Radius)
+				continue;
+		}
+		visibility[c] = 1;
+	}
+}
+
+void HairClusters::ShowAll()
+{
+	visibility.assign(clusters.size(), 1);
+}
+
+bool HairClusters::CameIntoView()
+{
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		if (visibility[c] && !lastVisibility[c])
+			return true;
+	}
+	return false;
+}
+
+void HairClusters::GetVisibleRuns(const std::vector<int>& guideStrands, int drawStep, std::vector<HairStrandRun>& runs)
+{
+	runs.clear();
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		if (!visibility[c])
+			continue;
+
+		int first = clusters[c].FirstStrand;
+		int end = first + clusters[c].NumOfStrands;
+		if (drawStep > 0)
+		{
+			// Drawn slot s is guide s * drawStep, so the slots of the guides inside the cluster
+			int firstGuide = (int)(std::lower_bound(guideStrands.begin(), guideStrands.end(), first) - guideStrands.begin());
+			int endGuide = (int)(std::lower_bound(guideStrands.begin(), guideStrands.end(), end) - guideStrands.begin());
+			first = (firstGuide + drawStep - 1) / drawStep;
+			end = (endGuide + drawStep - 1) / drawStep;
+		}
+		if (end <= first)
+			continue;
+
+		if (!runs.empty() && runs.back().First + runs.back().Count == first)
+			runs.back().Count += end - first;
+		else
+			runs.push_back({ first, end - first });
+	}
+}
+
+int HairClusters::GetVisibleCount()
+{
+	int count = 0;
+	for (unsigned int visible : visibility)
+		count += visible ? 1 : 0;
+	return count;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "HairStrand.h"
+#include "HairShared.h"
+#include "HairPacking.h"
+
+// One group of neighbouring strands, culled as a whole
+struct HairCluster
+{
+	int FirstStrand;
+	int NumOfStrands;
+	DirectX::XMFLOAT3 Center;		// Bounding sphere of every vertex, object space
+	float Radius;
+	DirectX::XMFLOAT3 ConeAxis;		// Average surface normal at the roots
+	float ConeCutoff;				// Sine of the normals' spread from the axis, 1 = never faces away
+};
+
+// What UpdateHairClusters.hlsl writes per cluster, must match it
+struct HairClusterBounds
+{
+	DirectX::XMFLOAT3 Min;
+	float Padding0;
+	DirectX::XMFLOAT3 Max;
+	float Padding1;
+};
+
+// A run of drawn strands (see HairRibbon.h) from visible clusters next to each other
+struct HairStrandRun
+{
+	int First;
+	int Count;
+};
+
+// --------------------------------------------------------
+// Strands grouped into clusters of neighbours for culling
+//
+// Strands are sorted along a Morton curve of their roots once,
+// when the groom is made, so every cluster is a contiguous
+// range of strand indices and the GPU finds a strand's cluster
+// by dividing. Only depends on DirectXMath so it can be tested
+// headless like HairSimulator.
+// --------------------------------------------------------
+class HairClusters
+{
+public:
+	HairClusters();
+
+	// Order to put the strands in so neighbours end up in the same cluster, order[new index] = old index
+	static void SortStrands(const DirectX::XMFLOAT3* roots, int numOfStrands, std::vector<int>& order);
+
+	// Every clusterSize strands in a row become a cluster. Until the first UpdateBounds the spheres
+	// cover the roots grown by reach, the furthest any vertex gets from its root
+	void Build(const DirectX::XMFLOAT3* roots, const DirectX::XMFLOAT3* normals, int numOfStrands, float reach, int clusterSize = HAIR_CLUSTER_STRANDS);
+
+	// Refits the spheres around the simulated vertices, grown by margin to cover the time until the next update
+	void UpdateBounds(const HairSimVertex* simData, int vertsPerStrand, float margin);
+	void UpdateBounds(const HairClusterBounds* bounds, float margin);
+
+	// Everything visible to nobody yet, then each view adds what it can see. Outside the frustum,
+	// or facing away from the camera on the far side of the mesh, is culled
+	void ResetVisibility();
+	void AddView(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection, bool cullBackfacing = true);
+	void ShowAll();
+	// Whether any cluster culled before the last reset is visible now
+	bool CameIntoView();
+
+	// drawStep = every drawStep'th guide is drawn, 0 = every strand. Guides have to be sorted by strand
+	void GetVisibleRuns(const std::vector<int>& guideStrands, int drawStep, std::vector<HairStrandRun>& runs);
+
+	int GetClusterCount() { return (int)clusters.size(); }
+	int GetClusterSize() { return clusterSize; }
+	int GetVisibleCount();
+	const HairCluster& GetCluster(int cluster) { return clusters[cluster]; }
+	// One per cluster, 0 = culled. What SimulateHair.hlsl reads
+	const std::vector<unsigned int>& GetVisibility() { return visibility; }
+
+private:
+	std::vector<HairCluster> clusters;
+	std::vector<unsigned int> visibility;
+	std::vector<unsigned int> lastVisibility;	// Before the last reset, to see what came into view
+	int clusterSize;
+};
@@ -0,0 +1,236 @@
+#include "HairCollisionField.h"
+#include "HairHash.h"
+#include "HairShared.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace DirectX;
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static XMVECTOR ClosestPointOnTriangle(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c)
+{
+	XMVECTOR ab = b - a;
+	XMVECTOR ac = c - a;
+	XMVECTOR ap = p - a;
+	float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+	float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+
+	XMVECTOR bp = p - b;
+	float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+	float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+	if (d3 >= 0 && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + ab * (d1 / (d1 - d3));
+
+	XMVECTOR cp = p - c;
+	float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+	float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+	if (d6 >= 0 && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Solid angle of triangle abc seen from p (Van Oosterom and Strackee), summed over a
+// closed mesh it's 4 pi inside and 0 outside
+static float SolidAngle(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b, GXMVECTOR c)
+{
+	XMVECTOR ra = a - p;
+	XMVECTOR rb = b - p;
+	XMVECTOR rc = c - p;
+	float la = XMVectorGetX(XMVector3Length(ra));
+	float lb = XMVectorGetX(XMVector3Length(rb));
+	float lc = XMVectorGetX(XMVector3Length(rc));
+	float numerator = XMVectorGetX(XMVector3Dot(ra, XMVector3Cross(rb, rc)));
+	float denominator = la * lb * lc + XMVectorGetX(XMVector3Dot(ra, rb)) * lc + XMVectorGetX(XMVector3Dot(rb, rc)) * la + XMVectorGetX(XMVector3Dot(rc, ra)) * lb;
+	return 2.0f * atan2f(numerator, denominator);
+}
+
+HairCollisionField::HairCollisionField() :
+	resolution(0),
+	padding(0),
+	surfaceHash(0),
+	boundsMin(0, 0, 0),
+	cellSize(0),
+	bakeMilliseconds(0)
+{
+}
+
+void HairCollisionField::Bake(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, int resolution, float padding, int threads)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	this->resolution = std::max(resolution, 2);
+	this->padding = padding;
+	surfaceHash = HashSurface(verts, numVerts, indices, numIndices);
+
+	// A cube around the padded bounds, so cells are the same size on every axis
+	XMVECTOR minCorner = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxCorner = XMVectorReplicate(-FLT_MAX);
+	for (int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR position = XMLoadFloat3(&verts[i].Position);
+		minCorner = XMVectorMin(minCorner, position);
+		maxCorner = XMVectorMax(maxCorner, position);
+	}
+	XMVECTOR center = (minCorner + maxCorner) * 0.5f;
+	XMVECTOR extent = maxCorner - minCorner;
+	float size = std::max(std::max(XMVectorGetX(extent), XMVectorGetY(extent)), XMVectorGetZ(extent)) + padding * 2.0f;
+	cellSize = size / this->resolution;
+	XMStoreFloat3(&boundsMin, center - XMVectorReplicate(size * 0.5f));
+
+	int res = this->resolution;
+	distances.assign((size_t)res * res * res, 0.0f);
+
+	// Threads take whole z slices off a shared counter until there are none left
+	std::atomic<int> nextSlice(0);
+	auto bakeSlices = [&]()
+	{
+		XMVECTOR origin = XMLoadFloat3(&boundsMin);
+		for (int z = nextSlice++; z < res; z = nextSlice++)
+		{
+			for (int y = 0; y < res; y++)
+			{
+				for (int x = 0; x < res; x++)
+				{
+					XMVECTOR p = origin + XMVectorSet(x + 0.5f, y + 0.5f, z + 0.5f, 0) * cellSize;
+					float closest = FLT_MAX;
+					float winding = 0;
+					for (int t = 0; t + 2 < numIndices; t += 3)
+					{
+						XMVECTOR a = XMLoadFloat3(&verts[indices[t]].Position);
+						XMVECTOR b = XMLoadFloat3(&verts[indices[t + 1]].Position);
+						XMVECTOR c = XMLoadFloat3(&verts[indices[t + 2]].Position);
+						closest = std::min(closest, XMVectorGetX(XMVector3LengthSq(ClosestPointOnTriangle(p, a, b, c) - p)));
+						winding += SolidAngle(p, a, b, c);
+					}
+
+					// Counter clockwise and clockwise winding both count, the sign only says which way the mesh faces
+					bool inside = fabsf(winding) > XM_2PI;
+					distances[((size_t)z * res + y) * res + x] = inside ? -sqrtf(closest) : sqrtf(closest);
+				}
+			}
+		}
+	};
+
+	int threadCount = threads > 0 ? threads : std::max((int)std::thread::hardware_concurrency(), 1);
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.emplace_back(bakeSlices);
+	bakeSlices();
+	for (auto& worker : workers)
+		worker.join();
+
+	bakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool HairCollisionField::Load(const std::string& path, unsigned int surfaceHash, int resolution, float padding)
+{
+	std::ifstream in(path, std::ios::binary);
+	HairCollisionField loaded;
+	if (!in.is_open() || !loaded.Read(in) ||
+		loaded.surfaceHash != surfaceHash || loaded.resolution != resolution || loaded.padding != padding)
+		return false;
+
+	*this = loaded;
+	return true;
+}
+
+bool HairCollisionField::Save(const std::string& path)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	return out.is_open() && Write(out);
+}
+
+bool HairCollisionField::Read(std::istream& in)
+{
+	HairCollisionFieldHeader header = {};
+	in.read((char*)&header, sizeof(HairCollisionFieldHeader));
+	if (!in.good() || memcmp(header.Magic, "HSDF", 4) != 0 || header.Version != version ||
+		header.Resolution < 2 || header.Resolution > HAIR_SDF_MAX_RESOLUTION)
+		return false;
+
+	std::vector<float> loaded((size_t)header.Resolution * header.Resolution * header.Resolution);
+	in.read((char*)loaded.data(), loaded.size() * sizeof(float));
+	if (!in.good())
+		return false;
+
+	resolution = header.Resolution;
+	padding = header.Padding;
+	surfaceHash = header.SurfaceHash;
+	boundsMin = header.BoundsMin;
+	cellSize = header.CellSize;
+	distances.swap(loaded);
+	bakeMilliseconds = 0;
+	return true;
+}
+
+bool HairCollisionField::Write(std::ostream& out) const
+{
+	HairCollisionFieldHeader header = {};
+	memcpy(header.Magic, "HSDF", 4);
+	header.Version = version;
+	header.Resolution = resolution;
+	header.SurfaceHash = surfaceHash;
+	header.Padding = padding;
+	header.BoundsMin = boundsMin;
+	header.CellSize = cellSize;
+
+	out.write((const char*)&header, sizeof(HairCollisionFieldHeader));
+	out.write((const char*)distances.data(), distances.size() * sizeof(float));
+	return out.good();
+}
+
+float HairCollisionField::Sample(XMFLOAT3 position) const
+{
+	if (distances.empty())
+		return FLT_MAX;
+
+	// Cell centres are the samples, clamp like D3D11_TEXTURE_ADDRESS_CLAMP
+	float coords[3] = {
+		(position.x - boundsMin.x) / cellSize - 0.5f,
+		(position.y - boundsMin.y) / cellSize - 0.5f,
+		(position.z - boundsMin.z) / cellSize - 0.5f };
+	int cell[3];
+	float frac[3];
+	for (int i = 0; i < 3; i++)
+	{
+		coords[i] = std::min(std::max(coords[i], 0.0f), (float)(resolution - 1));
+		cell[i] = std::min((int)coords[i], resolution - 2);
+		frac[i] = coords[i] - cell[i];
+	}
+
+	auto at = [&](int x, int y, int z) { return distances[((size_t)(cell[2] + z) * resolution + cell[1] + y) * resolution + cell[0] + x]; };
+	auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	float x00 = lerp(at(0, 0, 0), at(1, 0, 0), frac[0]);
+	float x10 = lerp(at(0, 1, 0), at(1, 1, 0), frac[0]);
+	float x01 = lerp(at(0, 0, 1), at(1, 0, 1), frac[0]);
+	float x11 = lerp(at(0, 1, 1), at(1, 1, 1), frac[0]);
+	return lerp(lerp(x00, x10, frac[1]), lerp(x01, x11, frac[1]), frac[2]);
+}
+
+unsigned int HairCollisionField::HashSurface(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	unsigned int hash = HairHashBytes(verts, numVerts * sizeof(Vertex));
+	return HairHashBytes(indices, numIndices * sizeof(unsigned int), hash);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+// Start of every .sdf file, the distances follow right after it
+struct HairCollisionFieldHeader
+{
+	char Magic[4];					// "HSDF"
+	unsigned int Version;
+	unsigned int Resolution;
+	unsigned int SurfaceHash;		// Of the mesh it was baked from
+	float Padding;
+	DirectX::XMFLOAT3 BoundsMin;
+	float CellSize;
+};
+
+// --------------------------------------------------------
+// Signed distance field of a triangle mesh, for hair collision
+//
+// Distances are taken at the centres of a cube of
+// resolution^3 cells around the mesh, negative inside.
+// Inside is decided by the generalized winding number, so
+// meshes with small holes still come out right. Every cell
+// looks at every triangle, which is why baking is spread over
+// all cores and the result is cached next to the model.
+// --------------------------------------------------------
+class HairCollisionField
+{
+public:
+	HairCollisionField();
+
+	// padding = how far past the mesh's bounds the field reaches, threads = 0 uses every core
+	void Bake(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices, int resolution, float padding, int threads = 0);
+
+	// Load() fails if the file was baked from another mesh or with other settings
+	bool Load(const std::string& path, unsigned int surfaceHash, int resolution, float padding);
+	bool Save(const std::string& path);
+	// Same as a .sdf file but inside another one (see HairRecorder), Read() takes whatever field it finds
+	bool Read(std::istream& in);
+	bool Write(std::ostream& out) const;
+
+	// Trilinear, clamped to the edge of the field like the GPU sampler
+	float Sample(DirectX::XMFLOAT3 position) const;
+
+	int GetResolution() const { return resolution; }
+	DirectX::XMFLOAT3 GetBoundsMin() const { return boundsMin; }
+	float GetCellSize() const { return cellSize; }
+	const std::vector<float>& GetDistances() const { return distances; }
+	double GetBakeMilliseconds() { return bakeMilliseconds; }
+
+	static unsigned int HashSurface(const Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+
+private:
+	int resolution;
+	float padding;
+	unsigned int surfaceHash;
+	DirectX::XMFLOAT3 boundsMin;
+	float cellSize;
+	std::vector<float> distances;	// x fastest, then y, then z
+	double bakeMilliseconds;
+
+	static const unsigned int version = 1;
+};
@@ -1,10 +1,45 @@
-struct HairStrand
+// Must match HairStrand.h member for member!
+#include "HairShared.h"
+
+// Hot stream: read and written by every simulation step
+struct HairSimVertex
 {
 	float3 Position;	    // The position of the vertex
+	float3 PreviousPosition;// Verlet integration
+};
+
+// Cold stream: written once by CreateHair, after that only moved with the surface by UpdateHairRoots
+struct HairRestVertex
+{
+	float3 OriginalPosition;
 	float3 Normal;		// Lighting
 	float3 Tangent;		//Lighting
 	float2 UV;			// Texture mapping
-	float3 Acceleration;// Physics Simulation
-	float3 Speed;		//Physics Simulation
-	float3 OriginalPosition;
-};
\ No newline at end of file
+};
+
+// Where a root sits on the mesh it grows from
+struct HairRootBinding
+{
+	int Triangle;		// First index is Triangle * 3
+	float3 Barycentrics;
+};
+
+// Not simulated, follows the guides around it
+struct HairFollower
+{
+	int Strand;
+	int Guides[HAIR_FOLLOWER_GUIDES];
+	float Weights[HAIR_FOLLOWER_GUIDES];
+};
+
+// Which vertex of the full strand the k'th vertex of a strand
+// reduced to lodSegments segments is (see HAIR_LOD_LEVELS)
+int LODVertex(int k, int lodSegments, int vertsPerStrand)
+{
+	return k * (vertsPerStrand - 1) / lodSegments;
+}
+
+// HairPackedVertex and its encoding, needs HairSimVertex above
+#include "HairPacking.h"
+// SV_VertexID to ribbon corner for the hair draw
+#include "HairRibbon.h"
@@ -0,0 +1,50 @@
+#include "HairGroomBuilder.h"
+#include "HairRootSampler.h"
+#include "HairSimulator.h"
+#include "HairHash.h"
+
+using namespace DirectX;
+
+bool HairGroomBuilder::GrowStraight(const Vertex* verts, const unsigned int* indices, int numIndices, float density, unsigned int seed,
+	int vertsPerStrand, float length, int guideRatio, HairStraightGroom& groom)
+{
+	std::vector<HairRootBinding> bindings;
+	HairRootSampler::Sample(verts, indices, numIndices, density, seed, 0, bindings);
+	groom.numOfStrands = (int)bindings.size();
+	groom.vertsPerStrand = vertsPerStrand;
+	if (bindings.empty())
+		return false;
+
+	int strands = groom.numOfStrands;
+	groom.rest.resize(strands * vertsPerStrand);
+	groom.roots.resize(strands);
+	for (int s = 0; s < strands; s++)
+	{
+		Vertex root = HairRootSampler::Evaluate(verts, indices, bindings[s]);
+		unsigned int hash = HairHashBytes(&s, sizeof(int));
+		float strandLength = length * (0.85f + 0.3f * (hash / 4294967295.0f));
+		XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&root.Normal));
+		for (int v = 0; v < vertsPerStrand; v++)
+		{
+			HairRestVertex& vertex = groom.rest[s * vertsPerStrand + v];
+			XMStoreFloat3(&vertex.OriginalPosition, XMLoadFloat3(&root.Position) + normal * (strandLength * v / (vertsPerStrand - 1)));
+			vertex.Normal = root.Normal;
+			vertex.Tangent = root.Tangent;
+			vertex.UV = root.UV;
+		}
+		groom.roots[s] = root.Position;
+	}
+	HairSimulator::BindFollowers(groom.roots.data(), strands, guideRatio, groom.guides, groom.followers);
+
+	// Like Mesh::CreateRootBuffers
+	XMVECTOR rootMin = XMLoadFloat3(&groom.roots[0]);
+	XMVECTOR rootMax = rootMin;
+	for (int s = 1; s < strands; s++)
+	{
+		rootMin = XMVectorMin(rootMin, XMLoadFloat3(&groom.roots[s]));
+		rootMax = XMVectorMax(rootMax, XMLoadFloat3(&groom.roots[s]));
+	}
+	XMStoreFloat3(&groom.boundsCenter, (rootMin + rootMax) * 0.5f);
+	groom.boundsRadius = XMVectorGetX(XMVector3Length(rootMax - XMLoadFloat3(&groom.boundsCenter))) + length * 1.15f;
+	return true;
+}
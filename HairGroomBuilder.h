@@ -0,0 +1,37 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+#include "HairStrand.h"
+
+// Straight strands grown over a surface, everything the CPU solver needs to run them
+struct HairStraightGroom
+{
+	int numOfStrands;
+	int vertsPerStrand;
+	std::vector<HairRestVertex> rest;		// vertsPerStrand per strand, root first
+	std::vector<DirectX::XMFLOAT3> roots;
+	std::vector<int> guides;
+	std::vector<HairFollower> followers;
+	DirectX::XMFLOAT3 boundsCenter;			// Bounding sphere of the roots, grown by the longest strand
+	float boundsRadius;
+};
+
+// --------------------------------------------------------
+// Grows a groom on the CPU like the CreateHair pass does
+//
+// Roots come from HairRootSampler and every strand points
+// straight along the surface normal. Lengths are varied by
+// a hash of the strand index instead of the shader's sin()
+// noise, so every compiler grows the same groom. Needs no
+// device, see HairRegression.
+// --------------------------------------------------------
+class HairGroomBuilder
+{
+public:
+	// Each strand's length is varied by up to 15% either way. False if no root landed on the surface
+	static bool GrowStraight(const Vertex* verts, const unsigned int* indices, int numIndices, float density, unsigned int seed,
+		int vertsPerStrand, float length, int guideRatio, HairStraightGroom& groom);
+};
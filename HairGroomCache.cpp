@@ -0,0 +1,110 @@
+#include "HairGroomCache.h"
+
+#include <Windows.h>
+#include <cstring>
+#include <fstream>
+
+HairGroomCache::HairGroomCache() :
+	file(INVALID_HANDLE_VALUE),
+	mapping(0),
+	data(0),
+	header(0),
+	size(0)
+{
+}
+
+HairGroomCache::~HairGroomCache()
+{
+	Close();
+}
+
+bool HairGroomCache::Open(const std::string& path)
+{
+	Close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(HairGroomHeader))
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+	data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+	header = (const HairGroomHeader*)data;
+
+	// Everything the getters hand out has to be inside the file
+	size_t strands = header->NumOfStrands;
+	size_t verts = strands * header->VertsPerStrand;
+	bool valid = memcmp(header->Magic, "HGRM", 4) == 0 && header->Version == version && strands > 0 &&
+		header->RootsOffset + strands * sizeof(ShaderVertex) <= size &&
+		header->BindingsOffset + strands * sizeof(HairRootBinding) <= size &&
+		header->ParamsOffset + strands * sizeof(HairStrandParams) <= size &&
+		header->RestOffset + verts * sizeof(HairRestVertex) <= size &&
+		header->StateOffset + verts * sizeof(HairPackedVertex) <= size &&
+		header->PhysicsOffset + verts * sizeof(unsigned int) <= size;
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void HairGroomCache::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	data = 0;
+	header = 0;
+	size = 0;
+}
+
+bool HairGroomCache::Write(const std::string& path, HairGroomHeader header, const ShaderVertex* roots, const HairRootBinding* bindings,
+	const HairStrandParams* params, const HairRestVertex* rest, const HairPackedVertex* state, const unsigned int* physics)
+{
+	size_t strands = header.NumOfStrands;
+	size_t verts = strands * header.VertsPerStrand;
+
+	memcpy(header.Magic, "HGRM", 4);
+	header.Version = version;
+	header.RootsOffset = sizeof(HairGroomHeader);
+	header.BindingsOffset = (unsigned int)(header.RootsOffset + strands * sizeof(ShaderVertex));
+	header.ParamsOffset = (unsigned int)(header.BindingsOffset + strands * sizeof(HairRootBinding));
+	header.RestOffset = (unsigned int)(header.ParamsOffset + strands * sizeof(HairStrandParams));
+	header.StateOffset = (unsigned int)(header.RestOffset + verts * sizeof(HairRestVertex));
+	header.PhysicsOffset = (unsigned int)(header.StateOffset + verts * sizeof(HairPackedVertex));
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+	out.write((const char*)&header, sizeof(HairGroomHeader));
+	out.write((const char*)roots, strands * sizeof(ShaderVertex));
+	out.write((const char*)bindings, strands * sizeof(HairRootBinding));
+	out.write((const char*)params, strands * sizeof(HairStrandParams));
+	out.write((const char*)rest, verts * sizeof(HairRestVertex));
+	out.write((const char*)state, verts * sizeof(HairPackedVertex));
+	out.write((const char*)physics, verts * sizeof(unsigned int));
+	return out.good();
+}
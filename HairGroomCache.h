@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+#include "ShaderVertex.h"
+#include "HairStrand.h"
+#include "HairPacking.h"
+
+// Start of every .groom file, the arrays follow at the given byte offsets
+struct HairGroomHeader
+{
+	char Magic[4];					// "HGRM"
+	unsigned int Version;
+	unsigned int NumOfStrands;
+	unsigned int VertsPerStrand;
+	float Density;
+	float Length;
+	unsigned int RootSeed;
+	unsigned int SurfaceHash;		// Of the mesh the roots were sampled from
+	unsigned int PhysicsHash;		// Of the physics map the table was built from, 0 if it was authored without one
+	unsigned int RootsOffset;		// ShaderVertex per strand, what CreateHair reads
+	unsigned int BindingsOffset;	// HairRootBinding per strand
+	unsigned int ParamsOffset;		// HairStrandParams per strand
+	unsigned int RestOffset;		// HairRestVertex per strand vertex
+	unsigned int StateOffset;		// HairPackedVertex per strand vertex
+	unsigned int PhysicsOffset;		// HairPackPhysics value per strand vertex
+};
+
+// --------------------------------------------------------
+// A baked groom on disk
+//
+// Opening a cache maps the file into memory, the getters point
+// straight into the mapping so the hair buffers can be created
+// from it without another copy. Everything is little endian
+// and written exactly as it sits in the GPU buffers.
+// --------------------------------------------------------
+class HairGroomCache
+{
+public:
+	HairGroomCache();
+	~HairGroomCache();
+
+	// False if the file is missing, truncated or from another version
+	bool Open(const std::string& path);
+	void Close();
+
+	const HairGroomHeader* GetHeader() { return header; }
+	const ShaderVertex* GetRoots() { return (const ShaderVertex*)(data + header->RootsOffset); }
+	const HairRootBinding* GetBindings() { return (const HairRootBinding*)(data + header->BindingsOffset); }
+	const HairStrandParams* GetStrandParams() { return (const HairStrandParams*)(data + header->ParamsOffset); }
+	const HairRestVertex* GetRest() { return (const HairRestVertex*)(data + header->RestOffset); }
+	const HairPackedVertex* GetState() { return (const HairPackedVertex*)(data + header->StateOffset); }
+	const unsigned int* GetPhysics() { return (const unsigned int*)(data + header->PhysicsOffset); }
+
+	static bool Write(const std::string& path, HairGroomHeader header, const ShaderVertex* roots, const HairRootBinding* bindings,
+		const HairStrandParams* params, const HairRestVertex* rest, const HairPackedVertex* state, const unsigned int* physics);
+
+private:
+	void* file;
+	void* mapping;
+	const unsigned char* data;
+	const HairGroomHeader* header;
+	size_t size;
+
+	static const unsigned int version = 4;
+};
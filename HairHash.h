@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// FNV-1a over raw bytes. Grooms, collision fields and recordings are keyed on it,
+// so it's kept free of any platform headers and gives the same value everywhere
+inline unsigned int HairHashBytes(const void* bytes, size_t size, unsigned int hash = 2166136261U)
+{
+	const unsigned char* b = (const unsigned char*)bytes;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= b[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
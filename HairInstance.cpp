@@ -0,0 +1,727 @@
+#include "HairInstance.h"
+#include "Mesh.h"
+#include "Assets.h"
+#include "HairSimulator.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+HairInstance::HairInstance(const std::string& recordingPath) :
+	groomVersion(-1),
+	groomWake(0),
+	currentSlot(0),
+	frameLatency(defaultFrameLatency),
+	currentActiveList(0),
+	countReadbackWake(),
+	readbackFrame(0),
+	wakeCount(0),
+	wakeRequested(true),
+	lastSimulatedLOD(-1),
+	activeStrands(-1),
+	skippedSteps(0),
+	frameVelocity(),
+	frameVelocities(0),
+	inertialAcceleration(0),
+	lod(0),
+	forcedLOD(-1),
+	forcedTessellation(-1),
+	projectedSize(0),
+	clusterCulling(true),
+	clusterReadbackPending(),
+	clusterReadbackFrame(0),
+	recordingPath(recordingPath),
+	replayResult(),
+	stateReadbackPending(false),
+	stateReadbackChecksum(false),
+	stateReadbackKeyframe(false),
+	stateReadbackExpected(0),
+	stateReadbackFrame(0),
+	recordedWorld()
+{
+	replayResult.firstMismatchFrame = -1;
+}
+
+unsigned int HairInstance::GetStateBytes()
+{
+	if (stateRing.empty())
+		return 0;
+	D3D11_BUFFER_DESC desc = {};
+	stateRing[0].buffer->GetDesc(&desc);
+	return desc.ByteWidth * (unsigned int)stateRing.size();
+}
+
+void HairInstance::Update(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom)
+{
+	if (groomVersion == groom.GetHairGroomVersion())
+	{
+		if (groomWake != groom.GetHairWakeGeneration())
+			Wake();
+		groomWake = groom.GetHairWakeGeneration();
+		return;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	context->GetDevice(device.GetAddressOf());
+	clusters = groom.GetHairClusters();
+	uploadedClusterVisibility.clear();
+
+	// Keeps its slot count, every slot starts out as the freshly created hair so
+	// the latency doesn't draw garbage for the first few frames
+	CreateStateRing(device, groom, stateRing.empty() ? defaultStateSlots : (int)stateRing.size());
+	for (auto& slot : stateRing)
+		context->CopyResource(slot.buffer.Get(), groom.GetHairInitialState());
+	currentSlot = 0;
+	CreateSleepBuffers(device, groom);
+	CreateClusterBuffers(device);
+	groomVersion = groom.GetHairGroomVersion();
+	groomWake = groom.GetHairWakeGeneration();
+}
+
+void HairInstance::SetStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, int slotCount, int frameLatency)
+{
+	// More slots than sleep steps and a strand could fall asleep before every slot holds its resting pose
+	slotCount = min(max(slotCount, 2), HAIR_MAX_STATE_SLOTS);
+	this->frameLatency = min(max(frameLatency, 0), slotCount - 1);
+	Update(context, groom);
+	if (slotCount == (int)stateRing.size())
+		return;
+
+	// Carry the current state over into the resized ring
+	Microsoft::WRL::ComPtr<ID3D11Buffer> currentState = stateRing[currentSlot].buffer;
+	CreateStateRing(device, groom, slotCount);
+	for (auto& slot : stateRing)
+		context->CopyResource(slot.buffer.Get(), currentState.Get());
+	currentSlot = 0;
+	Wake();
+}
+
+void HairInstance::CreateStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, const Mesh& groom, int slotCount)
+{
+	stateRing.clear();
+	stateRing.resize(slotCount);
+	// Sized for the old groom, made again on the next readback
+	stateReadback.Reset();
+	stateReadbackPending = false;
+
+	// Each slot is written as a UAV by one step and read as an SRV by the next one and the draw.
+	// Packed relative to the roots, half the size of the HairSimVertex the shaders work with
+	int count = groom.GetHairStrandCount() * groom.GetHairVertsPerStrand();
+	D3D11_BUFFER_DESC hbd = {};
+	hbd.Usage = D3D11_USAGE_DEFAULT;
+	hbd.ByteWidth = sizeof(HairPackedVertex) * count;
+	hbd.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	hbd.CPUAccessFlags = 0;
+	hbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	hbd.StructureByteStride = sizeof(HairPackedVertex);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC hairUAVDesc = {};
+	hairUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	hairUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	hairUAVDesc.Buffer.FirstElement = 0;
+	hairUAVDesc.Buffer.NumElements = count;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC hairSRVDesc = {};
+	hairSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	hairSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	hairSRVDesc.Buffer.FirstElement = 0;
+	hairSRVDesc.Buffer.NumElements = count;
+
+	for (auto& slot : stateRing)
+	{
+		Mesh::CreateHairBuffer(&hbd, 0, slot.buffer.GetAddressOf(), device);
+		device->CreateUnorderedAccessView(slot.buffer.Get(), &hairUAVDesc, slot.uav.GetAddressOf());
+		device->CreateShaderResourceView(slot.buffer.Get(), &hairSRVDesc, slot.srv.GetAddressOf());
+	}
+}
+
+// Per strand sleep counters, the two active strand lists and what turns their length into a dispatch
+void HairInstance::CreateSleepBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, const Mesh& groom)
+{
+	int numOfStrands = groom.GetHairStrandCount();
+	D3D11_BUFFER_DESC sleepDesc = {};
+	sleepDesc.Usage = D3D11_USAGE_DEFAULT;
+	sleepDesc.ByteWidth = sizeof(unsigned int) * numOfStrands;
+	sleepDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	sleepDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	sleepDesc.StructureByteStride = sizeof(unsigned int);
+	std::vector<unsigned int> zeroes(numOfStrands, 0);
+	D3D11_SUBRESOURCE_DATA zeroData = {};
+	zeroData.pSysMem = zeroes.data();
+	Mesh::CreateHairBuffer(&sleepDesc, &zeroData, sleepBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC sleepUAVDesc = {};
+	sleepUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	sleepUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	sleepUAVDesc.Buffer.NumElements = numOfStrands;
+	device->CreateUnorderedAccessView(sleepBuffer.Get(), &sleepUAVDesc, sleepUAV.ReleaseAndGetAddressOf());
+
+	D3D11_BUFFER_DESC listDesc = sleepDesc;
+	listDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	listDesc.StructureByteStride = sizeof(int);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC listUAVDesc = sleepUAVDesc;
+	listUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC listSRVDesc = {};
+	listSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	listSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	listSRVDesc.Buffer.NumElements = numOfStrands;
+
+	for (auto& list : activeLists)
+	{
+		Mesh::CreateHairBuffer(&listDesc, 0, list.buffer.ReleaseAndGetAddressOf(), device);
+		device->CreateUnorderedAccessView(list.buffer.Get(), &listUAVDesc, list.uav.ReleaseAndGetAddressOf());
+		device->CreateShaderResourceView(list.buffer.Get(), &listSRVDesc, list.srv.ReleaseAndGetAddressOf());
+	}
+	currentActiveList = 0;
+
+	// CopyStructureCount lands here, raw so the shaders can Load() it
+	D3D11_BUFFER_DESC countDesc = {};
+	countDesc.Usage = D3D11_USAGE_DEFAULT;
+	countDesc.ByteWidth = 16;
+	countDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	countDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	Mesh::CreateHairBuffer(&countDesc, 0, activeCountBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC countSRVDesc = {};
+	countSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	countSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+	countSRVDesc.BufferEx.NumElements = 4;
+	countSRVDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+	device->CreateShaderResourceView(activeCountBuffer.Get(), &countSRVDesc, activeCountSRV.ReleaseAndGetAddressOf());
+
+	D3D11_BUFFER_DESC argsDesc = countDesc;
+	argsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	argsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+	Mesh::CreateHairBuffer(&argsDesc, 0, dispatchArgsBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC argsUAVDesc = {};
+	argsUAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	argsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	argsUAVDesc.Buffer.NumElements = 4;
+	argsUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	device->CreateUnorderedAccessView(dispatchArgsBuffer.Get(), &argsUAVDesc, dispatchArgsUAV.ReleaseAndGetAddressOf());
+
+	// A few frames of readbacks in flight so mapping never stalls
+	D3D11_BUFFER_DESC readbackDesc = {};
+	readbackDesc.Usage = D3D11_USAGE_STAGING;
+	readbackDesc.ByteWidth = 16;
+	readbackDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	for (int i = 0; i < 3; i++)
+	{
+		device->CreateBuffer(&readbackDesc, 0, countReadback[i].ReleaseAndGetAddressOf());
+		countReadbackWake[i] = 0;
+	}
+	readbackFrame = 0;
+	wakeCount = 0;
+	wakeRequested = true;
+	lastSimulatedLOD = -1;
+	activeStrands = -1;
+	skippedSteps = 0;
+}
+
+void HairInstance::CreateClusterBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	int clusterCount = clusters.GetClusterCount();
+	D3D11_BUFFER_DESC visibilityDesc = {};
+	visibilityDesc.Usage = D3D11_USAGE_DYNAMIC;
+	visibilityDesc.ByteWidth = sizeof(unsigned int) * clusterCount;
+	visibilityDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	visibilityDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	visibilityDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	visibilityDesc.StructureByteStride = sizeof(unsigned int);
+	D3D11_SUBRESOURCE_DATA visibilityData = {};
+	visibilityData.pSysMem = clusters.GetVisibility().data();
+	Mesh::CreateHairBuffer(&visibilityDesc, &visibilityData, clusterVisibilityBuffer.ReleaseAndGetAddressOf(), device);
+	uploadedClusterVisibility = clusters.GetVisibility();
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC visibilitySRVDesc = {};
+	visibilitySRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	visibilitySRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	visibilitySRVDesc.Buffer.NumElements = clusterCount;
+	device->CreateShaderResourceView(clusterVisibilityBuffer.Get(), &visibilitySRVDesc, clusterVisibilitySRV.ReleaseAndGetAddressOf());
+
+	D3D11_BUFFER_DESC boundsDesc = {};
+	boundsDesc.Usage = D3D11_USAGE_DEFAULT;
+	boundsDesc.ByteWidth = sizeof(HairClusterBounds) * clusterCount;
+	boundsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	boundsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	boundsDesc.StructureByteStride = sizeof(HairClusterBounds);
+	Mesh::CreateHairBuffer(&boundsDesc, 0, clusterBoundsBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC boundsUAVDesc = {};
+	boundsUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	boundsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	boundsUAVDesc.Buffer.NumElements = clusterCount;
+	device->CreateUnorderedAccessView(clusterBoundsBuffer.Get(), &boundsUAVDesc, clusterBoundsUAV.ReleaseAndGetAddressOf());
+
+	D3D11_BUFFER_DESC readbackDesc = {};
+	readbackDesc.Usage = D3D11_USAGE_STAGING;
+	readbackDesc.ByteWidth = boundsDesc.ByteWidth;
+	readbackDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	for (int i = 0; i < 3; i++)
+	{
+		device->CreateBuffer(&readbackDesc, 0, clusterReadback[i].ReleaseAndGetAddressOf());
+		clusterReadbackPending[i] = false;
+	}
+	clusterReadbackFrame = 0;
+}
+
+bool HairInstance::StartRecording(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, const std::vector<XMFLOAT3>& restPositions)
+{
+	HairRecordingHeader header = {};
+	header.Solver = HAIR_RECORD_SOLVER_GPU;
+	header.NumOfStrands = groom.GetHairStrandCount();
+	header.VertsPerStrand = groom.GetHairVertsPerStrand();
+	header.GuideRatio = groom.GetHairGuideRatio();
+	header.StateScale = groom.GetHairStateScale();
+	header.FixedStep = stepScheduler.GetFixedStep();
+	header.MaxSubsteps = stepScheduler.GetMaxSubsteps();
+	header.Collision = groom.GetHairCollision() ? 1 : 0;
+	header.BoundsCenter = groom.GetHairBoundsCenter();
+	header.BoundsRadius = groom.GetHairBoundsRadius();
+	header.Settings = groom.GetHairSolverSettings();
+	if (!recorder.Open(recordingPath, header, restPositions.data(), groom.GetHairPhysics().data(), &groom.GetHairCollisionField()))
+		return false;
+	// The CPU's checksums were of the old recording
+	remove(GetCPURecordingPath().c_str());
+
+	ResetForRecording(context);
+	std::vector<HairPackedVertex> state;
+	if (!ReadBackState(context, state))
+	{
+		recorder.Close();
+		return false;
+	}
+	recorder.WriteKeyframe(state.data());
+	return true;
+}
+
+bool HairInstance::StartReplay(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom)
+{
+	StopRecording();
+	if (recordingPath.empty() || !replay.Open(recordingPath))
+		return false;
+
+	// Only the GPU's own recordings of this same hair can be checked here, RunCPU takes the rest
+	Update(context, groom);
+	const HairRecordingHeader& header = replay.GetHeader();
+	if (header.Solver != HAIR_RECORD_SOLVER_GPU || header.NumOfStrands != (unsigned int)groom.GetHairStrandCount() ||
+		header.VertsPerStrand != (unsigned int)groom.GetHairVertsPerStrand() || header.GuideRatio != (unsigned int)groom.GetHairGuideRatio())
+	{
+		replay.Close();
+		return false;
+	}
+
+	// The settings and collision come from the header while the replay is open, see Mesh::GetHairSolverSettings
+	stepScheduler.SetFixedStep(header.FixedStep);
+	stepScheduler.SetMaxSubsteps(header.MaxSubsteps);
+	if (replay.GetPhysics() != groom.GetHairPhysics())
+		Mesh::CreatePhysicsBuffer(device, replay.GetPhysics(), replayPhysicsSRV);
+	else
+		replayPhysicsSRV.Reset();
+
+	replayResult = {};
+	replayResult.firstMismatchFrame = -1;
+	ResetForRecording(context);
+	return true;
+}
+
+void HairInstance::BeginFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom)
+{
+	// Last frame's checksum or keyframe, before this frame goes into the recording
+	ResolveStateReadback(context);
+	ReadBackActiveCount(context);
+	ReadBackClusterBounds(context, groom);
+	UploadClusterVisibility(context);
+}
+
+bool HairInstance::RecordFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, float& deltaTime, XMFLOAT3& force, XMFLOAT4X4& world, XMFLOAT4X4& prevWorld)
+{
+	HairRecordFrame frame = {};
+	if (replay.IsOpen() && NextReplayFrame(context, frame))
+	{
+		deltaTime = frame.DeltaTime;
+		force = frame.Force;
+		replayResult.frames++;
+	}
+	else if (recorder.IsOpen())
+	{
+		frame.DeltaTime = deltaTime;
+		frame.Force = force;
+		XMStoreFloat4x3(&frame.World, XMLoadFloat4x4(&world));
+		frame.LOD = 0;
+		recorder.WriteFrame(frame);
+	}
+	if (!replay.IsOpen() && !recorder.IsOpen())
+		return false;
+
+	// The CPU solver has no LOD, so recordings are always at full detail
+	lod = 0;
+	XMStoreFloat4x4(&world, XMLoadFloat4x3(&frame.World));
+	prevWorld = recorder.GetFrameCount() + replayResult.frames <= 1 ? world : recordedWorld;
+	recordedWorld = world;
+	return true;
+}
+
+HairExternalForces HairInstance::UpdateForces(const Mesh& groom, float deltaTime, XMFLOAT3 force, XMFLOAT4X4 world, XMFLOAT4X4 prevWorld, float inertia)
+{
+	HairExternalForces forces = {};
+	forces.Force = force;
+	inertialAcceleration = 0;
+	if (deltaTime > 0)
+	{
+		XMFLOAT4X4 velocity = HairSimulator::GetFrameVelocity(world, prevWorld, deltaTime);
+		if (frameVelocities >= 2)
+		{
+			XMFLOAT4X4 frameInertia = HairSimulator::GetInertia(prevWorld, velocity, frameVelocity, deltaTime);
+			XMStoreFloat4x4(&forces.Inertia, XMLoadFloat4x4(&frameInertia) * inertia);
+			inertialAcceleration = HairSimulator::ClampInertia(forces.Inertia, groom.GetHairBoundsCenter(), groom.GetHairBoundsRadius());
+		}
+		frameVelocity = velocity;
+		frameVelocities = min(frameVelocities + 1, 2);
+	}
+	return forces;
+}
+
+bool HairInstance::BeginStep(bool disturbed, bool& wake)
+{
+	// A new LOD solves different vertices, so everything has to be looked at again.
+	// The CPU solver never sleeps, so neither do recordings
+	bool recorded = recorder.IsOpen() || replay.IsOpen();
+	wake = wakeRequested || disturbed || recorded || lod != lastSimulatedLOD;
+	if (wake)
+	{
+		wakeCount++;
+		activeStrands = -1;
+	}
+	else if (activeStrands == 0)
+	{
+		// Every strand is asleep, the ring already holds the resting pose in every slot
+		skippedSteps++;
+		return false;
+	}
+	wakeRequested = false;
+	lastSimulatedLOD = lod;
+	return true;
+}
+
+// Ping-pong through the ring: read the newest state, write the next slot.
+// Nothing is allocated or copied here anymore
+void HairInstance::SetSimulateShaderResources(SimpleComputeShader* simulateCS, bool wake)
+{
+	int writeSlot = (currentSlot + 1) % (int)stateRing.size();
+	simulateCS->SetShaderResourceView("prevHairData", stateRing[currentSlot].srv);
+	simulateCS->SetShaderResourceView("clusterVisibility", clusterVisibilitySRV);
+	simulateCS->SetInt("clusterStrands", clusters.GetClusterSize());
+	simulateCS->SetShaderResourceView("activeStrands", activeLists[currentActiveList].srv);
+	simulateCS->SetShaderResourceView("activeCount", activeCountSRV);
+	simulateCS->SetUnorderedAccessView("hairData", stateRing[writeSlot].uav);
+	simulateCS->SetUnorderedAccessView("sleepSteps", sleepUAV);
+	simulateCS->SetUnorderedAccessView("nextActiveStrands", activeLists[1 - currentActiveList].uav, 0);
+	simulateCS->SetInt("useActiveList", wake ? 0 : 1);
+}
+
+void HairInstance::DispatchStep(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, SimpleComputeShader* simulateCS, int guides, bool wake)
+{
+	int writeSlot = (currentSlot + 1) % (int)stateRing.size();
+	int writeList = 1 - currentActiveList;
+
+	// Awake: every guide this LOD simulates. Otherwise only what was still moving last step
+	if (wake)
+		simulateCS->DispatchByThreads(guides, 1, 1);
+	else
+		context->DispatchIndirect(dispatchArgsBuffer.Get(), 0);
+	simulateCS->SetUnorderedAccessView("hairData", 0);
+	simulateCS->SetUnorderedAccessView("nextActiveStrands", 0);
+	simulateCS->SetShaderResourceView("prevHairData", 0);
+	simulateCS->SetShaderResourceView("activeCount", 0);
+
+	// Size the next step from what's still awake
+	context->CopyStructureCount(activeCountBuffer.Get(), 0, activeLists[writeList].uav.Get());
+	std::shared_ptr<SimpleComputeShader> prepareCS = Assets::GetInstance().GetComputeShader("PrepareHairDispatch");
+	prepareCS->SetShader();
+	prepareCS->SetShaderResourceView("activeCount", activeCountSRV);
+	prepareCS->SetUnorderedAccessView("dispatchArgs", dispatchArgsUAV);
+	prepareCS->DispatchByGroups(1, 1, 1);
+	prepareCS->SetUnorderedAccessView("dispatchArgs", 0);
+	prepareCS->SetShaderResourceView("activeCount", 0);
+
+	int readback = readbackFrame % 3;
+	context->CopyResource(countReadback[readback].Get(), activeCountBuffer.Get());
+	countReadbackWake[readback] = wakeCount;
+	readbackFrame++;
+	currentActiveList = writeList;
+	currentSlot = writeSlot;
+}
+
+void HairInstance::EndFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, int steps)
+{
+	if (steps > 0)
+		UpdateClusterBounds(context, groom);
+
+	if (replay.IsOpen())
+		replayResult.steps += steps;
+	else if (recorder.IsOpen() && (recorder.WantsChecksum() || recorder.WantsKeyframe()))
+	{
+		// Written at the start of the next frame, once the copy has arrived
+		stateReadbackChecksum = recorder.WantsChecksum();
+		stateReadbackKeyframe = recorder.WantsKeyframe();
+		CopyStateToReadback(context);
+	}
+}
+
+// Which clusters SimulateHair solves, only uploaded when that changes. Anything coming back
+// into view was standing still, so everything is woken to catch up
+void HairInstance::UploadClusterVisibility(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	const std::vector<unsigned int>& visibility = clusters.GetVisibility();
+	if (visibility == uploadedClusterVisibility)
+		return;
+	if (clusters.CameIntoView())
+		Wake();
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(clusterVisibilityBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, visibility.data(), visibility.size() * sizeof(unsigned int));
+	context->Unmap(clusterVisibilityBuffer.Get(), 0);
+	uploadedClusterVisibility = visibility;
+}
+
+// Boxes every cluster's newest state on the GPU and starts copying the boxes back
+void HairInstance::UpdateClusterBounds(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom)
+{
+	int readback = clusterReadbackFrame % 3;
+	if (clusterReadbackPending[readback])
+		return;
+
+	std::shared_ptr<SimpleComputeShader> clusterCS = Assets::GetInstance().GetComputeShader("UpdateHairClusters");
+	clusterCS->SetShader();
+	clusterCS->SetInt("numOfStrands", groom.GetHairStrandCount());
+	clusterCS->SetInt("vertsPerStrand", groom.GetHairVertsPerStrand());
+	clusterCS->SetInt("clusterStrands", clusters.GetClusterSize());
+	clusterCS->SetFloat("stateScale", groom.GetHairStateScale());
+	clusterCS->SetShaderResourceView("hairData", stateRing[currentSlot].srv);
+	clusterCS->SetShaderResourceView("restData", groom.GetHairRestSRV());
+	clusterCS->SetUnorderedAccessView("clusterBounds", clusterBoundsUAV);
+	clusterCS->CopyAllBufferData();
+	clusterCS->DispatchByGroups(clusters.GetClusterCount(), 1, 1);
+	clusterCS->SetUnorderedAccessView("clusterBounds", 0);
+	clusterCS->SetShaderResourceView("hairData", 0);
+
+	context->CopyResource(clusterReadback[readback].Get(), clusterBoundsBuffer.Get());
+	clusterReadbackPending[readback] = true;
+	clusterReadbackFrame++;
+}
+
+// Same few frames of latency as the active strand count, the margin covers what moved since
+void HairInstance::ReadBackClusterBounds(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom)
+{
+	int oldest = clusterReadbackFrame % 3;
+	if (!clusterReadbackPending[oldest])
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(clusterReadback[oldest].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+		return;
+	clusters.UpdateBounds((const HairClusterBounds*)mapped.pData, groom.GetHairLength() * HAIR_CLUSTER_BOUNDS_MARGIN);
+	context->Unmap(clusterReadback[oldest].Get(), 0);
+	clusterReadbackPending[oldest] = false;
+}
+
+// Picks up the oldest active count that's ready, without waiting on the GPU
+void HairInstance::ReadBackActiveCount(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	int oldest = readbackFrame % 3;
+	if (countReadbackWake[oldest] == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(countReadback[oldest].Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+		return;
+
+	// Counts from before the last wake say nothing about now
+	if (countReadbackWake[oldest] == wakeCount)
+		activeStrands = *(const unsigned int*)mapped.pData;
+	context->Unmap(countReadback[oldest].Get(), 0);
+	countReadbackWake[oldest] = 0;
+}
+
+// Everything carried over between frames goes back to a known start, so a recording and its replay begin alike
+void HairInstance::ResetForRecording(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	stepScheduler.Reset();
+	frameVelocity = XMFLOAT4X4();
+	frameVelocities = 0;
+	inertialAcceleration = 0;
+	unsigned int zeros[4] = {};
+	context->ClearUnorderedAccessViewUint(sleepUAV.Get(), zeros);
+	Wake();
+	// Whatever was in flight belongs to the recording before
+	stateReadbackPending = false;
+}
+
+// Reads chunks up to the next frame, checking the state against the checksums that came after the last one
+bool HairInstance::NextReplayFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairRecordFrame& frame)
+{
+	char tag = 0;
+	while (replay.Next(tag))
+	{
+		if (tag == HAIR_RECORD_FRAME)
+		{
+			frame = replay.GetFrame();
+			// Only LOD 0 can be compared with the CPU solver
+			if (frame.LOD != 0)
+			{
+				replayResult.rejected = true;
+				break;
+			}
+			return true;
+		}
+		else if (tag == HAIR_RECORD_KEYFRAME && replay.GetFrameCount() == 0)
+		{
+			// Where the recording started, into every slot so the drawn hair doesn't blend from anything else
+			for (size_t i = 0; i < stateRing.size(); i++)
+				context->UpdateSubresource(stateRing[i].buffer.Get(), 0, 0, replay.GetKeyframe().data(), 0, 0);
+		}
+		else if (tag == HAIR_RECORD_CHECKSUM)
+		{
+			// Compared at the start of the next frame, once the copy has arrived
+			stateReadbackChecksum = false;
+			stateReadbackKeyframe = false;
+			stateReadbackExpected = replay.GetChecksum();
+			stateReadbackFrame = replay.GetFrameCount();
+			CopyStateToReadback(context);
+		}
+	}
+	StopReplay();
+	return false;
+}
+
+// Right away, for the keyframe a recording starts with
+bool HairInstance::ReadBackState(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::vector<HairPackedVertex>& state)
+{
+	return CopyStateToReadback(context) && MapStateReadback(context, state);
+}
+
+// Newest state into the instance's staging buffer, made the first time it's needed
+bool HairInstance::CopyStateToReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!stateReadback)
+	{
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		context->GetDevice(device.GetAddressOf());
+		D3D11_BUFFER_DESC desc = {};
+		stateRing[currentSlot].buffer->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+		if (FAILED(device->CreateBuffer(&desc, 0, stateReadback.GetAddressOf())))
+			return false;
+	}
+	context->CopyResource(stateReadback.Get(), stateRing[currentSlot].buffer.Get());
+	stateReadbackPending = true;
+	return true;
+}
+
+bool HairInstance::MapStateReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::vector<HairPackedVertex>& state)
+{
+	stateReadbackPending = false;
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(stateReadback.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+	D3D11_BUFFER_DESC desc = {};
+	stateReadback->GetDesc(&desc);
+	const HairPackedVertex* data = (const HairPackedVertex*)mapped.pData;
+	state.assign(data, data + desc.ByteWidth / sizeof(HairPackedVertex));
+	context->Unmap(stateReadback.Get(), 0);
+	return true;
+}
+
+// The copy made last frame has had a whole frame to get here, so mapping it doesn't stall
+void HairInstance::ResolveStateReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	std::vector<HairPackedVertex> state;
+	if (!stateReadbackPending || !MapStateReadback(context, state))
+		return;
+
+	// Recording, unless it stopped in between
+	if (stateReadbackChecksum || stateReadbackKeyframe)
+	{
+		if (stateReadbackChecksum && recorder.IsOpen())
+			recorder.WriteChecksum(HairRecorder::Checksum(state.data(), (int)state.size()));
+		if (stateReadbackKeyframe && recorder.IsOpen())
+			recorder.WriteKeyframe(state.data());
+	}
+	else
+	{
+		// The replay may have closed since, the result still counts
+		replayResult.checksums++;
+		if (HairRecorder::Checksum(state.data(), (int)state.size()) != stateReadbackExpected)
+		{
+			replayResult.mismatches++;
+			if (replayResult.firstMismatchFrame < 0)
+				replayResult.firstMismatchFrame = stateReadbackFrame;
+		}
+	}
+}
+
+void HairInstance::ResetLOD()
+{
+	lod = HAIR_LOD_LEVELS - 1;
+	projectedSize = 0;
+
+	// Recordings have to simulate every strand, see Mesh::StartHairRecording
+	clusters.ResetVisibility();
+	if (!clusterCulling || recorder.IsOpen() || replay.IsOpen())
+		clusters.ShowAll();
+}
+
+void HairInstance::RequestLOD(const Mesh& groom, XMFLOAT4X4 world, XMFLOAT4X4 view, XMFLOAT4X4 projection)
+{
+	// Bounding sphere into view space, scaled by the largest axis of the world matrix
+	XMFLOAT3 boundsCenter = groom.GetHairBoundsCenter();
+	XMMATRIX worldMat = XMLoadFloat4x4(&world);
+	XMVECTOR center = XMVector3Transform(XMVector3Transform(XMLoadFloat3(&boundsCenter), worldMat), XMLoadFloat4x4(&view));
+	float scale = max(max(XMVectorGetX(XMVector3Length(worldMat.r[0])), XMVectorGetX(XMVector3Length(worldMat.r[1]))), XMVectorGetX(XMVector3Length(worldMat.r[2])));
+	float radius = groom.GetHairBoundsRadius() * scale;
+	float depth = XMVectorGetZ(center);
+
+	// Radius as a fraction of half the screen height, _22 is 1 / tan(fov / 2)
+	float size = depth > radius ? radius * projection._22 / depth : FLT_MAX;
+	projectedSize = max(projectedSize, size);
+
+	int level = 0;
+	if (forcedLOD >= 0)
+		level = min(forcedLOD, HAIR_LOD_LEVELS - 1);
+	else if (size < HAIR_LOD_FULL_DETAIL_SIZE)
+		level = min((int)log2f(HAIR_LOD_FULL_DETAIL_SIZE / size), HAIR_LOD_LEVELS - 1);
+	lod = min(lod, level);
+
+	clusters.AddView(world, view, projection);
+}
+
+int HairInstance::GetTessellation(const Mesh& groom)
+{
+	if (forcedTessellation > 0)
+		return min(forcedTessellation, HAIR_MAX_TESSELLATION);
+
+	// A segment covers about its share of the strand length, out of the bounding sphere's projected radius
+	const HairLODLevel& level = groom.GetHairLODLevel(lod);
+	float boundsRadius = groom.GetHairBoundsRadius();
+	float segmentSize = projectedSize * groom.GetHairLength() / (boundsRadius * level.segments);
+	if (boundsRadius <= 0 || segmentSize >= HAIR_TESSELLATION_SCREEN_LENGTH * HAIR_MAX_TESSELLATION)
+		return HAIR_MAX_TESSELLATION;
+	return min(max((int)ceilf(segmentSize / HAIR_TESSELLATION_SCREEN_LENGTH), 1), HAIR_MAX_TESSELLATION);
+}
+
+const std::vector<HairStrandRun>& HairInstance::GetVisibleRuns(const std::vector<int>& guideStrands, int drawStep)
+{
+	clusters.GetVisibleRuns(guideStrands, drawStep, drawRuns);
+	return drawRuns;
+}
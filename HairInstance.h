@@ -0,0 +1,216 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "HairStrand.h"
+#include "HairShared.h"
+#include "HairStepScheduler.h"
+#include "HairRecording.h"
+#include "HairClusters.h"
+
+class Mesh;
+class SimpleComputeShader;
+
+// One slot of the hair state ring, written by the simulation
+// and read back by the next simulation step and the hair draw
+struct HairStateSlot
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+};
+
+// --------------------------------------------------------
+// One entity's simulated hair
+//
+// A furred Mesh owns the groom: roots, rest pose, guides,
+// physics, collision field, everything that only depends on
+// the model. Assets hands the same Mesh to every entity using
+// the model, so whatever moves goes in here instead, one per
+// GameEntity: the state ring, the sleeping strands, which
+// clusters its camera sees, its step scheduler and LOD, its
+// recording or replay. Mesh::CreateHairInstance() makes one
+// and drives it through the calls below, which only ever
+// read the groom. Regrowing the groom rebuilds every instance
+// from it the next time it's used.
+// --------------------------------------------------------
+class HairInstance
+{
+public:
+	// Recordings go to recordingPath, see Mesh::CreateHairInstance
+	HairInstance(const std::string& recordingPath);
+
+	HairInstance(const HairInstance&) = delete;
+	HairInstance& operator=(const HairInstance&) = delete;
+
+	int GetStateSlotCount() { return (int)stateRing.size(); }
+	int GetFrameLatency() { return frameLatency; }
+	// What the ring takes up, the only per vertex memory an instance has
+	unsigned int GetStateBytes();
+
+	// Strands fall asleep on their own once they stop moving, this puts all of them back
+	// in the active list for the next step (forces wake them without asking)
+	void Wake() { wakeRequested = true; }
+	// From a readback a couple of frames old, -1 until the first one arrives
+	int GetActiveStrandCount() { return activeStrands; }
+	int GetSkippedSteps() { return skippedSteps; }
+	HairStepScheduler& GetStepScheduler() { return stepScheduler; }
+	// Largest inertial acceleration anywhere on the hair last step, after scaling and clamping
+	float GetInertialAcceleration() { return inertialAcceleration; }
+
+	int GetLOD() { return lod; }
+	float GetProjectedSize() { return projectedSize; }
+	// -1 picks the level from the projected size
+	void SetForcedLOD(int level) { forcedLOD = level; }
+	int GetForcedLOD() { return forcedLOD; }
+	// Neighbouring strands are culled together, outside every view or facing away from all of them.
+	// Culled strands are neither drawn nor solved, they stand still until they come back into view
+	void SetClusterCulling(bool enabled) { clusterCulling = enabled; }
+	bool GetClusterCulling() { return clusterCulling; }
+	HairClusters& GetClusters() { return clusters; }
+	// -1 = auto, see GetTessellation
+	void SetForcedTessellation(int tessellation) { forcedTessellation = tessellation; }
+	int GetForcedTessellation() { return forcedTessellation; }
+
+	// See Mesh::StartHairRecording and Mesh::StartHairReplay
+	void StopRecording() { recorder.Close(); }
+	bool GetRecording() { return recorder.IsOpen(); }
+	int GetRecordedFrames() { return recorder.GetFrameCount(); }
+	void StopReplay() { replay.Close(); replayPhysicsSRV.Reset(); }
+	bool GetReplaying() { return replay.IsOpen(); }
+	const HairReplayResult& GetReplayResult() { return replayResult; }
+	// What the open replay was recorded with, only this instance is solved with it
+	const HairSolverSettings& GetReplaySettings() { return replay.GetHeader().Settings; }
+	bool GetReplayCollision() { return replay.GetHeader().Collision != 0; }
+	// Null unless a replay is open and the groom's physics table isn't the recorded one
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetReplayPhysicsSRV() { return replay.IsOpen() ? replayPhysicsSRV : 0; }
+	// This instance's own file next to the model, empty if the model didn't come from one
+	const std::string& GetRecordingPath() { return recordingPath; }
+	// Where HairReplay::RunCPU keeps the CPU's own checksums of the same recording
+	std::string GetCPURecordingPath() { return recordingPath + ".cpu"; }
+
+	// Everything from here on is what Mesh drives the instance with, the groom is only read.
+	//
+	// Rebuilds the buffers if the groom was grown again since they were made, and passes on the groom's wakes
+	void Update(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom);
+	// See Mesh::SetHairStateRing
+	void SetStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, int slotCount, int frameLatency);
+	int GetCurrentSlot() { return currentSlot; }
+	const HairStateSlot& GetStateSlot(int slot) { return stateRing[slot]; }
+
+	// restPositions is the groom's rest pose, which only Mesh can read back
+	bool StartRecording(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, const std::vector<DirectX::XMFLOAT3>& restPositions);
+	bool StartReplay(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom);
+
+	// Start of SimulateHair: whatever readbacks have arrived, then which clusters to solve
+	void BeginFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom);
+	// A replay overwrites the frame's arguments, a recording writes them out. True for either,
+	// world and prevWorld are then the recorded ones and the frame has no wind
+	bool RecordFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, float& deltaTime, DirectX::XMFLOAT3& force, DirectX::XMFLOAT4X4& world, DirectX::XMFLOAT4X4& prevWorld);
+	// The force plus the inertia of how the entity moved since the frame before, scaled and clamped
+	HairExternalForces UpdateForces(const Mesh& groom, float deltaTime, DirectX::XMFLOAT3 force, DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 prevWorld, float inertia);
+	// False if every strand is asleep and the step can be skipped. wake = solve every guide of
+	// the LOD instead of only those still moving, disturbed = anything pushed the hair this step
+	bool BeginStep(bool disturbed, bool& wake);
+	// The instance's side of SimulateHair: newest state in, next slot out, visible clusters and the active strands
+	void SetSimulateShaderResources(SimpleComputeShader* simulateCS, bool wake);
+	// Runs the step then sizes the next one from what's still awake, the slot just written becomes the current one
+	void DispatchStep(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, SimpleComputeShader* simulateCS, int guides, bool wake);
+	// End of SimulateHair: boxes the clusters again and copies the state out for a checksum or keyframe
+	void EndFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom, int steps);
+
+	// See Mesh::ResetHairLOD and Mesh::RequestHairLOD
+	void ResetLOD();
+	void RequestLOD(const Mesh& groom, DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
+	// Drawn pieces per LOD segment of the smoothed strands, from the projected segment length
+	int GetTessellation(const Mesh& groom);
+	// Runs of visible strands to draw, kept until the next call
+	const std::vector<HairStrandRun>& GetVisibleRuns(const std::vector<int>& guideStrands, int drawStep);
+
+private:
+	// Which groom the buffers were made for and which of its wakes were seen, see Update
+	int groomVersion;
+	unsigned int groomWake;
+
+	std::vector<HairStateSlot> stateRing;
+	int currentSlot;
+	int frameLatency;
+
+	HairStateSlot activeLists[2];	// Read one, append the other, then swap
+	int currentActiveList;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> sleepBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> sleepUAV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> activeCountBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> activeCountSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> dispatchArgsBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> dispatchArgsUAV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> countReadback[3];
+	unsigned int countReadbackWake[3];	// Which wake each readback belongs to, 0 = nothing copied
+	int readbackFrame;
+	unsigned int wakeCount;
+	bool wakeRequested;
+	int lastSimulatedLOD;
+	int activeStrands;
+	int skippedSteps;
+
+	HairStepScheduler stepScheduler;
+	DirectX::XMFLOAT4X4 frameVelocity;
+	int frameVelocities;	// Inertia needs two in a row, and the very first one isn't trustworthy
+	float inertialAcceleration;
+
+	int lod;
+	int forcedLOD;
+	int forcedTessellation;
+	float projectedSize;
+
+	// The mesh's clusters, with this instance's visibility and bounds
+	HairClusters clusters;
+	bool clusterCulling;
+	std::vector<HairStrandRun> drawRuns;
+	std::vector<unsigned int> uploadedClusterVisibility;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterVisibilityBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterVisibilitySRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> clusterBoundsUAV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterBoundsBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterReadback[3];
+	bool clusterReadbackPending[3];
+	int clusterReadbackFrame;
+
+	std::string recordingPath;
+	HairRecorder recorder;
+	HairReplay replay;
+	HairReplayResult replayResult;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> replayPhysicsSRV;	// Only if the groom's table isn't the recorded one
+	// The state copied for a recording's checksum or keyframe, or a replay's checksum.
+	// Mapped at the start of the next frame so it never waits on the GPU. A copy still
+	// in flight when a recording stops is dropped
+	Microsoft::WRL::ComPtr<ID3D11Buffer> stateReadback;
+	bool stateReadbackPending;
+	bool stateReadbackChecksum;
+	bool stateReadbackKeyframe;
+	unsigned int stateReadbackExpected;	// Replay: what the recording's checksum was
+	int stateReadbackFrame;				// Replay: the frame it was recorded after
+	DirectX::XMFLOAT4X4 recordedWorld;	// The last frame's, what the next one moved from
+
+	static const int defaultStateSlots = 3;	// Latency 1 plus the slot interpolated from
+	static const int defaultFrameLatency = 1;
+	static_assert(defaultStateSlots <= HAIR_MAX_STATE_SLOTS, "Default state ring is bigger than SetStateRing allows");
+
+	void CreateStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, const Mesh& groom, int slotCount);
+	void CreateSleepBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, const Mesh& groom);
+	void CreateClusterBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void UploadClusterVisibility(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void UpdateClusterBounds(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom);
+	void ReadBackClusterBounds(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Mesh& groom);
+	void ReadBackActiveCount(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void ResetForRecording(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	bool NextReplayFrame(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairRecordFrame& frame);
+	bool ReadBackState(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::vector<HairPackedVertex>& state);
+	bool CopyStateToReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	bool MapStateReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::vector<HairPackedVertex>& state);
+	void ResolveStateReadback(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+};
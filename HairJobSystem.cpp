@@ -0,0 +1,126 @@
+#include "HairJobSystem.h"
+
+#include <algorithm>
+
+HairJobSystem::HairJobSystem(int threads) :
+	queues(std::max(threads > 0 ? threads : (int)std::thread::hardware_concurrency(), 1)),
+	job(0),
+	stolen(0),
+	generation(0),
+	busyWorkers(0),
+	quit(false)
+{
+	for (int i = 1; i < (int)queues.size(); i++)
+		this->threads.emplace_back(&HairJobSystem::WorkerLoop, this, i);
+}
+
+HairJobSystem::~HairJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> guard(runLock);
+		quit = true;
+	}
+	startRun.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+void HairJobSystem::Run(int count, const std::function<void(int, int)>& job)
+{
+	// Contiguous shares, so a worker mostly walks through neighbouring batches
+	int workers = (int)queues.size();
+	for (int i = 0; i < workers; i++)
+	{
+		std::lock_guard<std::mutex> guard(queues[i].lock);
+		queues[i].begin = (int)((long long)count * i / workers);
+		queues[i].end = (int)((long long)count * (i + 1) / workers);
+	}
+	this->job = &job;
+	stolen = 0;
+
+	// Counted as busy before they wake, so none can still be stealing when this returns
+	{
+		std::lock_guard<std::mutex> guard(runLock);
+		busyWorkers = workers - 1;
+		generation++;
+	}
+	startRun.notify_all();
+
+	RunBatches(0);
+
+	std::unique_lock<std::mutex> wait(runLock);
+	finishedRun.wait(wait, [this]() { return busyWorkers == 0; });
+	this->job = 0;
+}
+
+void HairJobSystem::WorkerLoop(int worker)
+{
+	unsigned int seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> wait(runLock);
+			startRun.wait(wait, [&]() { return quit || generation != seen; });
+			if (quit)
+				return;
+			seen = generation;
+		}
+
+		RunBatches(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> guard(runLock);
+			last = --busyWorkers == 0;
+		}
+		if (last)
+			finishedRun.notify_one();
+	}
+}
+
+void HairJobSystem::RunBatches(int worker)
+{
+	int batch;
+	while (TakeOwn(worker, batch) || Steal(worker, batch))
+		(*job)(batch, worker);
+}
+
+bool HairJobSystem::TakeOwn(int worker, int& batch)
+{
+	BatchQueue& queue = queues[worker];
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.begin >= queue.end)
+		return false;
+	batch = queue.begin++;
+	return true;
+}
+
+// Only called once the worker's own share is empty, so the stolen half can simply replace it
+bool HairJobSystem::Steal(int worker, int& batch)
+{
+	int workers = (int)queues.size();
+	for (int i = 1; i < workers; i++)
+	{
+		BatchQueue& victim = queues[(worker + i) % workers];
+		int first, end;
+		{
+			std::lock_guard<std::mutex> guard(victim.lock);
+			int left = victim.end - victim.begin;
+			if (left <= 0)
+				continue;
+			first = victim.end - (left + 1) / 2;
+			end = victim.end;
+			victim.end = first;
+		}
+
+		stolen += end - first;
+		{
+			std::lock_guard<std::mutex> guard(queues[worker].lock);
+			queues[worker].begin = first + 1;
+			queues[worker].end = end;
+		}
+		batch = first;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Work stealing thread pool for the CPU hair solver
+//
+// Run() hands out batch indices 0 to count - 1. Every worker
+// starts with an even, contiguous share and takes batches off
+// the front of it. Once its share is gone it steals the back
+// half of someone else's, so uneven batches even out without
+// a shared counter every batch has to go through. The thread
+// calling Run() works too and returns once every batch is done.
+// Which worker runs a batch is not deterministic, so jobs must
+// only write to what their batch owns.
+// --------------------------------------------------------
+class HairJobSystem
+{
+public:
+	// threads = 0 uses every core, the calling thread counts as one of them
+	explicit HairJobSystem(int threads = 0);
+	~HairJobSystem();
+
+	HairJobSystem(const HairJobSystem&) = delete;
+	HairJobSystem& operator=(const HairJobSystem&) = delete;
+
+	// job(batch, worker) once for every batch, worker is 0 to GetWorkerCount() - 1
+	void Run(int count, const std::function<void(int, int)>& job);
+
+	int GetWorkerCount() { return (int)queues.size(); }
+	// Batches taken from another worker's share during the last Run()
+	int GetStolenCount() { return stolen; }
+
+private:
+	// Whatever is left of one worker's share, on its own cache line so neighbours don't fight over it
+	struct alignas(64) BatchQueue
+	{
+		std::mutex lock;
+		int begin = 0;
+		int end = 0;
+	};
+
+	void WorkerLoop(int worker);
+	void RunBatches(int worker);
+	bool TakeOwn(int worker, int& batch);
+	bool Steal(int worker, int& batch);
+
+	std::vector<BatchQueue> queues;
+	std::vector<std::thread> threads;
+	const std::function<void(int, int)>* job;
+	std::atomic<int> stolen;
+
+	// Workers sleep until the generation changes, Run() waits until none of them are busy
+	std::mutex runLock;
+	std::condition_variable startRun;
+	std::condition_variable finishedRun;
+	unsigned int generation;
+	int busyWorkers;
+	bool quit;
+};
@@ -1,5 +1,6 @@
 #include "HelperMethods.hlsli"
 #include "Lighting.hlsli"
+#include "HairShared.h"
 
 struct VertexToPixel
 {
@@ -7,6 +8,7 @@ struct VertexToPixel
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
 	float3 tangent			: TANGENT;
+	float3 strandDirection	: STRAND;	// Along the strand towards the tip
 	float3 worldPos			: POSITION; // The world position of this vertex
 	float4 prevScreenPos	: SCREEN_POS0;// The world position of this vertex last frame
 	float4 currentScreenPos	: SCREEN_POS1;
@@ -21,8 +23,7 @@ struct PS_Output
 };
 
 cbuffer HairConstants	: register(b2) {
-	float metalVal;
-	float roughnessVal;
+	int shadingModel;		// HAIR_SHADING_KAJIYA_KAY or HAIR_SHADING_MARSCHNER
 }
 
 #define MAX_LIGHTS 128
@@ -60,6 +61,56 @@ Texture2D BrdfLookUpMap		: register(t0);
 TextureCube IrradianceIBLMap	: register(t1);
 TextureCube SpecularIBLMap	: register(t2);
 Texture2D NormalMap			: register(t3);
+// Baked by HairShading, see HairShading.h for what's in them
+Texture2D HairLongitudinalLUT	: register(t4);
+Texture2D HairAzimuthalLUT	: register(t5);
+Texture2D<float> HairColorBlendLUT	: register(t6);
+
+// Direction to the light and how much of it arrives, for any type of light
+float3 HairLightIncoming(Light light, float3 worldPos, out float3 toLight)
+{
+	if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		toLight = normalize(-light.Direction);
+		return light.Intensity * light.Color;
+	}
+
+	toLight = normalize(light.Position - worldPos);
+	float atten = Attenuate(light, worldPos);
+	if (light.Type == LIGHT_TYPE_SPOT)
+		atten *= pow(saturate(dot(-toLight, light.Direction)), light.SpotFalloff);
+	return atten * light.Intensity * light.Color;
+}
+
+// Marschner R, TT and TRT lobes out of the lookup tables. TT passes through the
+// fibre once and TRT twice, so they pick up the hair's color that many times
+float3 HairMarschner(float3 strand, float3 toLight, float3 toCamera, float3 hairColor)
+{
+	float sinThetaI = dot(toLight, strand);
+	float sinThetaR = dot(toCamera, strand);
+	float4 longitudinal = HairLongitudinalLUT.Sample(ClampSampler, float2(sinThetaI, sinThetaR) * 0.5f + 0.5f);
+	float cosThetaD = longitudinal.a;
+
+	// Azimuth between the light and camera around the fibre
+	float3 lightPerp = toLight - strand * sinThetaI;
+	float3 cameraPerp = toCamera - strand * sinThetaR;
+	float cosPhi = dot(lightPerp, cameraPerp) * rsqrt(dot(lightPerp, lightPerp) * dot(cameraPerp, cameraPerp) + 0.0001f);
+	float3 azimuthal = HairAzimuthalLUT.Sample(ClampSampler, float2(cosPhi * 0.5f + 0.5f, cosThetaD)).rgb;
+
+	float3 scattered = longitudinal.r * azimuthal.r +
+		longitudinal.g * azimuthal.g * hairColor +
+		longitudinal.b * azimuthal.b * hairColor * hairColor;
+	float cosThetaI = sqrt(saturate(1.0f - sinThetaI * sinThetaI));
+	return scattered * cosThetaI / max(cosThetaD * cosThetaD, 0.01f);
+}
+
+// The cheap tier, a highlight where the half vector is across the strand
+float3 HairKajiyaKaySpecular(float3 strand, float3 toLight, float3 toCamera)
+{
+	float3 halfVector = normalize(toLight + toCamera);
+	float sinTH = sqrt(saturate(1.0f - pow(dot(strand, halfVector), 2)));
+	return pow(sinTH, 64.0f) * 0.5f * F0_NON_METAL;
+}
 
 PS_Output main(VertexToPixel input) : SV_TARGET
 {
@@ -69,11 +120,8 @@ PS_Output main(VertexToPixel input) : SV_TARGET
 	}*/
 	PS_Output output;
 
-	float sinVal = input.uv.y * (3.14159265f/2.0f);
-	float blendVal = sin(sinVal);
-	float randVal = abs(perlin(input.uv.x, input.uv.y)) * 1.0f;
-	blendVal -= randVal;
-	blendVal = clamp(blendVal, 0, 1);
+	// Root to tip, one fetch of what used to be worked out per pixel
+	float blendVal = HairColorBlendLUT.Sample(ClampSampler, input.uv);
 	float4 baseColor = float4(0.38f, 0.35f, 0.27f, 1.0f);
 	float4 tipColor = float4(0.98f, 0.94f, 0.74f, 1.0f);
 	float4 surfaceColor = lerp(baseColor, tipColor, blendVal);
@@ -81,77 +129,35 @@ PS_Output main(VertexToPixel input) : SV_TARGET
 	// Always re-normalize interpolated direction vectors
 	input.normal = normalize(input.normal);
 	input.tangent = normalize(input.tangent);
+	float3 strand = normalize(input.strandDirection);
 
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
 
-	float roughness = roughnessVal;
-	float metal = metalVal;
-
 	// Gamma correct the texture back to linear space and apply the color tint
 	surfaceColor.rgb = pow(surfaceColor.rgb, 2.2);
 
-	// Specular color - Assuming albedo texture is actually holding specular color if metal == 1
-	// Note the use of lerp here - metal is generally 0 or 1, but might be in between
-	// because of linear texture sampling, so we want lerp the specular color to match
-	float3 specColor = lerp(F0_NON_METAL.rrr, surfaceColor.rgb, metal);
-
 	// Total color for this pixel
 	float3 totalColor = float3(0, 0, 0);
+	float3 toCamera = normalize(cameraPosition - input.worldPos);
 
-	// Loop through all lights this frame
+	// Loop through all lights this frame. Both models keep a Kajiya-Kay diffuse term,
+	// standing in for the light scattered between strands that neither of them has
 	for (int i = 0; i < lightCount; i++)
 	{
-		// Which kind of light?
-		switch (lights[i].Type)
-		{
-		case LIGHT_TYPE_DIRECTIONAL:
-			totalColor += DirLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
-			break;
-
-		case LIGHT_TYPE_POINT:
-			totalColor += PointLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
-			break;
-
-		case LIGHT_TYPE_SPOT:
-			totalColor += SpotLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
-			break;
-		}
+		float3 toLight;
+		float3 incoming = HairLightIncoming(lights[i], input.worldPos, toLight);
+		float sinTL = sqrt(saturate(1.0f - pow(dot(strand, toLight), 2)));
+		float3 diffuse = surfaceColor.rgb * sinTL / PI;
+
+		float3 specular = shadingModel == HAIR_SHADING_MARSCHNER ?
+			HairMarschner(strand, toLight, toCamera, surfaceColor.rgb) :
+			HairKajiyaKaySpecular(strand, toLight, toCamera);
+		totalColor += (diffuse + specular) * incoming;
 	}
 
-	// Calculate requisite reflection vectors
-
-	float3 viewToCam = normalize(cameraPosition - input.worldPos);
-
-	float3 viewRefl = normalize(reflect(-viewToCam, input.normal));
-
-	float NdotV = saturate(dot(input.normal, viewToCam));
-
-
-	// Indirect lighting
-
+	// Indirect lighting, the irradiance around the surface the strand grows from
 	float3 indirectDiffuse = IndirectDiffuse(IrradianceIBLMap, BasicSampler, input.normal);
-
-	float3 indirectSpecular = IndirectSpecular(
-
-		SpecularIBLMap, specIBLTotalMipLevels,
-
-		BrdfLookUpMap, ClampSampler, // MUST use the clamp sampler here!
-
-		viewRefl, NdotV,
-
-		roughness, specColor);
-
-
-	// Balance indirect diff/spec
-
-	float3 balancedDiff = DiffuseEnergyConserve(indirectDiffuse, indirectSpecular, metal);
-
-	float3 fullIndirect =  balancedDiff * surfaceColor.rgb;
-
-	// Add the indirect to the direct
-
-	totalColor += fullIndirect;
-
+	totalColor += indirectDiffuse * surfaceColor.rgb;
 
 	// Gamma correction
 	output.color = float4(pow(totalColor, 1.0f / 2.2f), 1);
@@ -0,0 +1,119 @@
+// --------------------------------------------------------
+// Compact hair state, shared by the C++ and HLSL code
+//
+// Written in the subset both compilers accept so there is
+// only one copy of the encoding. Positions are 16 bit fixed
+// point offsets from the strand's root, the step's motion
+// (position - previous position) is 16 bit fixed point too,
+// both scaled per mesh (see Mesh::GetHairStateScale).
+// The per vertex physics table is packed here too.
+// HLSL has to include HairGenerics.hlsli first.
+// --------------------------------------------------------
+#ifndef _HAIRPACKING_H
+#define _HAIRPACKING_H
+
+#include "HairShared.h"
+
+#ifdef __cplusplus
+#include <DirectXMath.h>
+#include <cmath>
+#include "HairStrand.h"
+#define HAIR_FUNC inline
+#define HAIR_FLOAT3 DirectX::XMFLOAT3
+#define HAIR_UINT unsigned int
+#define HAIR_FLOOR std::floor
+#define HAIR_CLAMP(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+#else
+#define HAIR_FUNC
+#define HAIR_FLOAT3 float3
+#define HAIR_UINT uint
+#define HAIR_FLOOR floor
+#define HAIR_CLAMP clamp
+#endif
+
+// What the state ring holds, 12 bytes instead of HairSimVertex's 24:
+// [0] = offset x | offset y << 16
+// [1] = offset z | motion x << 16
+// [2] = motion y | motion z << 16
+struct HairPackedVertex
+{
+	HAIR_UINT Packed[3];
+};
+
+// -range to range into 16 bits, anything outside is clamped
+HAIR_FUNC HAIR_UINT HairPackSnorm16(float value, float range)
+{
+	float normalized = HAIR_CLAMP(value / range, -1.0f, 1.0f);
+	int quantized = (int)HAIR_FLOOR(normalized * 32767.0f + 0.5f);
+	return (HAIR_UINT)quantized & 0xFFFF;
+}
+
+HAIR_FUNC float HairUnpackSnorm16(HAIR_UINT bits, float range)
+{
+	// Sign extend the low 16 bits
+	int quantized = ((int)(bits << 16)) >> 16;
+	return quantized / 32767.0f * range;
+}
+
+// scale = how far from its root any vertex can get
+HAIR_FUNC HairPackedVertex HairPackVertex(HAIR_FLOAT3 position, HAIR_FLOAT3 prevPosition, HAIR_FLOAT3 root, float scale)
+{
+	float motionRange = scale * HAIR_PACKED_MOTION_RANGE;
+	HairPackedVertex packed;
+	packed.Packed[0] = HairPackSnorm16(position.x - root.x, scale) | (HairPackSnorm16(position.y - root.y, scale) << 16);
+	packed.Packed[1] = HairPackSnorm16(position.z - root.z, scale) | (HairPackSnorm16(position.x - prevPosition.x, motionRange) << 16);
+	packed.Packed[2] = HairPackSnorm16(position.y - prevPosition.y, motionRange) | (HairPackSnorm16(position.z - prevPosition.z, motionRange) << 16);
+	return packed;
+}
+
+// The previous position comes from the unpacked position, so the motion survives exactly as stored
+HAIR_FUNC HairSimVertex HairUnpackVertex(HairPackedVertex packed, HAIR_FLOAT3 root, float scale)
+{
+	float motionRange = scale * HAIR_PACKED_MOTION_RANGE;
+	HairSimVertex vertex;
+	vertex.Position = HAIR_FLOAT3(
+		root.x + HairUnpackSnorm16(packed.Packed[0], scale),
+		root.y + HairUnpackSnorm16(packed.Packed[0] >> 16, scale),
+		root.z + HairUnpackSnorm16(packed.Packed[1], scale));
+	vertex.PreviousPosition = HAIR_FLOAT3(
+		vertex.Position.x - HairUnpackSnorm16(packed.Packed[1] >> 16, motionRange),
+		vertex.Position.y - HairUnpackSnorm16(packed.Packed[2], motionRange),
+		vertex.Position.z - HairUnpackSnorm16(packed.Packed[2] >> 16, motionRange));
+	return vertex;
+}
+
+// Unpacked HAIR_PHYSICS_DEFAULT is 1, 1, 1, 0: the solver settings as they are, nothing pinned
+struct HairVertexPhysics
+{
+	float Stiffness;	// Times the bend and shape stiffness
+	float Damping;		// Times the damping
+	float LengthScale;	// Times the groomed length of the segment ending at this vertex
+	float PinWeight;	// 0-1, how far every iteration pulls it back onto the rest pose
+};
+
+HAIR_FUNC HAIR_UINT HairPackPhysics(float stiffness, float damping, float lengthScale, float pinWeight)
+{
+	HAIR_UINT s = (HAIR_UINT)HAIR_CLAMP(HAIR_FLOOR(stiffness * HAIR_PHYSICS_UNIT + 0.5f), 0.0f, 255.0f);
+	HAIR_UINT d = (HAIR_UINT)HAIR_CLAMP(HAIR_FLOOR(damping * HAIR_PHYSICS_UNIT + 0.5f), 0.0f, 255.0f);
+	HAIR_UINT l = (HAIR_UINT)HAIR_CLAMP(HAIR_FLOOR(lengthScale * HAIR_PHYSICS_UNIT + 0.5f), 0.0f, 255.0f);
+	HAIR_UINT p = (HAIR_UINT)HAIR_CLAMP(HAIR_FLOOR(pinWeight * 255.0f + 0.5f), 0.0f, 255.0f);
+	return s | (d << 8) | (l << 16) | (p << 24);
+}
+
+HAIR_FUNC HairVertexPhysics HairUnpackPhysics(HAIR_UINT packed)
+{
+	HairVertexPhysics physics;
+	physics.Stiffness = (packed & 0xFF) / HAIR_PHYSICS_UNIT;
+	physics.Damping = ((packed >> 8) & 0xFF) / HAIR_PHYSICS_UNIT;
+	physics.LengthScale = ((packed >> 16) & 0xFF) / HAIR_PHYSICS_UNIT;
+	physics.PinWeight = (packed >> 24) / 255.0f;
+	return physics;
+}
+
+#undef HAIR_FUNC
+#undef HAIR_FLOAT3
+#undef HAIR_UINT
+#undef HAIR_FLOOR
+#undef HAIR_CLAMP
+
+#endif
@@ -0,0 +1,134 @@
+#include "HairParallelSimulator.h"
+#include "HairBenchmark.h"
+#include "HairVoxelGrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+int HairParallelSimulator::GetBatchStrands(int vertsPerStrand)
+{
+	int bytesPerStrand = (sizeof(HairSimVertex) + sizeof(HairRestVertex) + sizeof(unsigned int)) * vertsPerStrand;
+	return std::max(HAIR_CPU_BATCH_BYTES / bytesPerStrand / 4, 1) * 4;
+}
+
+HairStepStats HairParallelSimulator::Simulate(HairJobSystem& jobs, HairSimVertex* simData, const HairRestVertex* restData,
+	const int* guideStrands, int numOfGuides, const HairFollower* followers, int numOfFollowers, int vertsPerStrand,
+	const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData, const HairSolverFields* fields)
+{
+	// Every batch keeps its own totals, nothing is shared between threads until the reduction
+	struct BatchStats
+	{
+		int resting;
+		float maxMotion;
+		double motionSum;
+	};
+	int batchStrands = GetBatchStrands(vertsPerStrand);
+	int guideBatches = (numOfGuides + batchStrands - 1) / batchStrands;
+	std::vector<BatchStats> batchStats(guideBatches);
+
+	// Every guide has to be in the grid before any batch samples it
+	if (fields && fields->Volume && (settings.VolumePressure > 0 || settings.VolumeFriction > 0))
+		fields->Volume->Splat(simData, guideStrands, numOfGuides, vertsPerStrand, deltaTime);
+
+	jobs.Run(guideBatches, [&](int batch, int)
+	{
+		int first = batch * batchStrands;
+		int count = std::min(batchStrands, numOfGuides - first);
+		HairSimulator::SimulateGuides(simData, restData, guideStrands + first, count, vertsPerStrand, settings, forces, deltaTime, physicsData, fields);
+
+		BatchStats stats = {};
+		for (int g = first; g < first + count; g++)
+		{
+			const HairSimVertex* strand = simData + guideStrands[g] * vertsPerStrand;
+			float motion = 0;
+			for (int v = 0; v < vertsPerStrand; v++)
+				motion = std::max(motion, XMVectorGetX(XMVector3Length(XMLoadFloat3(&strand[v].Position) - XMLoadFloat3(&strand[v].PreviousPosition))));
+			stats.resting += motion < HAIR_SLEEP_DISTANCE ? 1 : 0;
+			stats.maxMotion = std::max(stats.maxMotion, motion);
+			stats.motionSum += motion;
+		}
+		batchStats[batch] = stats;
+	});
+
+	// Followers only read guides, which are all done by now
+	int followerBatches = (numOfFollowers + batchStrands - 1) / batchStrands;
+	jobs.Run(followerBatches, [&](int batch, int)
+	{
+		int first = batch * batchStrands;
+		HairSimulator::InterpolateFollowers(simData, restData, followers + first, std::min(batchStrands, numOfFollowers - first), vertsPerStrand);
+	});
+
+	HairStepStats result = {};
+	result.strands = numOfGuides;
+	double motionSum = 0;
+	for (const BatchStats& stats : batchStats)
+	{
+		result.restingStrands += stats.resting;
+		result.maxMotion = std::max(result.maxMotion, stats.maxMotion);
+		motionSum += stats.motionSum;
+	}
+	result.meanMotion = (float)(motionSum / std::max(numOfGuides, 1));
+	return result;
+}
+
+HairScalingResult HairParallelSimulator::MeasureScaling(int numOfStrands, int steps, int maxThreads, int vertsPerStrand)
+{
+	vertsPerStrand = std::min(std::max(vertsPerStrand, 2), HAIR_MAX_VERTS_PER_STRAND);
+	maxThreads = maxThreads > 0 ? maxThreads : std::max((int)std::thread::hardware_concurrency(), 1);
+
+	std::vector<HairSimVertex> start;
+	std::vector<HairRestVertex> restData;
+	HairBenchmark::CreateTestGroom(numOfStrands, vertsPerStrand, start, restData);
+	std::vector<int> allStrands(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		allStrands[i] = i;
+	HairSolverSettings settings = HairSimulator::GetDefaultSettings();
+
+	HairScalingResult result = {};
+	result.numOfStrands = numOfStrands;
+	result.vertsPerStrand = vertsPerStrand;
+	result.steps = steps;
+	result.batchStrands = GetBatchStrands(vertsPerStrand);
+	result.deterministic = true;
+
+	std::vector<HairSimVertex> firstRun;
+	HairStepStats firstStats = {};
+	for (int threads = 1; result.runs < HAIR_SCALING_MAX_RUNS; threads = std::min(threads * 2, maxThreads))
+	{
+		HairJobSystem jobs(threads);
+		std::vector<HairSimVertex> simData = start;
+		HairExternalForces forces = {};
+		HairStepStats stats = {};
+		int stolen = 0;
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < steps; i++)
+		{
+			// Swinging back and forth so nothing comes to rest
+			forces.Force = XMFLOAT3((i / 30) % 2 ? -1.0f : 1.0f, 0, 0.5f);
+			stats = Simulate(jobs, simData.data(), restData.data(), allStrands.data(), numOfStrands, 0, 0, vertsPerStrand, settings, forces, HAIR_FIXED_TIMESTEP);
+			stolen += jobs.GetStolenCount();
+		}
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - begin;
+
+		result.threadCounts[result.runs] = threads;
+		result.millisecondsPerStep[result.runs] = time.count() / std::max(steps, 1);
+		result.stolenBatches[result.runs] = stolen;
+		if (result.runs == 0)
+		{
+			firstRun.swap(simData);
+			firstStats = stats;
+		}
+		else if (memcmp(firstRun.data(), simData.data(), simData.size() * sizeof(HairSimVertex)) != 0 || memcmp(&firstStats, &stats, sizeof(HairStepStats)) != 0)
+			result.deterministic = false;
+		result.runs++;
+
+		if (threads >= maxThreads)
+			break;
+	}
+	return result;
+}
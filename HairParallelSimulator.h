@@ -0,0 +1,51 @@
+#pragma once
+
+#include "HairSimulator.h"
+#include "HairJobSystem.h"
+
+// What a step of HairParallelSimulator::Simulate did. Reduced batch by batch in order,
+// so it comes out the same on any number of threads
+struct HairStepStats
+{
+	int strands;
+	int restingStrands;		// Moved less than HAIR_SLEEP_DISTANCE, what would count towards sleeping on the GPU
+	float maxMotion;		// Furthest any vertex moved this step
+	float meanMotion;		// Of each strand's furthest moving vertex
+};
+
+// HairParallelSimulator's throughput on a synthetic groom at 1, 2, 4... threads
+#define HAIR_SCALING_MAX_RUNS 8
+struct HairScalingResult
+{
+	int numOfStrands;
+	int vertsPerStrand;
+	int steps;
+	int batchStrands;
+	int runs;
+	int threadCounts[HAIR_SCALING_MAX_RUNS];
+	double millisecondsPerStep[HAIR_SCALING_MAX_RUNS];
+	int stolenBatches[HAIR_SCALING_MAX_RUNS];	// Over the whole run
+	bool deterministic;		// Every run ended in the same state with the same stats
+};
+
+// --------------------------------------------------------
+// The CPU solver on a HairJobSystem
+//
+// Guides are cut into batches of GetBatchStrands() strands
+// that each only write their own strands, so whichever worker
+// runs a batch the result is bit for bit what the single
+// threaded HairSimulator calls give.
+// --------------------------------------------------------
+class HairParallelSimulator
+{
+public:
+	// HairSimulator::SimulateGuides then InterpolateFollowers, a batch of guides or followers per job
+	static HairStepStats Simulate(HairJobSystem& jobs, HairSimVertex* simData, const HairRestVertex* restData,
+		const int* guideStrands, int numOfGuides, const HairFollower* followers, int numOfFollowers, int vertsPerStrand,
+		const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData = 0, const HairSolverFields* fields = 0);
+	// Strands per batch, a multiple of the four SIMD lanes so batches group strands like SimulateGuides does
+	static int GetBatchStrands(int vertsPerStrand);
+
+	// Simulates a synthetic groom with Simulate() at 1, 2, 4... threads up to maxThreads (0 = every core)
+	static HairScalingResult MeasureScaling(int numOfStrands, int steps, int maxThreads = 0, int vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1);
+};
@@ -1,82 +1,94 @@
 // Include guard
 #ifndef _HAIRPHYSICSHELPER_HLSL
 #define _HAIRPHYSICSHELPER_HLSL
-#define HAIR_WEIGHT 0.1f
-#define MAX_ACCELERATION float3(0.5f, 0.5f, 0.5f)
-#define MIN_ACCELERATION float3(-0.5f, -0.5f, -0.5f)
-/*
-* a = lever arm
-* b = vector connected to lever arm
-* F = Force vector being applied
-*/
-float3 Torque(float3 a, float3 b, float3 F) {
-	float theta = acos(dot(a, b) / abs(a) * abs(b));
-	float radius = length(a);
+#include "HairShared.h"
 
-	float3 torque = radius * F * (sin(theta));
-	return torque;
-}
+// Position based dynamics helpers for the hair solver.
+// HairSimulator.cpp has the CPU version of all of these, keep them in sync!
+// SolveVolume's is HairVoxelGrid::SolveVertex
 
 /*
-* currentAccel = Unit's current acceleration
-* force = Force being applied to object in 3 dimnesions
-* mass = mass of object in kg
+* position = current position, becomes the new position
+* prevPosition = position last step, becomes the current position
+* acceleration = external acceleration this step
+* damping = fraction of the velocity lost every step
 */
-float3 AccelerationCalc(float3 force, float mass) {
-	return (force * mass);
+void VerletIntegrate(inout float3 position, inout float3 prevPosition, float3 acceleration, float damping, float deltaTime)
+{
+	float3 velocity = (position - prevPosition) * (1.0f - damping);
+	prevPosition = position;
+	position = position + velocity + acceleration * (deltaTime * deltaTime);
 }
 
 /*
-* acceleration = current acceleration of object
-* currentSpeed = current speed of object
-* deltaTime = time since last frame
+* Moves two points along the line between them towards restLength apart
+* invMass0/1 = 0 means that point is pinned
+* stiffness = 0-1, how much of the error to correct
 */
-float3 SpeedCalc(float3 acceleration, float3 currentSpeed, float deltaTime) {
-	return currentSpeed + float3(acceleration * deltaTime);
+void SolveDistance(inout float3 p0, inout float3 p1, float restLength, float invMass0, float invMass1, float stiffness)
+{
+	float3 delta = p1 - p0;
+	float len = length(delta);
+	float scale = len > HAIR_CONSTRAINT_EPSILON ? (len - restLength) / max(len, HAIR_CONSTRAINT_EPSILON) * stiffness / (invMass0 + invMass1) : 0.0f;
+	float3 correction = delta * scale;
+	p0 += correction * invMass0;
+	p1 -= correction * invMass1;
 }
 
 /*
-* currentPosition = new position of vertex
-* speed = resulting speed this frame of object
-* deltaTime = time since last frame
+* Pulls a point towards where the groom put it
 */
-float3 PositionCalc(float3 currentPosition, float3 speed, float deltaTime) {
-	return currentPosition + (speed * deltaTime);
+float3 SolveShape(float3 position, float3 restPosition, float stiffness)
+{
+	return position + (restPosition - position) * stiffness;
 }
 
-HairStrand SimulateHair(HairStrand strand, float3 force, float deltaTime, float2x3 constraints)
+/*
+* Pushes a point out of a signed distance field until it's margin away from the surface.
+* uvw = the point in the field's 0-1 space, texel = one cell in that space.
+* One sample when clear, six more for the gradient when inside, whatever the mesh
+*/
+float3 SolveCollision(float3 position, float3 uvw, float texel, float margin, Texture3D<float> field, SamplerState clampSampler)
 {
-	//Find how close our position is to a constraint
-	//If we've reached it or surpassed it we want to eliminate force in that direction
-	//And stop any movement/acceleration in that direction
-	float3 minConstraint = float3(constraints._m00, constraints._m01, constraints._m02);
-	float3 maxConstraint = float3(constraints._m10, constraints._m11, constraints._m12);
-	float3 minDiff = strand.Position - minConstraint;
-	float3 minConstraintDiff = clamp(ceil(minDiff), float3(0, 0, 0), float3(1, 1, 1));
-	float3 maxDiff = maxConstraint - strand.Position;
-	float3 maxConstraintDiff = clamp(ceil(maxDiff), float3(0, 0, 0), float3(1, 1, 1));
+	float distance = field.SampleLevel(clampSampler, uvw, 0);
+	if (distance >= margin)
+		return position;
 
-	float3 minAccel = minConstraintDiff * MIN_ACCELERATION;
-	float3 maxAccel = maxConstraintDiff * MAX_ACCELERATION;
+	float3 gradient = float3(
+		field.SampleLevel(clampSampler, uvw + float3(texel, 0, 0), 0) - field.SampleLevel(clampSampler, uvw - float3(texel, 0, 0), 0),
+		field.SampleLevel(clampSampler, uvw + float3(0, texel, 0), 0) - field.SampleLevel(clampSampler, uvw - float3(0, texel, 0), 0),
+		field.SampleLevel(clampSampler, uvw + float3(0, 0, texel), 0) - field.SampleLevel(clampSampler, uvw - float3(0, 0, texel), 0));
+	float gradientLength = length(gradient);
+	if (gradientLength < HAIR_CONSTRAINT_EPSILON)
+		return position;
+	return position + gradient / gradientLength * (margin - distance);
+}
 
-	float3 forceDirection = (strand.OriginalPosition - strand.Position);
-	if (length(forceDirection) < 0.01f && length(force) == 0) {
-		forceDirection = float3(0, 0, 0);
-		strand.Acceleration = float3(0, 0, 0);
-		strand.Speed = float3(0, 0, 0);
-	}
-	else {
-		float3 acceleration = AccelerationCalc(forceDirection, HAIR_WEIGHT);
-		float3 accelerationFromForce = AccelerationCalc(force, HAIR_WEIGHT);
-		strand.Acceleration = clamp(strand.Acceleration + (acceleration + accelerationFromForce), minAccel, maxAccel);
-		float3 speed = SpeedCalc(strand.Acceleration, strand.Speed, deltaTime);
-		strand.Speed = clamp(speed, minAccel, maxAccel);
-	}
+/*
+* Hair-hair interaction from the voxel grid (x = density, yzw = average velocity), before integrating.
+* friction = 0-1, how much of the way towards the cell's velocity.
+* pressure pushes both positions down the density gradient, so it doesn't turn into velocity
+*/
+void SolveVolume(inout float3 position, inout float3 prevPosition, float3 uvw, float texel, float cellSize, float pressure, float friction, float deltaTime, Texture3D<float4> field, SamplerState clampSampler)
+{
+	float4 cell = field.SampleLevel(clampSampler, uvw, 0);
+	if (cell.x <= 0)
+		return;
 
-	float3 offset = (strand.Speed * deltaTime);
+	float3 velocity = (position - prevPosition) / deltaTime;
+	velocity += (cell.yzw - velocity) * friction;
+	prevPosition = position - velocity * deltaTime;
 
-	strand.Position = clamp((strand.Position + offset), minConstraint, maxConstraint);
+	float3 gradient = float3(
+		field.SampleLevel(clampSampler, uvw + float3(texel, 0, 0), 0).x - field.SampleLevel(clampSampler, uvw - float3(texel, 0, 0), 0).x,
+		field.SampleLevel(clampSampler, uvw + float3(0, texel, 0), 0).x - field.SampleLevel(clampSampler, uvw - float3(0, texel, 0), 0).x,
+		field.SampleLevel(clampSampler, uvw + float3(0, 0, texel), 0).x - field.SampleLevel(clampSampler, uvw - float3(0, 0, texel), 0).x) * 0.5f;
+	float3 push = -gradient * (pressure * cellSize / max(cell.x, 1.0f));
+	float pushLength = length(push);
+	if (pushLength > cellSize * 0.5f)
+		push *= cellSize * 0.5f / pushLength;
 
-	return strand;
+	position += push;
+	prevPosition += push;
 }
-#endif
\ No newline at end of file
+#endif
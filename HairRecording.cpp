@@ -0,0 +1,299 @@
+#include "HairRecording.h"
+#include "HairSimulator.h"
+#include "HairStepScheduler.h"
+#include "HairHash.h"
+#include "HairParallelSimulator.h"
+#include "HairVoxelGrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace DirectX;
+
+HairRecorder::HairRecorder() :
+	stateCount(0),
+	frames(0),
+	checksumInterval(0),
+	keyframeInterval(0)
+{
+}
+
+bool HairRecorder::Open(const std::string& path, const HairRecordingHeader& header, const XMFLOAT3* restPositions, const unsigned int* physics,
+	const HairCollisionField* collision, int checksumInterval, int keyframeInterval)
+{
+	Close();
+	if (header.Collision && !collision)
+		return false;
+	out.open(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	HairRecordingHeader written = header;
+	memcpy(written.Magic, "HREC", 4);
+	written.Version = HAIR_RECORD_VERSION;
+	stateCount = header.NumOfStrands * header.VertsPerStrand;
+	frames = 0;
+	this->checksumInterval = checksumInterval;
+	this->keyframeInterval = keyframeInterval;
+
+	out.write((const char*)&written, sizeof(HairRecordingHeader));
+	out.write((const char*)restPositions, stateCount * sizeof(XMFLOAT3));
+	out.write((const char*)physics, stateCount * sizeof(unsigned int));
+	if (header.Collision)
+		collision->Write(out);
+	return out.good();
+}
+
+void HairRecorder::Close()
+{
+	if (out.is_open())
+		out.close();
+}
+
+void HairRecorder::WriteFrame(const HairRecordFrame& frame)
+{
+	out.put(HAIR_RECORD_FRAME);
+	out.write((const char*)&frame, sizeof(HairRecordFrame));
+	frames++;
+}
+
+void HairRecorder::WriteChecksum(unsigned int checksum)
+{
+	out.put(HAIR_RECORD_CHECKSUM);
+	out.write((const char*)&checksum, sizeof(unsigned int));
+}
+
+void HairRecorder::WriteKeyframe(const HairPackedVertex* state)
+{
+	out.put(HAIR_RECORD_KEYFRAME);
+	out.write((const char*)state, stateCount * sizeof(HairPackedVertex));
+}
+
+unsigned int HairRecorder::Checksum(const HairPackedVertex* state, int count)
+{
+	return HairHashBytes(state, count * sizeof(HairPackedVertex));
+}
+
+HairReplay::HairReplay() :
+	header(),
+	frame(),
+	checksum(0),
+	frames(0)
+{
+}
+
+bool HairReplay::Open(const std::string& path)
+{
+	Close();
+	in.open(path, std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	in.read((char*)&header, sizeof(HairRecordingHeader));
+	if (!in.good() || memcmp(header.Magic, "HREC", 4) != 0 || header.Version != HAIR_RECORD_VERSION ||
+		header.NumOfStrands == 0 || header.VertsPerStrand < 2 || header.VertsPerStrand > HAIR_MAX_VERTS_PER_STRAND)
+	{
+		Close();
+		return false;
+	}
+
+	size_t count = (size_t)header.NumOfStrands * header.VertsPerStrand;
+	restPositions.resize(count);
+	physics.resize(count);
+	in.read((char*)restPositions.data(), count * sizeof(XMFLOAT3));
+	in.read((char*)physics.data(), count * sizeof(unsigned int));
+	collision = HairCollisionField();
+	if (!in.good() || (header.Collision && !collision.Read(in)))
+	{
+		Close();
+		return false;
+	}
+	frames = 0;
+	return true;
+}
+
+void HairReplay::Close()
+{
+	if (in.is_open())
+		in.close();
+	in.clear();
+}
+
+bool HairReplay::Next(char& tag)
+{
+	int read = in.get();
+	if (read == EOF)
+		return false;
+	tag = (char)read;
+
+	// A chunk cut off at the end is where the recording stopped, not an error
+	switch (tag)
+	{
+	case HAIR_RECORD_FRAME:
+		in.read((char*)&frame, sizeof(HairRecordFrame));
+		frames++;
+		break;
+	case HAIR_RECORD_CHECKSUM:
+		in.read((char*)&checksum, sizeof(unsigned int));
+		break;
+	case HAIR_RECORD_KEYFRAME:
+		keyframe.resize(restPositions.size());
+		in.read((char*)keyframe.data(), keyframe.size() * sizeof(HairPackedVertex));
+		break;
+	default:
+		return false;
+	}
+	return in.good();
+}
+
+HairReplayResult HairReplay::RunCPU(const std::string& path, const std::string& recordPath)
+{
+	HairReplayResult result = {};
+	result.firstMismatchFrame = -1;
+
+	HairReplay replay;
+	if (!replay.Open(path))
+		return result;
+	HairRecordingHeader header = replay.GetHeader();
+	int strands = header.NumOfStrands;
+	int verts = header.VertsPerStrand;
+	int count = strands * verts;
+	float scale = header.StateScale;
+	bool compare = header.Solver == HAIR_RECORD_SOLVER_CPU;
+
+	// The solver only reads the original positions out of the rest stream
+	std::vector<HairRestVertex> rest(count);
+	std::vector<XMFLOAT3> roots(strands);
+	for (int i = 0; i < count; i++)
+		rest[i].OriginalPosition = replay.GetRestPositions()[i];
+	for (int s = 0; s < strands; s++)
+		roots[s] = rest[s * verts].OriginalPosition;
+	std::vector<int> guides;
+	std::vector<HairFollower> followers;
+	HairSimulator::BindFollowers(roots.data(), strands, header.GuideRatio, guides, followers);
+
+	std::vector<HairSimVertex> state(count);
+	std::vector<HairPackedVertex> packed(count);
+	for (int i = 0; i < count; i++)
+	{
+		state[i].Position = rest[i].OriginalPosition;
+		state[i].PreviousPosition = rest[i].OriginalPosition;
+	}
+
+	// Inertia arrives scaled and clamped like Mesh::SimulateHair hands it to the GPU
+	HairSolverSettings settings = header.Settings;
+	settings.Inertia = 1;
+	// Recordings leave the wind out, the collision field comes with the file.
+	// The voxel grid covers the same bounds as Mesh's
+	HairVoxelGrid volume;
+	volume.SetBounds(header.BoundsCenter, header.BoundsRadius);
+	HairSolverFields fields = {};
+	fields.Volume = &volume;
+	if (header.Collision)
+	{
+		fields.Collision = &replay.GetCollisionField();
+		fields.CollisionMargin = HAIR_COLLISION_MARGIN;
+	}
+	HairStepScheduler scheduler(header.FixedStep, header.MaxSubsteps);
+	HairJobSystem jobs;
+
+	HairRecorder recorder;
+	if (!recordPath.empty())
+	{
+		HairRecordingHeader recorded = header;
+		recorded.Solver = HAIR_RECORD_SOLVER_CPU;
+		recorder.Open(recordPath, recorded, replay.GetRestPositions().data(), replay.GetPhysics().data(), &replay.GetCollisionField(), 0, 0);
+	}
+
+	XMFLOAT4X4 prevWorld = {};
+	XMFLOAT4X4 frameVelocity = {};
+	int frameVelocities = 0;
+	double solverSeconds = 0;
+	char tag = 0;
+	while (replay.Next(tag))
+	{
+		if (tag == HAIR_RECORD_KEYFRAME)
+		{
+			// The first keyframe is where the recording starts, the others would only repeat the checksums
+			if (replay.GetFrameCount() == 0)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					const XMFLOAT3& root = rest[i - i % verts].OriginalPosition;
+					state[i] = HairUnpackVertex(replay.GetKeyframe()[i], root, scale);
+				}
+			}
+			if (recorder.IsOpen())
+			{
+				for (int i = 0; i < count; i++)
+					packed[i] = HairPackVertex(state[i].Position, state[i].PreviousPosition, rest[i - i % verts].OriginalPosition, scale);
+				recorder.WriteKeyframe(packed.data());
+			}
+		}
+		else if (tag == HAIR_RECORD_CHECKSUM)
+		{
+			for (int i = 0; i < count; i++)
+				packed[i] = HairPackVertex(state[i].Position, state[i].PreviousPosition, rest[i - i % verts].OriginalPosition, scale);
+			unsigned int checksum = HairRecorder::Checksum(packed.data(), count);
+			if (compare)
+			{
+				result.checksums++;
+				if (checksum != replay.GetChecksum())
+				{
+					result.mismatches++;
+					if (result.firstMismatchFrame < 0)
+						result.firstMismatchFrame = replay.GetFrameCount();
+				}
+			}
+			if (recorder.IsOpen())
+				recorder.WriteChecksum(checksum);
+		}
+		else if (tag == HAIR_RECORD_FRAME)
+		{
+			const HairRecordFrame& frame = replay.GetFrame();
+			if (frame.LOD != 0)
+			{
+				result.rejected = true;
+				break;
+			}
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMLoadFloat4x3(&frame.World));
+			if (result.frames == 0)
+				prevWorld = world;
+
+			HairExternalForces forces = {};
+			forces.Force = frame.Force;
+			if (frame.DeltaTime > 0)
+			{
+				XMFLOAT4X4 velocity = HairSimulator::GetFrameVelocity(world, prevWorld, frame.DeltaTime);
+				if (frameVelocities >= 2)
+				{
+					XMFLOAT4X4 frameInertia = HairSimulator::GetInertia(prevWorld, velocity, frameVelocity, frame.DeltaTime);
+					XMStoreFloat4x4(&forces.Inertia, XMLoadFloat4x4(&frameInertia) * header.Settings.Inertia);
+					HairSimulator::ClampInertia(forces.Inertia, header.BoundsCenter, header.BoundsRadius);
+				}
+				frameVelocity = velocity;
+				frameVelocities = std::min(frameVelocities + 1, 2);
+			}
+			prevWorld = world;
+
+			// Every guide at full detail, recordings are always LOD 0
+			int steps = scheduler.Advance(frame.DeltaTime);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < steps; i++)
+			{
+				HairParallelSimulator::Simulate(jobs, state.data(), rest.data(), guides.data(), (int)guides.size(), followers.data(), (int)followers.size(),
+					verts, settings, forces, scheduler.GetFixedStep(), replay.GetPhysics().data(), &fields);
+			}
+			solverSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			result.frames++;
+			result.steps += steps;
+			if (recorder.IsOpen())
+				recorder.WriteFrame(frame);
+		}
+	}
+
+	result.millisecondsPerStep = solverSeconds * 1000.0 / std::max(result.steps, 1);
+	return result;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "HairStrand.h"
+#include "HairShared.h"
+#include "HairPacking.h"
+#include "HairCollisionField.h"
+
+// Whose checksums and keyframes a recording holds, the two solvers don't agree bit for bit
+#define HAIR_RECORD_SOLVER_GPU 0
+#define HAIR_RECORD_SOLVER_CPU 1
+#define HAIR_RECORD_VERSION 1
+
+// Start of every .hrec file, followed by the rest positions and
+// the physics table (one per strand vertex each), the collision
+// field if there is one (like a .sdf file), then the chunks
+struct HairRecordingHeader
+{
+	char Magic[4];					// "HREC"
+	unsigned int Version;
+	unsigned int Solver;			// HAIR_RECORD_SOLVER_*
+	unsigned int NumOfStrands;
+	unsigned int VertsPerStrand;
+	unsigned int GuideRatio;
+	float StateScale;				// Of the packed keyframes, see HairPacking.h
+	float FixedStep;				// The HairStepScheduler the frames went through
+	unsigned int MaxSubsteps;
+	unsigned int Collision;			// 1 = collided with the field stored in the file, at HAIR_COLLISION_MARGIN
+	DirectX::XMFLOAT3 BoundsCenter;	// What the inertia was clamped over
+	float BoundsRadius;
+	HairSolverSettings Settings;
+};
+
+// Everything SimulateHair got for one frame. The previous world matrix is the
+// frame before's, the very first frame of a recording doesn't move
+struct HairRecordFrame
+{
+	float DeltaTime;
+	DirectX::XMFLOAT3 Force;
+	DirectX::XMFLOAT4X3 World;
+	int LOD;						// Always 0, replays reject anything else
+};
+
+// Chunk tags, one byte ahead of each chunk. Checksums and keyframes are of
+// the newest state after every frame before them in the file
+#define HAIR_RECORD_FRAME 'F'
+#define HAIR_RECORD_CHECKSUM 'C'
+#define HAIR_RECORD_KEYFRAME 'K'
+
+// What a replay found
+struct HairReplayResult
+{
+	int frames;
+	int steps;
+	int checksums;					// Compared against the file
+	int mismatches;
+	int firstMismatchFrame;			// -1 if everything matched
+	double millisecondsPerStep;		// Solver only, no file reading or checksums
+	bool rejected;					// Stopped at a frame below LOD 0, which only the GPU can solve
+};
+
+// --------------------------------------------------------
+// Writes a hair simulation's inputs out as they happen
+//
+// The file is streamed, one small chunk per frame plus a
+// checksum of the packed state every checksum interval and
+// the whole packed state every keyframe interval, so a long
+// session can be recorded without keeping it in memory.
+// --------------------------------------------------------
+class HairRecorder
+{
+public:
+	HairRecorder();
+
+	// Writes the header, the rest positions, the physics table and the collision field, which has to be there
+	// if header.Collision is set. The initial state has to follow as a keyframe
+	bool Open(const std::string& path, const HairRecordingHeader& header, const DirectX::XMFLOAT3* restPositions, const unsigned int* physics,
+		const HairCollisionField* collision = 0, int checksumInterval = HAIR_RECORD_CHECKSUM_INTERVAL, int keyframeInterval = HAIR_RECORD_KEYFRAME_INTERVAL);
+	void Close();
+	bool IsOpen() { return out.is_open(); }
+
+	void WriteFrame(const HairRecordFrame& frame);
+	void WriteChecksum(unsigned int checksum);
+	void WriteKeyframe(const HairPackedVertex* state);
+
+	// Whether the state after the frame just written is due a checksum or a keyframe
+	bool WantsChecksum() { return checksumInterval > 0 && frames % checksumInterval == 0; }
+	bool WantsKeyframe() { return keyframeInterval > 0 && frames % keyframeInterval == 0; }
+	int GetFrameCount() { return frames; }
+
+	static unsigned int Checksum(const HairPackedVertex* state, int count);
+
+private:
+	std::ofstream out;
+	int stateCount;
+	int frames;
+	int checksumInterval;
+	int keyframeInterval;
+};
+
+// --------------------------------------------------------
+// Reads a recording back one chunk at a time
+//
+// Drive the GPU solver with it through Mesh::StartHairReplay,
+// or the CPU solver headless with RunCPU.
+// --------------------------------------------------------
+class HairReplay
+{
+public:
+	HairReplay();
+
+	// False if the file is missing, truncated or from another version
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() { return in.is_open(); }
+
+	const HairRecordingHeader& GetHeader() { return header; }
+	const std::vector<DirectX::XMFLOAT3>& GetRestPositions() { return restPositions; }
+	const std::vector<unsigned int>& GetPhysics() { return physics; }
+	// Empty unless the header's Collision is set
+	const HairCollisionField& GetCollisionField() { return collision; }
+
+	// Reads the next chunk, false at the end of the file. The getters hold whatever it was
+	bool Next(char& tag);
+	const HairRecordFrame& GetFrame() { return frame; }
+	unsigned int GetChecksum() { return checksum; }
+	const std::vector<HairPackedVertex>& GetKeyframe() { return keyframe; }
+	int GetFrameCount() { return frames; }
+
+	// Runs the recorded inputs through HairSimulator, checking the checksums if the CPU solver recorded them.
+	// A non empty recordPath writes the same inputs out again with the CPU's own checksums and keyframes
+	static HairReplayResult RunCPU(const std::string& path, const std::string& recordPath = "");
+
+private:
+	std::ifstream in;
+	HairRecordingHeader header;
+	std::vector<DirectX::XMFLOAT3> restPositions;
+	std::vector<unsigned int> physics;
+	HairCollisionField collision;
+	HairRecordFrame frame;
+	unsigned int checksum;
+	std::vector<HairPackedVertex> keyframe;
+	int frames;
+};
@@ -0,0 +1,339 @@
+#include "HairRegression.h"
+
+#include "ObjLoader.h"
+#include "HairGroomBuilder.h"
+#include "HairSimulator.h"
+#include "HairParallelSimulator.h"
+#include "HairStepScheduler.h"
+#include "HairRecording.h"
+#include "HairCollisionField.h"
+#include "HairVoxelGrid.h"
+
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace DirectX;
+
+std::string HairRegression::GetGoldenPath(const std::string& objPath)
+{
+	return objPath.substr(0, objPath.find_last_of('.')) + ".golden";
+}
+
+int HairRegression::GetSampleIndex(int sample, int numOfSamples, int numOfStrands, int vertsPerStrand)
+{
+	int strand = (int)((long long)sample * numOfStrands / numOfSamples);
+	int vertex = vertsPerStrand > 1 ? 1 + sample % (vertsPerStrand - 1) : 0;
+	return strand * vertsPerStrand + vertex;
+}
+
+// One field at a time, so the file doesn't depend on how the compiler lays out the struct
+template<typename T> static void ReadField(std::istream& in, T& value)
+{
+	in.read((char*)&value, sizeof(T));
+}
+
+template<typename T> static void WriteField(std::ostream& out, const T& value)
+{
+	out.write((const char*)&value, sizeof(T));
+}
+
+bool HairRegression::ReadGolden(std::istream& in, HairGoldenHeader& header)
+{
+	ReadField(in, header.Magic);
+	ReadField(in, header.Version);
+	ReadField(in, header.NumOfStrands);
+	ReadField(in, header.VertsPerStrand);
+	ReadField(in, header.Frames);
+	ReadField(in, header.StateScale);
+	ReadField(in, header.Checksum);
+	ReadField(in, header.NumOfSamples);
+	ReadField(in, header.MeanFrameMilliseconds);
+	return in.good() && memcmp(header.Magic, "HGLD", 4) == 0 && header.Version == version;
+}
+
+bool HairRegression::WriteGolden(std::ostream& out, const HairGoldenHeader& header)
+{
+	WriteField(out, header.Magic);
+	WriteField(out, header.Version);
+	WriteField(out, header.NumOfStrands);
+	WriteField(out, header.VertsPerStrand);
+	WriteField(out, header.Frames);
+	WriteField(out, header.StateScale);
+	WriteField(out, header.Checksum);
+	WriteField(out, header.NumOfSamples);
+	WriteField(out, header.MeanFrameMilliseconds);
+	return out.good();
+}
+
+const char* HairRegression::GetStatusName(int status)
+{
+	switch (status)
+	{
+	case HAIR_REGRESSION_PASSED: return "passed";
+	case HAIR_REGRESSION_FAILED: return "FAILED";
+	case HAIR_REGRESSION_RECORDED: return "recorded";
+	case HAIR_REGRESSION_GROOM_CHANGED: return "groom changed";
+	case HAIR_REGRESSION_NO_MODEL: return "no model";
+	case HAIR_REGRESSION_NO_GOLDEN: return "NO GOLDEN";
+	}
+	return "?";
+}
+
+void HairRegression::GetScriptedFrame(int frame, XMFLOAT4X4& world, XMFLOAT3& force, WindState& wind)
+{
+	float time = frame * HAIR_REGRESSION_FRAME_TIME;
+
+	// A second to settle under gravity, then swaying, bobbing and turning at unrelated rates
+	XMMATRIX motion = XMMatrixIdentity();
+	if (time > 1.0f)
+	{
+		float moving = time - 1.0f;
+		float yaw = 0.5f * sinf(moving * XM_2PI * 0.5f);
+		float sway = 0.3f * sinf(moving * XM_2PI * 0.75f);
+		float bob = 0.1f * sinf(moving * XM_2PI * 1.5f);
+		motion = XMMatrixRotationY(yaw) * XMMatrixTranslation(sway, bob, 0);
+	}
+	XMStoreFloat4x4(&world, motion);
+
+	// Gusts back and forth like holding the arrow keys, every half second from the second second on
+	force = XMFLOAT3(0, 0, 0);
+	if (time > 2.0f)
+		force.x = (int)(time * 2.0f) % 2 == 0 ? 1.0f : -1.0f;
+
+	// A steady breeze across the swaying, with the usual gusts carried along by it
+	wind.Velocity = XMFLOAT3(0, 0, 1.5f);
+	wind.Scroll = XMFLOAT3(0, 0, 1.5f * time);
+	wind.Turbulence = WIND_DEFAULT_TURBULENCE;
+	wind.Frequency = WIND_DEFAULT_FREQUENCY;
+}
+
+HairRegressionResult HairRegression::Run(const std::string& objPath, bool updateGolden, int frames, int threads)
+{
+	HairRegressionResult result = {};
+	result.model = objPath.substr(objPath.find_last_of("\\/") + 1);
+	result.status = HAIR_REGRESSION_NO_MODEL;
+	result.vertsPerStrand = HAIR_DEFAULT_SEGMENTS + 1;
+
+	std::vector<Vertex> surfaceVerts;
+	std::vector<unsigned int> surfaceIndices;
+	if (!ObjLoader::Load(objPath.c_str(), surfaceVerts, surfaceIndices))
+		return result;
+	HairStraightGroom groom;
+	if (!HairGroomBuilder::GrowStraight(surfaceVerts.data(), surfaceIndices.data(), (int)surfaceIndices.size(), HAIR_DEFAULT_ROOT_DENSITY, rootSeed,
+		result.vertsPerStrand, HAIR_REGRESSION_LENGTH, HAIR_DEFAULT_GUIDE_RATIO, groom))
+		return result;
+
+	int strands = groom.numOfStrands;
+	int verts = groom.vertsPerStrand;
+	int count = strands * verts;
+	const std::vector<HairRestVertex>& rest = groom.rest;
+	std::vector<HairSimVertex> state(count);
+	for (int i = 0; i < count; i++)
+	{
+		state[i].Position = rest[i].OriginalPosition;
+		state[i].PreviousPosition = rest[i].OriginalPosition;
+	}
+
+	// Collides with the model like a fresh Mesh does, see Mesh::CreateCollisionField. An open surface
+	// like the plane has no real inside, if the groom starts out in it the field is left out
+	HairCollisionField collision;
+	collision.Bake(surfaceVerts.data(), (int)surfaceVerts.size(), surfaceIndices.data(), (int)surfaceIndices.size(),
+		HAIR_REGRESSION_SDF_RESOLUTION, HAIR_REGRESSION_LENGTH * 1.2f + HAIR_COLLISION_MARGIN, threads);
+	result.collision = true;
+	for (int i = 0; i < count && result.collision; i++)
+		result.collision = i % verts == 0 || collision.Sample(rest[i].OriginalPosition) >= 0;
+
+	HairVoxelGrid volume;
+	volume.SetBounds(groom.boundsCenter, groom.boundsRadius);
+
+	// Inertia is scaled and clamped here like Mesh::SimulateHair does before the solver sees it
+	HairSolverSettings settings = HairSimulator::GetDefaultSettings();
+	float inertiaScale = settings.Inertia;
+	settings.Inertia = 1;
+	HairStepScheduler scheduler;
+	HairJobSystem jobs(threads);
+
+	XMFLOAT4X4 prevWorld = {};
+	XMFLOAT4X4 frameVelocity = {};
+	int frameVelocities = 0;
+	double totalMilliseconds = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		XMFLOAT4X4 world;
+		HairExternalForces forces = {};
+		WindState wind;
+		GetScriptedFrame(frame, world, forces.Force, wind);
+		if (frame == 0)
+			prevWorld = world;
+
+		// Everything besides the strands the GPU solver would sample this frame
+		HairSolverFields fields = {};
+		fields.Wind = &wind;
+		fields.World = world;
+		XMStoreFloat4x4(&fields.WorldInverse, XMMatrixInverse(0, XMLoadFloat4x4(&world)));
+		fields.Collision = result.collision ? &collision : 0;
+		fields.CollisionMargin = HAIR_COLLISION_MARGIN;
+		fields.Volume = &volume;
+
+		XMFLOAT4X4 velocity = HairSimulator::GetFrameVelocity(world, prevWorld, HAIR_REGRESSION_FRAME_TIME);
+		if (frameVelocities >= 2)
+		{
+			XMFLOAT4X4 frameInertia = HairSimulator::GetInertia(prevWorld, velocity, frameVelocity, HAIR_REGRESSION_FRAME_TIME);
+			XMStoreFloat4x4(&forces.Inertia, XMLoadFloat4x4(&frameInertia) * inertiaScale);
+			HairSimulator::ClampInertia(forces.Inertia, groom.boundsCenter, groom.boundsRadius);
+		}
+		frameVelocity = velocity;
+		frameVelocities = std::min(frameVelocities + 1, 2);
+		prevWorld = world;
+
+		int steps = scheduler.Advance(HAIR_REGRESSION_FRAME_TIME);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < steps; i++)
+		{
+			HairParallelSimulator::Simulate(jobs, state.data(), rest.data(), groom.guides.data(), (int)groom.guides.size(), groom.followers.data(), (int)groom.followers.size(),
+				verts, settings, forces, scheduler.GetFixedStep(), 0, &fields);
+		}
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		totalMilliseconds += milliseconds;
+		result.maxFrameMilliseconds = std::max(result.maxFrameMilliseconds, milliseconds);
+		result.steps += steps;
+	}
+	result.numOfStrands = strands;
+	result.frames = frames;
+	result.meanFrameMilliseconds = totalMilliseconds / std::max(frames, 1);
+
+	// Packed like the GPU's state ring and the recordings, so the checksums mean the same thing
+	float scale = HAIR_REGRESSION_LENGTH * HAIR_PACKED_POSITION_RANGE;
+	std::vector<HairPackedVertex> packed(count);
+	for (int i = 0; i < count; i++)
+		packed[i] = HairPackVertex(state[i].Position, state[i].PreviousPosition, rest[i - i % verts].OriginalPosition, scale);
+	result.checksum = HairRecorder::Checksum(packed.data(), count);
+
+	std::string goldenPath = GetGoldenPath(objPath);
+	HairGoldenHeader header = {};
+	std::vector<HairPackedVertex> golden;
+	bool hasGolden = false;
+	if (!updateGolden)
+	{
+		std::ifstream in(goldenPath, std::ios::binary);
+		hasGolden = in.is_open() && ReadGolden(in, header);
+		if (hasGolden)
+		{
+			result.goldenFrameMilliseconds = header.MeanFrameMilliseconds;
+			if (header.NumOfStrands != (unsigned int)strands || header.VertsPerStrand != (unsigned int)verts ||
+				header.Frames != (unsigned int)frames || header.StateScale != scale || header.NumOfSamples > (unsigned int)strands)
+			{
+				result.status = HAIR_REGRESSION_GROOM_CHANGED;
+				return result;
+			}
+			golden.resize(header.NumOfSamples);
+			in.read((char*)golden.data(), golden.size() * sizeof(HairPackedVertex));
+			hasGolden = in.good();
+		}
+	}
+
+	if (updateGolden)
+	{
+		memcpy(header.Magic, "HGLD", 4);
+		header.Version = version;
+		header.NumOfStrands = strands;
+		header.VertsPerStrand = verts;
+		header.Frames = frames;
+		header.StateScale = scale;
+		header.Checksum = result.checksum;
+		header.NumOfSamples = std::min(strands, HAIR_REGRESSION_GOLDEN_SAMPLES);
+		header.MeanFrameMilliseconds = result.meanFrameMilliseconds;
+
+		std::ofstream out(goldenPath, std::ios::binary | std::ios::trunc);
+		WriteGolden(out, header);
+		for (int sample = 0; sample < (int)header.NumOfSamples; sample++)
+			WriteField(out, packed[GetSampleIndex(sample, header.NumOfSamples, strands, verts)]);
+		result.status = out.good() ? HAIR_REGRESSION_RECORDED : HAIR_REGRESSION_FAILED;
+		result.exact = true;
+		return result;
+	}
+	if (!hasGolden)
+	{
+		result.status = HAIR_REGRESSION_NO_GOLDEN;
+		return result;
+	}
+
+	// Another compiler or instruction set rounds differently, so close enough passes too
+	result.exact = result.checksum == header.Checksum;
+	if (!result.exact)
+	{
+		for (int sample = 0; sample < (int)golden.size(); sample++)
+		{
+			int i = GetSampleIndex(sample, (int)golden.size(), strands, verts);
+			const XMFLOAT3& root = rest[i - i % verts].OriginalPosition;
+			XMFLOAT3 position = HairUnpackVertex(packed[i], root, scale).Position;
+			XMFLOAT3 goldenPosition = HairUnpackVertex(golden[sample], root, scale).Position;
+			float error = XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&goldenPosition)));
+			result.maxError = std::max(result.maxError, error);
+		}
+	}
+	result.status = result.maxError <= HAIR_REGRESSION_TOLERANCE ? HAIR_REGRESSION_PASSED : HAIR_REGRESSION_FAILED;
+	return result;
+}
+
+std::vector<HairRegressionResult> HairRegression::RunAll(const std::string& folder, bool updateGolden, int frames, int threads)
+{
+	namespace fs = std::experimental::filesystem;
+
+	std::vector<std::string> models;
+	if (fs::exists(folder))
+	{
+		for (auto& item : fs::directory_iterator(folder))
+		{
+			if (item.path().extension() == ".obj")
+				models.push_back(item.path().string());
+		}
+	}
+	std::sort(models.begin(), models.end());
+
+	std::vector<HairRegressionResult> results;
+	for (auto& model : models)
+		results.push_back(Run(model, updateGolden, frames, threads));
+	return results;
+}
+
+std::string HairRegression::GetReport(const std::vector<HairRegressionResult>& results)
+{
+	std::ostringstream report;
+	for (auto& result : results)
+	{
+		report << result.model << ": " << GetStatusName(result.status);
+		if (result.status != HAIR_REGRESSION_NO_MODEL)
+		{
+			report << ", " << result.numOfStrands << " strands, " << result.frames << " frames, " << result.steps << " steps";
+			if (!result.collision)
+				report << ", no collision";
+			if (result.status == HAIR_REGRESSION_PASSED || result.status == HAIR_REGRESSION_FAILED)
+				report << ", " << (result.exact ? "exact" : "max error " + std::to_string(result.maxError));
+			report << ", " << result.meanFrameMilliseconds << " ms/frame (max " << result.maxFrameMilliseconds << ")";
+			if (result.goldenFrameMilliseconds > 0)
+				report << ", golden " << result.goldenFrameMilliseconds << " ms/frame";
+		}
+		report << "\n";
+	}
+	report << results.size() << " models, " << GetFailedCount(results) << " failed\n";
+	return report.str();
+}
+
+int HairRegression::GetFailedCount(const std::vector<HairRegressionResult>& results)
+{
+	int failed = 0;
+	for (auto& result : results)
+	{
+		if (result.status != HAIR_REGRESSION_PASSED && result.status != HAIR_REGRESSION_RECORDED)
+			failed++;
+	}
+	return failed;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "HairShared.h"
+#include "WindNoise.h"
+
+// How a model's run compared to its golden state
+#define HAIR_REGRESSION_PASSED 0		// Same checksum, or within HAIR_REGRESSION_TOLERANCE
+#define HAIR_REGRESSION_FAILED 1
+#define HAIR_REGRESSION_RECORDED 2		// Asked to update, this run's state became the golden one
+#define HAIR_REGRESSION_GROOM_CHANGED 3	// The golden state is of another groom, the roots or strands changed
+#define HAIR_REGRESSION_NO_MODEL 4		// The .obj couldn't be read or grew no hair
+#define HAIR_REGRESSION_NO_GOLDEN 5		// Nothing to compare against, a failure until the golden state is recorded
+
+// Start of every .golden file. Read and written field by field in this order, 40 bytes
+// without any padding, then NumOfSamples packed vertices (12 bytes each, see HairPacking.h)
+struct HairGoldenHeader
+{
+	char Magic[4];					// "HGLD"
+	unsigned int Version;
+	unsigned int NumOfStrands;
+	unsigned int VertsPerStrand;
+	unsigned int Frames;
+	float StateScale;				// Of the packed state, see HairPacking.h
+	unsigned int Checksum;			// HairRecorder::Checksum() of the whole packed state
+	unsigned int NumOfSamples;		// Vertices kept to measure how far a run ended up, see HairRegression::GetSampleIndex()
+	double MeanFrameMilliseconds;	// When the golden state was recorded, only to compare timings against
+};
+
+// One model's run
+struct HairRegressionResult
+{
+	std::string model;				// File name of the .obj
+	int status;						// HAIR_REGRESSION_*
+	int numOfStrands;
+	int vertsPerStrand;
+	int frames;
+	int steps;
+	bool collision;					// Collided with the model, an open surface has nothing to collide with
+	unsigned int checksum;			// Of the packed final state
+	bool exact;						// Bit for bit the golden state
+	float maxError;					// Furthest any sampled vertex ended up from the golden state, 0 if exact
+	double meanFrameMilliseconds;	// Solver only, every step of a frame together
+	double maxFrameMilliseconds;
+	double goldenFrameMilliseconds;	// The golden run's mean, 0 if there was none
+};
+
+// --------------------------------------------------------
+// Golden state regression test for the CPU hair solver
+//
+// Grows hair over a model like the CreateHair pass does
+// (see HairGroomBuilder), bakes its collision field and
+// runs a fixed script of movement, pushes and wind through
+// HairParallelSimulator, the same way HairReplay::RunCPU
+// drives it. The final state's checksum is compared against
+// the one stored next to the model (.golden), so a change to
+// the solver, the sampler or the packing that moves the hair
+// shows up here. Another compiler rounds differently, so the
+// file also keeps a few vertices spread over the groom and a
+// run that only moved those within the tolerance passes. Timing is
+// reported per frame but never fails a run, it depends on
+// the machine.
+//
+// Needs no device or window, HairRegressionTool runs it
+// from the command line.
+// --------------------------------------------------------
+class HairRegression
+{
+public:
+	// updateGolden = store this run as the golden state instead of comparing against it,
+	// the only way a missing golden state gets written.
+	// threads = 0 uses every core, the result doesn't depend on it
+	static HairRegressionResult Run(const std::string& objPath, bool updateGolden = false, int frames = HAIR_REGRESSION_FRAMES, int threads = 0);
+
+	// Every .obj in a folder, by name
+	static std::vector<HairRegressionResult> RunAll(const std::string& folder, bool updateGolden = false, int frames = HAIR_REGRESSION_FRAMES, int threads = 0);
+
+	// What the script does on a frame: the entity's world matrix, the force on the hair and the wind
+	static void GetScriptedFrame(int frame, DirectX::XMFLOAT4X4& world, DirectX::XMFLOAT3& force, WindState& wind);
+
+	// One line per model then a summary, what the headless run writes out
+	static std::string GetReport(const std::vector<HairRegressionResult>& results);
+	static const char* GetStatusName(int status);
+	// Anything that didn't pass or record a new golden state, a missing golden state included
+	static int GetFailedCount(const std::vector<HairRegressionResult>& results);
+	static std::string GetGoldenPath(const std::string& objPath);
+	// Which vertex of the state a golden file's sample is, spread over every strand and every vertex but the root
+	static int GetSampleIndex(int sample, int numOfSamples, int numOfStrands, int vertsPerStrand);
+
+private:
+	static bool ReadGolden(std::istream& in, HairGoldenHeader& header);
+	static bool WriteGolden(std::ostream& out, const HairGoldenHeader& header);
+
+	static const unsigned int version = 2;
+	static const unsigned int rootSeed = 1;
+};
@@ -0,0 +1,45 @@
+#include "HairRegression.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// --------------------------------------------------------
+// Entry point of HairRegressionTool, runs the hair solver's
+// golden state test over every model without a window or
+// a device. The report goes to the console and next to
+// the executable (HairRegression.txt).
+//
+//   HairRegressionTool [-updategolden] [models folder]
+//
+// Returns how many models failed, for build scripts
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	// Models are found relative to the executable by default, like DXCore::GetFullPathTo does
+	std::string exePath = argv[0];
+	std::string folder = exePath.substr(0, exePath.find_last_of("\\/") + 1);
+	std::string modelsFolder = folder + "../../Assets/Models/";
+
+	// -updategolden stores this run's results as the new golden states, the only way a missing one gets written
+	bool updateGolden = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-updategolden") == 0)
+			updateGolden = true;
+		else
+			modelsFolder = argv[i];
+	}
+
+	std::vector<HairRegressionResult> results = HairRegression::RunAll(modelsFolder, updateGolden);
+	std::string report = HairRegression::GetReport(results);
+	std::cout << report;
+	std::ofstream reportFile(folder + "HairRegression.txt");
+	reportFile << report;
+
+	// No models at all means the folder is wrong, which shouldn't pass either
+	if (results.empty())
+		return 1;
+	return HairRegression::GetFailedCount(results);
+}
@@ -0,0 +1,100 @@
+// --------------------------------------------------------
+// How a hair draw turns SV_VertexID into ribbon vertices,
+// shared by HairVS.hlsl and the C++ code
+//
+// Every drawn strand is lodSegments quads in a row, six
+// vertices (two triangles) each, so a non indexed Draw of
+// drawnStrands * lodSegments * 6 vertices needs no index
+// buffer at all. Each corner is one side of one vertex of
+// the strand reduced to lodSegments segments, or of a
+// Catmull-Rom curve through those vertices when each segment
+// is tessellated further.
+// --------------------------------------------------------
+#ifndef _HAIRRIBBON_H
+#define _HAIRRIBBON_H
+
+#ifdef __cplusplus
+#include <DirectXMath.h>
+#define HAIR_FUNC inline
+#define HAIR_UINT unsigned int
+#define HAIR_FLOAT4 DirectX::XMFLOAT4
+#define HAIR_MIN(a, b) ((a) < (b) ? (a) : (b))
+#else
+#define HAIR_FUNC
+#define HAIR_UINT uint
+#define HAIR_FLOAT4 float4
+#define HAIR_MIN min
+#endif
+
+// Corners of one quad, in the order they're drawn: start, start + 1, end, end, start + 1, end + 1
+#define HAIR_RIBBON_VERTICES_PER_SEGMENT 6
+#define HAIR_RIBBON_END_CORNERS 0x2C	// Bit per corner, set for the end of the segment
+#define HAIR_RIBBON_SIDE_CORNERS 0x32	// Set for the right hand side of the ribbon
+
+struct HairRibbonCorner
+{
+	HAIR_UINT Strand;		// Which drawn strand, not which strand of the mesh
+	HAIR_UINT Vertex;		// 0 - lodSegments along the reduced strand
+	HAIR_UINT Side;			// 0 = left, 1 = right
+};
+
+HAIR_FUNC HairRibbonCorner HairExpandRibbon(HAIR_UINT id, HAIR_UINT lodSegments)
+{
+	HAIR_UINT perStrand = lodSegments * HAIR_RIBBON_VERTICES_PER_SEGMENT;
+	HAIR_UINT corner = id % HAIR_RIBBON_VERTICES_PER_SEGMENT;
+
+	HairRibbonCorner ribbon;
+	ribbon.Strand = id / perStrand;
+	ribbon.Vertex = (id % perStrand) / HAIR_RIBBON_VERTICES_PER_SEGMENT + ((HAIR_RIBBON_END_CORNERS >> corner) & 1);
+	ribbon.Side = (HAIR_RIBBON_SIDE_CORNERS >> corner) & 1;
+	return ribbon;
+}
+
+// Which vertex of the full strand a corner sits on, same as LODVertex() in HairGenerics.hlsli
+HAIR_FUNC HAIR_UINT HairRibbonStrandVertex(HairRibbonCorner ribbon, HAIR_UINT lodSegments, HAIR_UINT vertsPerStrand)
+{
+	return ribbon.Vertex * (vertsPerStrand - 1) / lodSegments;
+}
+
+// The LOD segment a corner of a strand tessellated this many times per segment is on, and how far along (0-1)
+HAIR_FUNC HAIR_UINT HairRibbonSegment(HAIR_UINT vertex, HAIR_UINT lodSegments, HAIR_UINT tessellation)
+{
+	return HAIR_MIN(vertex / tessellation, lodSegments - 1);
+}
+
+HAIR_FUNC float HairRibbonSegmentT(HAIR_UINT vertex, HAIR_UINT segment, HAIR_UINT tessellation)
+{
+	return (float)(vertex - segment * tessellation) / tessellation;
+}
+
+// Uniform Catmull-Rom weights of the four control points around a segment,
+// t = 0 is on the second point and 1 on the third. The curve passes through
+// every control point and its tangent is continuous across them
+HAIR_FUNC HAIR_FLOAT4 HairCatmullRomWeights(float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return HAIR_FLOAT4(
+		0.5f * (-t + 2.0f * t2 - t3),
+		0.5f * (2.0f - 5.0f * t2 + 3.0f * t3),
+		0.5f * (t + 4.0f * t2 - 3.0f * t3),
+		0.5f * (t3 - t2));
+}
+
+// Derivative of the above, the curve's direction at t
+HAIR_FUNC HAIR_FLOAT4 HairCatmullRomTangentWeights(float t)
+{
+	float t2 = t * t;
+	return HAIR_FLOAT4(
+		0.5f * (-1.0f + 4.0f * t - 3.0f * t2),
+		0.5f * (-10.0f * t + 9.0f * t2),
+		0.5f * (1.0f + 8.0f * t - 9.0f * t2),
+		0.5f * (3.0f * t2 - 2.0f * t));
+}
+
+#undef HAIR_FUNC
+#undef HAIR_UINT
+#undef HAIR_FLOAT4
+#undef HAIR_MIN
+
+#endif
@@ -0,0 +1,53 @@
+#include "HairRibbonBuilder.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+void HairRibbonBuilder::ExpandRibbons(int vertexCount, int lodSegments, int vertsPerStrand, const int* guideStrands, int drawStep, std::vector<unsigned int>& ribbonVertices)
+{
+	ribbonVertices.resize(vertexCount);
+	for (int id = 0; id < vertexCount; id++)
+	{
+		HairRibbonCorner ribbon = HairExpandRibbon(id, lodSegments);
+		unsigned int strand = drawStep > 0 ? guideStrands[ribbon.Strand * drawStep] : ribbon.Strand;
+		unsigned int vertex = strand * vertsPerStrand + HairRibbonStrandVertex(ribbon, lodSegments, vertsPerStrand);
+		ribbonVertices[id] = vertex * 2 + ribbon.Side;
+	}
+}
+
+void HairRibbonBuilder::SmoothStrand(const XMFLOAT3* positions, int vertsPerStrand, int lodSegments, int tessellation,
+	std::vector<XMFLOAT3>& points, std::vector<XMFLOAT3>& directions)
+{
+	int count = lodSegments * tessellation + 1;
+	points.resize(count);
+	directions.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int segment = HairRibbonSegment(i, lodSegments, tessellation);
+		float t = HairRibbonSegmentT(i, segment, tessellation);
+		int lodVertices[4] = { std::max(segment - 1, 0), segment, segment + 1, std::min(segment + 2, lodSegments) };
+		XMFLOAT4 weights = HairCatmullRomWeights(t);
+		XMFLOAT4 tangentWeights = HairCatmullRomTangentWeights(t);
+		const float* w = &weights.x;
+		const float* tw = &tangentWeights.x;
+
+		XMVECTOR p[4];
+		for (int j = 0; j < 4; j++)
+			p[j] = XMLoadFloat3(&positions[lodVertices[j] * (vertsPerStrand - 1) / lodSegments]);
+		if (segment == 0)
+			p[0] = 2.0f * p[1] - p[2];
+		if (segment == lodSegments - 1)
+			p[3] = 2.0f * p[2] - p[1];
+
+		XMVECTOR point = XMVectorZero();
+		XMVECTOR direction = XMVectorZero();
+		for (int j = 0; j < 4; j++)
+		{
+			point += p[j] * w[j];
+			direction += p[j] * tw[j];
+		}
+		XMStoreFloat3(&points[i], point);
+		XMStoreFloat3(&directions[i], direction);
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "HairRibbon.h"
+
+// --------------------------------------------------------
+// CPU versions of what HairVS.hlsl does with HairRibbon.h
+//
+// The shader builds every ribbon on the fly from SV_VertexID,
+// these do the same on the CPU so tools and tests can check
+// a hair draw without a device.
+// --------------------------------------------------------
+class HairRibbonBuilder
+{
+public:
+	// CPU version of HairVS.hlsl's expansion: for every vertex ID of a hair draw, the ribbon vertex
+	// it lands on (strand vertex * 2 + side). Exactly what the index buffers used to hold.
+	// drawStep = every drawStep'th entry of guideStrands is drawn, 0 = every strand
+	static void ExpandRibbons(int vertexCount, int lodSegments, int vertsPerStrand, const int* guideStrands, int drawStep, std::vector<unsigned int>& ribbonVertices);
+
+	// CPU version of HairVS.hlsl's smoothing, the centreline of one strand (vertsPerStrand positions) reduced to
+	// lodSegments segments then tessellated: lodSegments * tessellation + 1 points with their unnormalized directions
+	static void SmoothStrand(const DirectX::XMFLOAT3* positions, int vertsPerStrand, int lodSegments, int tessellation,
+		std::vector<DirectX::XMFLOAT3>& points, std::vector<DirectX::XMFLOAT3>& directions);
+};
@@ -0,0 +1,221 @@
+#include "HairRootSampler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Integer hash, so the roots don't depend on the standard library's random engines
+static unsigned int Hash(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// 0-1, a different stream of numbers for every sample and dimension
+static float Random(unsigned int seed, unsigned int sample, unsigned int dimension)
+{
+	return (Hash(seed ^ Hash(sample * 4 + dimension)) >> 8) / 16777216.0f;
+}
+
+unsigned int HairUVMap::Sample(XMFLOAT2 uv, unsigned int fallback) const
+{
+	if (Width == 0 || Height == 0)
+		return fallback;
+
+	// Nearest texel, wrapping like the default sampler
+	float u = uv.x - std::floor(uv.x);
+	float v = uv.y - std::floor(uv.y);
+	int x = std::min((int)(u * Width), Width - 1);
+	int y = std::min((int)(v * Height), Height - 1);
+	return Texels[y * Width + x];
+}
+
+float HairDensityMask::Sample(XMFLOAT2 uv) const
+{
+	if (Width == 0 || Height == 0)
+		return 1.0f;
+
+	// Nearest texel, wrapping like the default sampler
+	float u = uv.x - std::floor(uv.x);
+	float v = uv.y - std::floor(uv.y);
+	int x = std::min((int)(u * Width), Width - 1);
+	int y = std::min((int)(v * Height), Height - 1);
+	return Values[y * Width + x];
+}
+
+void HairRootSampler::Sample(const Vertex* verts, const unsigned int* indices, int numIndices, float density, unsigned int seed,
+	const HairDensityMask* mask, std::vector<HairRootBinding>& bindings)
+{
+	bindings.clear();
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	// Running total of triangle areas to pick triangles from
+	std::vector<double> areaSums(numTriangles);
+	double totalArea = 0;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+		totalArea += 0.5 * XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+		areaSums[t] = totalArea;
+	}
+	if (totalArea <= 0)
+		return;
+
+	int count = std::max((int)(totalArea * density + 0.5), 1);
+	bindings.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		// Stratified along the area sum, so no two roots pile onto the same spot by chance
+		double target = (i + Random(seed, i, 0)) / count * totalArea;
+		int triangle = (int)(std::upper_bound(areaSums.begin(), areaSums.end(), target) - areaSums.begin());
+		triangle = std::min(triangle, numTriangles - 1);
+
+		// Uniform over the triangle
+		float s = std::sqrt(Random(seed, i, 1));
+		float r = Random(seed, i, 2);
+		HairRootBinding binding;
+		binding.Triangle = triangle;
+		binding.Barycentrics = XMFLOAT3(1.0f - s, s * (1.0f - r), s * r);
+
+		if (mask && mask->Width > 0 && Random(seed, i, 3) >= mask->Sample(Evaluate(verts, indices, binding).UV))
+			continue;
+		bindings.push_back(binding);
+	}
+}
+
+Vertex HairRootSampler::Evaluate(const Vertex* verts, const unsigned int* indices, const HairRootBinding& binding)
+{
+	const Vertex& v0 = verts[indices[binding.Triangle * 3]];
+	const Vertex& v1 = verts[indices[binding.Triangle * 3 + 1]];
+	const Vertex& v2 = verts[indices[binding.Triangle * 3 + 2]];
+	XMVECTOR b0 = XMVectorReplicate(binding.Barycentrics.x);
+	XMVECTOR b1 = XMVectorReplicate(binding.Barycentrics.y);
+	XMVECTOR b2 = XMVectorReplicate(binding.Barycentrics.z);
+
+	Vertex root;
+	XMStoreFloat3(&root.Position, XMLoadFloat3(&v0.Position) * b0 + XMLoadFloat3(&v1.Position) * b1 + XMLoadFloat3(&v2.Position) * b2);
+	XMStoreFloat3(&root.Normal, XMVector3Normalize(XMLoadFloat3(&v0.Normal) * b0 + XMLoadFloat3(&v1.Normal) * b1 + XMLoadFloat3(&v2.Normal) * b2));
+	XMStoreFloat3(&root.Tangent, XMVector3Normalize(XMLoadFloat3(&v0.Tangent) * b0 + XMLoadFloat3(&v1.Tangent) * b1 + XMLoadFloat3(&v2.Tangent) * b2));
+	XMStoreFloat2(&root.UV, XMLoadFloat2(&v0.UV) * b0 + XMLoadFloat2(&v1.UV) * b1 + XMLoadFloat2(&v2.UV) * b2);
+	return root;
+}
+
+// RootFrame() in UpdateHairRoots.hlsl: normal, tangent and bitangent as the rows
+static XMMATRIX RootFrame(XMVECTOR normal, XMVECTOR tangent)
+{
+	normal = XMVector3Normalize(normal);
+	tangent -= normal * XMVector3Dot(normal, tangent);
+	if (XMVectorGetX(XMVector3LengthSq(tangent)) < 0.000001f)
+		tangent = XMVector3Cross(normal, fabsf(XMVectorGetX(normal)) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0));
+	tangent = XMVector3Normalize(tangent);
+	return XMMATRIX(normal, tangent, XMVector3Cross(normal, tangent), XMVectorSet(0, 0, 0, 1));
+}
+
+void HairRootSampler::UpdateRoots(const Vertex* surfaceVerts, const unsigned int* surfaceIndices, const HairRootBinding* bindings,
+	const ShaderVertex* boundRoots, const HairRestVertex* boundRest, HairRestVertex* rest, int numOfStrands, int vertsPerStrand)
+{
+	for (int s = 0; s < numOfStrands; s++)
+	{
+		const Vertex& v0 = surfaceVerts[surfaceIndices[bindings[s].Triangle * 3]];
+		const Vertex& v1 = surfaceVerts[surfaceIndices[bindings[s].Triangle * 3 + 1]];
+		const Vertex& v2 = surfaceVerts[surfaceIndices[bindings[s].Triangle * 3 + 2]];
+		XMVECTOR b0 = XMVectorReplicate(bindings[s].Barycentrics.x);
+		XMVECTOR b1 = XMVectorReplicate(bindings[s].Barycentrics.y);
+		XMVECTOR b2 = XMVectorReplicate(bindings[s].Barycentrics.z);
+		XMVECTOR root = XMLoadFloat3(&v0.Position) * b0 + XMLoadFloat3(&v1.Position) * b1 + XMLoadFloat3(&v2.Position) * b2;
+		XMMATRIX frame = RootFrame(
+			XMLoadFloat3(&v0.Normal) * b0 + XMLoadFloat3(&v1.Normal) * b1 + XMLoadFloat3(&v2.Normal) * b2,
+			XMLoadFloat3(&v0.Tangent) * b0 + XMLoadFloat3(&v1.Tangent) * b1 + XMLoadFloat3(&v2.Tangent) * b2);
+		XMMATRIX boundFrame = RootFrame(XMLoadFloat3(&boundRoots[s].Normal), XMLoadFloat3(&boundRoots[s].Tangent));
+		XMVECTOR boundRoot = XMLoadFloat3(&boundRoots[s].Position);
+
+		// Row vectors, so into the bound frame's coordinates is times its transpose
+		XMMATRIX rotation = XMMatrixTranspose(boundFrame) * frame;
+		for (int v = s * vertsPerStrand; v < (s + 1) * vertsPerStrand; v++)
+		{
+			rest[v] = boundRest[v];
+			XMStoreFloat3(&rest[v].OriginalPosition, root + XMVector3TransformNormal(XMLoadFloat3(&boundRest[v].OriginalPosition) - boundRoot, rotation));
+			XMStoreFloat3(&rest[v].Normal, XMVector3TransformNormal(XMLoadFloat3(&boundRest[v].Normal), rotation));
+			XMStoreFloat3(&rest[v].Tangent, XMVector3TransformNormal(XMLoadFloat3(&boundRest[v].Tangent), rotation));
+		}
+	}
+}
+
+void HairRootSampler::FindNearest(const XMFLOAT3* sources, int numOfSources, const XMFLOAT3* targets, int numOfTargets, std::vector<int>& nearest)
+{
+	nearest.assign(numOfTargets, -1);
+	if (numOfSources == 0)
+		return;
+
+	// Cubic cells, the longest side of the sources' bounds split into 32
+	XMVECTOR lo = XMLoadFloat3(&sources[0]);
+	XMVECTOR hi = lo;
+	for (int i = 1; i < numOfSources; i++)
+	{
+		lo = XMVectorMin(lo, XMLoadFloat3(&sources[i]));
+		hi = XMVectorMax(hi, XMLoadFloat3(&sources[i]));
+	}
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, hi - lo);
+	float cellSize = std::max(std::max(extent.x, extent.y), extent.z) / 32.0f;
+	if (cellSize <= 0)
+		cellSize = 1.0f;
+	int dims[3] = { (int)(extent.x / cellSize) + 1, (int)(extent.y / cellSize) + 1, (int)(extent.z / cellSize) + 1 };
+
+	auto cellOf = [&](const XMFLOAT3& p, int axis)
+	{
+		float coordinate = axis == 0 ? p.x - XMVectorGetX(lo) : axis == 1 ? p.y - XMVectorGetY(lo) : p.z - XMVectorGetZ(lo);
+		return std::min(std::max((int)std::floor(coordinate / cellSize), 0), dims[axis] - 1);
+	};
+
+	std::vector<std::vector<int>> cells(dims[0] * dims[1] * dims[2]);
+	for (int i = 0; i < numOfSources; i++)
+		cells[(cellOf(sources[i], 2) * dims[1] + cellOf(sources[i], 1)) * dims[0] + cellOf(sources[i], 0)].push_back(i);
+
+	int maxRing = std::max(std::max(dims[0], dims[1]), dims[2]);
+	for (int t = 0; t < numOfTargets; t++)
+	{
+		int cx = cellOf(targets[t], 0);
+		int cy = cellOf(targets[t], 1);
+		int cz = cellOf(targets[t], 2);
+		XMVECTOR target = XMLoadFloat3(&targets[t]);
+		float bestDistance = FLT_MAX;
+
+		// Shells of cells further and further out. Anything in a shell is at least one cell less than its ring away
+		for (int ring = 0; ring < maxRing; ring++)
+		{
+			if (nearest[t] >= 0 && bestDistance <= (ring - 1) * cellSize)
+				break;
+			for (int z = std::max(cz - ring, 0); z <= std::min(cz + ring, dims[2] - 1); z++)
+			{
+				for (int y = std::max(cy - ring, 0); y <= std::min(cy + ring, dims[1] - 1); y++)
+				{
+					for (int x = std::max(cx - ring, 0); x <= std::min(cx + ring, dims[0] - 1); x++)
+					{
+						if (std::max(std::max(std::abs(x - cx), std::abs(y - cy)), std::abs(z - cz)) != ring)
+							continue;
+						for (int source : cells[(z * dims[1] + y) * dims[0] + x])
+						{
+							float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sources[source]) - target));
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								nearest[t] = source;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+#include "ShaderVertex.h"
+#include "HairStrand.h"
+
+// 8 bit RGBA texels looked up by UV, red in the lowest byte.
+// Kept on the CPU for placing and setting up strands
+struct HairUVMap
+{
+	int Width = 0;
+	int Height = 0;
+	std::vector<unsigned int> Texels;
+
+	// Nearest texel, wrapping like the default sampler. Empty maps return fallback
+	unsigned int Sample(DirectX::XMFLOAT2 uv, unsigned int fallback) const;
+};
+
+// Greyscale 0-1 density multiplier looked up by UV,
+// an empty mask (Width == 0) means full density everywhere
+struct HairDensityMask
+{
+	int Width = 0;
+	int Height = 0;
+	std::vector<float> Values;
+
+	float Sample(DirectX::XMFLOAT2 uv) const;
+};
+
+// --------------------------------------------------------
+// Places hair roots over a triangle mesh by surface area
+//
+// Density is in strands per square unit, so coverage doesn't
+// depend on how finely the mesh is tessellated. The same mesh,
+// density, seed and mask always give the same roots.
+// --------------------------------------------------------
+class HairRootSampler
+{
+public:
+	static void Sample(const Vertex* verts, const unsigned int* indices, int numIndices, float density, unsigned int seed,
+		const HairDensityMask* mask, std::vector<HairRootBinding>& bindings);
+
+	// Interpolates the triangle a root is bound to
+	static Vertex Evaluate(const Vertex* verts, const unsigned int* indices, const HairRootBinding& binding);
+
+	// Port of UpdateHairRoots.hlsl, carries each strand's rest pose from the root it was grown on
+	// (boundRoots, boundRest) to where its binding sits on the surface now
+	static void UpdateRoots(const Vertex* surfaceVerts, const unsigned int* surfaceIndices, const HairRootBinding* bindings,
+		const ShaderVertex* boundRoots, const HairRestVertex* boundRest, HairRestVertex* rest, int numOfStrands, int vertsPerStrand);
+
+	// For every target root, the index of the closest source root (-1 without any sources).
+	// Bucketed on a grid over the sources, so carrying a dense groom over to new roots stays fast
+	static void FindNearest(const DirectX::XMFLOAT3* sources, int numOfSources, const DirectX::XMFLOAT3* targets, int numOfTargets, std::vector<int>& nearest);
+};
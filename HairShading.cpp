@@ -0,0 +1,223 @@
+#include "HairShading.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace DirectX;
+
+// Samples across the fibre's cross section for every azimuthal texel
+#define HAIR_SHADING_AZIMUTHAL_SAMPLES 256
+
+// Normalized so it integrates to 1
+static float Gaussian(float width, float x)
+{
+	return expf(-x * x / (2.0f * width * width)) / (width * sqrtf(XM_2PI));
+}
+
+// Dielectric Fresnel for unpolarized light entering a material with this index
+static float Fresnel(float eta, float cosI)
+{
+	cosI = std::min(std::max(cosI, 0.0f), 1.0f);
+	float sinT2 = (1.0f - cosI * cosI) / (eta * eta);
+	if (sinT2 >= 1.0f)
+		return 1.0f;
+	float cosT = sqrtf(1.0f - sinT2);
+	float rs = (cosI - eta * cosT) / (cosI + eta * cosT);
+	float rp = (eta * cosI - cosT) / (eta * cosI + cosT);
+	return 0.5f * (rs * rs + rp * rp);
+}
+
+// perlin() from HelperMethods.hlsli, with the shader's integer maths. Its rotations
+// shift by the full width, which the GPU masks down to nothing, so they're only a test for zero
+static float PerlinGradientDot(int ix, int iy, float x, float y)
+{
+	unsigned int a = (unsigned int)ix;
+	unsigned int b = (unsigned int)iy;
+	a *= 3284157443U;
+	b ^= a != 0 ? 1U : 0U;
+	b *= 1911520717U;
+	a ^= b != 0 ? 1U : 0U;
+	a *= 2048419325U;
+	float random = (int)a * (3.14159265f / 2147483648.0f);
+	return (x - (float)ix) * cosf(random) + (y - (float)iy) * sinf(random);
+}
+
+static float Perlin(float x, float y)
+{
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float sx = x - (float)x0;
+	float sy = y - (float)y0;
+	float ix0 = PerlinGradientDot(x0, y0, x, y) + (PerlinGradientDot(x0 + 1, y0, x, y) - PerlinGradientDot(x0, y0, x, y)) * sx;
+	float ix1 = PerlinGradientDot(x0, y0 + 1, x, y) + (PerlinGradientDot(x0 + 1, y0 + 1, x, y) - PerlinGradientDot(x0, y0 + 1, x, y)) * sx;
+	return ix0 + (ix1 - ix0) * sy;
+}
+
+HairShading::HairShading() :
+	size(0),
+	params(GetDefaultParams()),
+	bakeMilliseconds(0)
+{
+}
+
+HairShadingParams HairShading::GetDefaultParams()
+{
+	HairShadingParams defaults = {};
+	defaults.LongitudinalShift = HAIR_SHADING_DEFAULT_SHIFT;
+	defaults.LongitudinalWidth = HAIR_SHADING_DEFAULT_WIDTH;
+	defaults.AzimuthalWidth = HAIR_SHADING_DEFAULT_AZIMUTHAL_WIDTH;
+	defaults.Eta = HAIR_SHADING_DEFAULT_ETA;
+	return defaults;
+}
+
+XMFLOAT4 HairShading::Longitudinal(const HairShadingParams& params, float sinThetaI, float sinThetaR)
+{
+	float thetaI = asinf(std::min(std::max(sinThetaI, -1.0f), 1.0f));
+	float thetaR = asinf(std::min(std::max(sinThetaR, -1.0f), 1.0f));
+	float thetaH = (thetaI + thetaR) * 0.5f;
+	float thetaD = (thetaI - thetaR) * 0.5f;
+
+	float shift = params.LongitudinalShift;
+	float width = params.LongitudinalWidth;
+	return XMFLOAT4(
+		Gaussian(width, thetaH - shift),
+		Gaussian(width * 0.5f, thetaH + shift * 0.5f),
+		Gaussian(width * 2.0f, thetaH + shift * 1.5f),
+		cosf(thetaD));
+}
+
+XMFLOAT4 HairShading::Azimuthal(const HairShadingParams& params, float cosPhi, float cosThetaD)
+{
+	float phi = acosf(std::min(std::max(cosPhi, -1.0f), 1.0f));
+
+	// The fibre's cross section seen at an angle refracts like this index (Bravais)
+	float cosD = std::max(cosThetaD, 0.001f);
+	float eta = sqrtf(std::max(params.Eta * params.Eta - (1.0f - cosD * cosD), 1.0f)) / cosD;
+
+	// Every offset h across the fibre leaves at azimuth 2 p gammaT - 2 gammaI + p pi after p internal paths,
+	// spread around that by a Gaussian wrapped around the fibre
+	float lobes[3] = {};
+	for (int i = 0; i < HAIR_SHADING_AZIMUTHAL_SAMPLES; i++)
+	{
+		float h = -1.0f + (i + 0.5f) * 2.0f / HAIR_SHADING_AZIMUTHAL_SAMPLES;
+		float gammaI = asinf(h);
+		float gammaT = asinf(h / eta);
+		float fresnel = Fresnel(eta, cosf(gammaI));
+		float attenuation[3] = { fresnel, (1.0f - fresnel) * (1.0f - fresnel), (1.0f - fresnel) * (1.0f - fresnel) * fresnel };
+
+		for (int p = 0; p < 3; p++)
+		{
+			float exitPhi = 2.0f * p * gammaT - 2.0f * gammaI + p * XM_PI;
+			float offset = remainderf(phi - exitPhi, XM_2PI);
+			float spread = 0;
+			for (int k = -1; k <= 1; k++)
+				spread += Gaussian(params.AzimuthalWidth, offset + k * XM_2PI);
+			lobes[p] += attenuation[p] * spread;
+		}
+	}
+
+	// Averaged over h from -1 to 1
+	float scale = 1.0f / HAIR_SHADING_AZIMUTHAL_SAMPLES;
+	return XMFLOAT4(lobes[0] * scale, lobes[1] * scale, lobes[2] * scale, 1.0f);
+}
+
+float HairShading::ColorBlend(float u, float v)
+{
+	float blend = sinf(v * XM_PIDIV2) - fabsf(Perlin(u, v));
+	return std::min(std::max(blend, 0.0f), 1.0f);
+}
+
+void HairShading::Bake(const HairShadingParams& params, int size, int threads)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	this->size = std::max(size, 2);
+	this->params = params;
+
+	int res = this->size;
+	longitudinal.assign((size_t)res * res, XMFLOAT4(0, 0, 0, 0));
+	azimuthal.assign((size_t)res * res, XMFLOAT4(0, 0, 0, 0));
+	colorBlend.assign((size_t)res * res, 0.0f);
+
+	// Threads take whole rows off a shared counter until there are none left.
+	// Texel centres, so a linear sampler gives back the exact value there
+	std::atomic<int> nextRow(0);
+	auto bakeRows = [&]()
+	{
+		for (int y = nextRow++; y < res; y = nextRow++)
+		{
+			float v = (y + 0.5f) / res;
+			for (int x = 0; x < res; x++)
+			{
+				float u = (x + 0.5f) / res;
+				size_t texel = (size_t)y * res + x;
+				longitudinal[texel] = Longitudinal(params, u * 2.0f - 1.0f, v * 2.0f - 1.0f);
+				azimuthal[texel] = Azimuthal(params, u * 2.0f - 1.0f, v);
+				colorBlend[texel] = ColorBlend(u, v);
+			}
+		}
+	};
+
+	int threadCount = threads > 0 ? threads : std::max((int)std::thread::hardware_concurrency(), 1);
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.emplace_back(bakeRows);
+	bakeRows();
+	for (auto& worker : workers)
+		worker.join();
+
+	bakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool HairShading::Load(const std::string& path, const HairShadingParams& params, int size)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	HairShadingHeader header = {};
+	in.read((char*)&header, sizeof(HairShadingHeader));
+	if (!in.good() || memcmp(header.Magic, "HLUT", 4) != 0 || header.Version != version ||
+		header.Size != (unsigned int)size || memcmp(&header.Params, &params, sizeof(HairShadingParams)) != 0)
+		return false;
+
+	size_t texels = (size_t)size * size;
+	std::vector<XMFLOAT4> loadedLongitudinal(texels);
+	std::vector<XMFLOAT4> loadedAzimuthal(texels);
+	std::vector<float> loadedColorBlend(texels);
+	in.read((char*)loadedLongitudinal.data(), texels * sizeof(XMFLOAT4));
+	in.read((char*)loadedAzimuthal.data(), texels * sizeof(XMFLOAT4));
+	in.read((char*)loadedColorBlend.data(), texels * sizeof(float));
+	if (!in.good())
+		return false;
+
+	this->size = size;
+	this->params = params;
+	longitudinal.swap(loadedLongitudinal);
+	azimuthal.swap(loadedAzimuthal);
+	colorBlend.swap(loadedColorBlend);
+	bakeMilliseconds = 0;
+	return true;
+}
+
+bool HairShading::Save(const std::string& path)
+{
+	HairShadingHeader header = {};
+	memcpy(header.Magic, "HLUT", 4);
+	header.Version = version;
+	header.Size = size;
+	header.Params = params;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+	out.write((const char*)&header, sizeof(HairShadingHeader));
+	out.write((const char*)longitudinal.data(), longitudinal.size() * sizeof(XMFLOAT4));
+	out.write((const char*)azimuthal.data(), azimuthal.size() * sizeof(XMFLOAT4));
+	out.write((const char*)colorBlend.data(), colorBlend.size() * sizeof(float));
+	return out.good();
+}
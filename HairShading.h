@@ -0,0 +1,86 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "HairShared.h"
+
+// What the tables are baked for, a change means baking them again
+struct HairShadingParams
+{
+	float LongitudinalShift;	// Of the R lobe, TT and TRT are shifted -1/2 and -3/2 as far
+	float LongitudinalWidth;	// Of the R lobe, TT is half as wide and TRT twice
+	float AzimuthalWidth;		// Spread of every lobe around the fibre
+	float Eta;					// Index of refraction of the fibre
+};
+
+// Start of every .lut file, the three tables follow right after it
+struct HairShadingHeader
+{
+	char Magic[4];					// "HLUT"
+	unsigned int Version;
+	unsigned int Size;
+	HairShadingParams Params;
+};
+
+// --------------------------------------------------------
+// Lookup tables for HairPS.hlsl's Marschner shading
+//
+// The Marschner model splits light scattered by a fibre into
+// R (reflected off the surface), TT (through the fibre) and TRT
+// (reflected once inside) lobes, each a longitudinal term M
+// times an azimuthal term N. The N terms integrate every path
+// through the fibre's cross section, far too much per pixel,
+// so both are baked into size^2 tables like the IBL BRDF lookup
+// texture (see Sky::IBLCreateBRDFLookUpTexture) and a pixel
+// only fetches them:
+//
+//  Longitudinal: u = sin(theta i), v = sin(theta r), both
+//  remapped to 0-1. RGB = M of R, TT and TRT, A = cos(theta d)
+//  Azimuthal: u = cos(phi) remapped to 0-1, v = cos(theta d).
+//  RGB = N of R, TT and TRT before the hair's own absorption
+//  Color blend: root to tip color blend over the ribbon's UVs,
+//  what HairPS used to work out with perlin() every pixel
+//
+// The bake is spread over all cores and cached, like
+// HairCollisionField. Only depends on DirectXMath so it can be
+// tested headless.
+// --------------------------------------------------------
+class HairShading
+{
+public:
+	HairShading();
+
+	// threads = 0 uses every core
+	void Bake(const HairShadingParams& params, int size = HAIR_SHADING_LUT_SIZE, int threads = 0);
+
+	// Load() fails if the file was baked with other parameters or at another size
+	bool Load(const std::string& path, const HairShadingParams& params, int size = HAIR_SHADING_LUT_SIZE);
+	bool Save(const std::string& path);
+
+	static HairShadingParams GetDefaultParams();
+
+	// The terms the tables hold, straight from the model
+	static DirectX::XMFLOAT4 Longitudinal(const HairShadingParams& params, float sinThetaI, float sinThetaR);
+	static DirectX::XMFLOAT4 Azimuthal(const HairShadingParams& params, float cosPhi, float cosThetaD);
+	static float ColorBlend(float u, float v);
+
+	int GetSize() { return size; }
+	const HairShadingParams& GetParams() { return params; }
+	// Row by row, u fastest
+	const std::vector<DirectX::XMFLOAT4>& GetLongitudinalTable() { return longitudinal; }
+	const std::vector<DirectX::XMFLOAT4>& GetAzimuthalTable() { return azimuthal; }
+	const std::vector<float>& GetColorBlendTable() { return colorBlend; }
+	double GetBakeMilliseconds() { return bakeMilliseconds; }
+
+private:
+	int size;
+	HairShadingParams params;
+	std::vector<DirectX::XMFLOAT4> longitudinal;
+	std::vector<DirectX::XMFLOAT4> azimuthal;
+	std::vector<float> colorBlend;
+	double bakeMilliseconds;
+
+	static const unsigned int version = 1;
+};
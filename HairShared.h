@@ -0,0 +1,147 @@
+// --------------------------------------------------------
+// Hair simulation constants shared between C++ and HLSL
+//
+// Only preprocessor defines in here so both compilers
+// can include it - no types or functions!
+// --------------------------------------------------------
+#ifndef _HAIRSHARED_H
+#define _HAIRSHARED_H
+
+// Every strand is (segments + 1) vertices.
+// The kernels keep a whole strand in registers, hence the upper limit
+#define HAIR_MAX_VERTS_PER_STRAND 16
+#define HAIR_DEFAULT_SEGMENTS 4
+
+// Strands per square unit of mesh surface (see HairRootSampler)
+#define HAIR_DEFAULT_ROOT_DENSITY 150.0f
+#define HAIR_MAX_ROOT_DENSITY 2000.0f
+
+// Only every Nth strand is simulated, the rest follow the
+// HAIR_FOLLOWER_GUIDES nearest guides
+#define HAIR_DEFAULT_GUIDE_RATIO 4
+#define HAIR_MAX_GUIDE_RATIO 16
+#define HAIR_FOLLOWER_GUIDES 3
+
+// LOD 0 is every strand at full detail, every level after that
+// only draws and simulates guides, halving the guides and the segments.
+// Full detail is kept while the hair's bounding sphere covers at least
+// this much of the screen height (radius / half height), each halving drops a level
+#define HAIR_LOD_LEVELS 4
+#define HAIR_LOD_FULL_DETAIL_SIZE 0.25f
+
+// Drawn strands are Catmull-Rom curves through the simulated vertices,
+// each segment split until its pieces are about this fraction of half
+// the screen height on screen, up to the maximum (see HairRibbon.h)
+#define HAIR_TESSELLATION_SCREEN_LENGTH 0.02f
+#define HAIR_MAX_TESSELLATION 8
+
+// Strands are culled in clusters of this many neighbours (see HairClusters).
+// Bounds come back from the GPU a few frames late, so they're grown by
+// this fraction of the hair length to still cover the hair by then
+#define HAIR_CLUSTER_STRANDS 128
+#define HAIR_CLUSTER_GROUP_SIZE 64
+#define HAIR_CLUSTER_BOUNDS_MARGIN 0.1f
+
+// Acceleration (units/s^2) per unit of external force
+#define HAIR_FORCE_ACCELERATION 5.0f
+
+// How much of the entity's own acceleration the hair feels (1 = all of it),
+// clamped to this many units/s^2 so teleports don't fling the hair off
+#define HAIR_DEFAULT_INERTIA 1.0f
+#define HAIR_MAX_INERTIAL_ACCELERATION 100.0f
+
+// The solver always steps by the same amount, frames run however many
+// steps fit in their time. Anything over the max substeps is dropped,
+// so a long frame makes the hair lag instead of blowing up
+#define HAIR_FIXED_TIMESTEP (1.0f / 120.0f)
+#define HAIR_MAX_SUBSTEPS 4
+
+// Default position based dynamics solver settings
+#define HAIR_DEFAULT_ITERATIONS 4
+#define HAIR_DEFAULT_DAMPING 0.05f
+#define HAIR_DEFAULT_DISTANCE_STIFFNESS 1.0f
+#define HAIR_DEFAULT_BEND_STIFFNESS 0.5f
+#define HAIR_DEFAULT_SHAPE_STIFFNESS 0.1f
+// Per second, how fast a vertex picks up the wind's velocity (see WindField)
+#define HAIR_DEFAULT_WIND_DRAG 2.0f
+
+// A strand that moves less than HAIR_SLEEP_DISTANCE per step for HAIR_SLEEP_STEPS
+// steps in a row falls asleep and drops out of the active list. Has to be more
+// steps than the state ring has slots so every slot holds the resting pose
+#define HAIR_SLEEP_DISTANCE 0.0001f
+#define HAIR_SLEEP_STEPS 8
+// Most slots a state ring can have (see Mesh::SetHairStateRing), kept under HAIR_SLEEP_STEPS
+#define HAIR_MAX_STATE_SLOTS 4
+#ifdef __cplusplus
+static_assert(HAIR_MAX_STATE_SLOTS < HAIR_SLEEP_STEPS, "A strand has to rest for longer than the ring has slots before it falls asleep");
+#endif
+#define HAIR_SIMULATE_GROUP_SIZE 64
+
+// The CPU solver splits the guides into batches whose simulation, rest
+// and physics data fit in this many bytes, so a batch stays in cache
+// from start to finish (see HairParallelSimulator)
+#define HAIR_CPU_BATCH_BYTES 32768
+
+// Hair is kept this far outside its mesh using a signed distance field
+// baked at resolution^3 cells (see HairCollisionField)
+#define HAIR_SDF_DEFAULT_RESOLUTION 32
+#define HAIR_SDF_MAX_RESOLUTION 128
+#define HAIR_COLLISION_MARGIN 0.01f
+
+// Hair-hair interaction: every step the guides are splatted into a
+// resolution^3 grid over the hair's bounds (see HairVoxelGrid).
+// Vertices are pushed out of crowded cells by the pressure and pick up
+// the cell's average velocity by the friction (0-1, per step).
+// The GPU accumulates with integer atomics, scaled by the fixed point factor
+#define HAIR_VOXEL_RESOLUTION 32
+#define HAIR_VOXEL_GROUP_SIZE 4
+#define HAIR_VOXEL_FIXED_POINT 4096.0f
+#define HAIR_DEFAULT_VOLUME_PRESSURE 0.2f
+#define HAIR_DEFAULT_VOLUME_FRICTION 0.05f
+
+// The state ring is packed relative to each strand's root (see HairPacking.h).
+// Offsets reach this many hair lengths from the root, the motion per step
+// this fraction of that. Anything further is clamped
+#define HAIR_PACKED_POSITION_RANGE 1.5f
+#define HAIR_PACKED_MOTION_RANGE 0.125f
+
+// Per vertex physics, one byte each (see HairPackPhysics):
+// stiffness, damping and rest length multipliers where 128 = 1,
+// then the pin weight where 255 = fully pinned to the rest pose
+#define HAIR_PHYSICS_UNIT 128.0f
+#define HAIR_PHYSICS_DEFAULT 0x00808080
+
+// Hair shading (see HairShading.h): the Marschner lobes are baked into
+// size^2 lookup tables. Angles in radians, the shift is how far the
+// highlight moves towards the root, the widths are the lobes' roughness
+#define HAIR_SHADING_LUT_SIZE 64
+#define HAIR_SHADING_DEFAULT_SHIFT -0.0873f
+#define HAIR_SHADING_DEFAULT_WIDTH 0.1309f
+#define HAIR_SHADING_DEFAULT_AZIMUTHAL_WIDTH 0.35f
+#define HAIR_SHADING_DEFAULT_ETA 1.55f
+#define HAIR_SHADING_KAJIYA_KAY 0
+#define HAIR_SHADING_MARSCHNER 1
+
+// Recordings (see HairRecording.h) checksum the state every this many
+// frames and store all of it every this many, 0 = never. Both read
+// the state ring back, which stalls the GPU for that frame
+#define HAIR_RECORD_CHECKSUM_INTERVAL 10
+#define HAIR_RECORD_KEYFRAME_INTERVAL 600
+
+// The golden state regression (see HairRegression.h) grows hair this long on
+// every model and runs this many scripted frames of this length. A final state
+// with another checksum and any sampled vertex further than the tolerance from
+// the golden one is a failure
+#define HAIR_REGRESSION_LENGTH 0.5f
+#define HAIR_REGRESSION_FRAMES 240
+#define HAIR_REGRESSION_FRAME_TIME (1.0f / 60.0f)
+#define HAIR_REGRESSION_TOLERANCE 0.001f
+// Vertices kept in a golden file besides the checksum, what the tolerance is measured on
+#define HAIR_REGRESSION_GOLDEN_SAMPLES 1024
+// Coarser than the game's collision fields, baking them is most of the run otherwise
+#define HAIR_REGRESSION_SDF_RESOLUTION 16
+
+// Constraints shorter than this are left alone to avoid dividing by zero
+#define HAIR_CONSTRAINT_EPSILON 0.000001f
+
+#endif
@@ -0,0 +1,539 @@
+#include "HairSimulator.h"
+#include "HairCollisionField.h"
+#include "HairVoxelGrid.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// Four float3's transposed so each vector holds one axis of four strands
+struct StrandLanes
+{
+	XMVECTOR x;
+	XMVECTOR y;
+	XMVECTOR z;
+};
+
+template<typename T, typename Member>
+static StrandLanes LoadLanes(T* lanes[4], XMFLOAT3 Member::* member)
+{
+	XMMATRIX m;
+	m.r[0] = XMLoadFloat3(&(lanes[0]->*member));
+	m.r[1] = XMLoadFloat3(&(lanes[1]->*member));
+	m.r[2] = XMLoadFloat3(&(lanes[2]->*member));
+	m.r[3] = XMLoadFloat3(&(lanes[3]->*member));
+	m = XMMatrixTranspose(m);
+	return { m.r[0], m.r[1], m.r[2] };
+}
+
+template<typename T>
+static void StoreLanes(T* lanes[4], XMFLOAT3 T::* member, const StrandLanes& v)
+{
+	XMMATRIX m;
+	m.r[0] = v.x;
+	m.r[1] = v.y;
+	m.r[2] = v.z;
+	m.r[3] = XMVectorZero();
+	m = XMMatrixTranspose(m);
+	XMStoreFloat3(&(lanes[0]->*member), m.r[0]);
+	XMStoreFloat3(&(lanes[1]->*member), m.r[1]);
+	XMStoreFloat3(&(lanes[2]->*member), m.r[2]);
+	XMStoreFloat3(&(lanes[3]->*member), m.r[3]);
+}
+
+// Settings with the stiffnesses already adjusted for the iteration count, like the constant buffer gets
+static HairSolverSettings AdjustSettings(const HairSolverSettings& settings)
+{
+	HairSolverSettings adjusted = settings;
+	adjusted.Iterations = std::max(settings.Iterations, 1);
+	adjusted.DistanceStiffness = HairSimulator::GetIterationStiffness(settings.DistanceStiffness, adjusted.Iterations);
+	adjusted.BendStiffness = HairSimulator::GetIterationStiffness(settings.BendStiffness, adjusted.Iterations);
+	adjusted.ShapeStiffness = HairSimulator::GetIterationStiffness(settings.ShapeStiffness, adjusted.Iterations);
+	return adjusted;
+}
+
+// Same as the helpers in HairPhysicsHelper.hlsli
+static void VerletIntegrate(XMVECTOR& position, XMVECTOR& prevPosition, FXMVECTOR acceleration, float damping, float deltaTime)
+{
+	XMVECTOR velocity = (position - prevPosition) * (1.0f - damping);
+	prevPosition = position;
+	position = position + velocity + acceleration * (deltaTime * deltaTime);
+}
+
+static void SolveDistance(XMVECTOR& p0, XMVECTOR& p1, float restLength, float invMass0, float invMass1, float stiffness)
+{
+	XMVECTOR delta = p1 - p0;
+	float len = XMVectorGetX(XMVector3Length(delta));
+	float scale = len > HAIR_CONSTRAINT_EPSILON ? (len - restLength) / std::max(len, HAIR_CONSTRAINT_EPSILON) * stiffness / (invMass0 + invMass1) : 0.0f;
+	XMVECTOR correction = delta * scale;
+	p0 += correction * invMass0;
+	p1 -= correction * invMass1;
+}
+
+static XMVECTOR SolveShape(FXMVECTOR position, FXMVECTOR restPosition, float stiffness)
+{
+	return position + (restPosition - position) * stiffness;
+}
+
+// Out of the field until margin away from the surface, the gradient from six more samples a cell apart
+static XMVECTOR SolveCollision(FXMVECTOR position, const HairCollisionField& field, float margin)
+{
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, position);
+	float distance = field.Sample(p);
+	if (distance >= margin)
+		return position;
+
+	float texel = field.GetCellSize();
+	XMVECTOR gradient = XMVectorSet(
+		field.Sample(XMFLOAT3(p.x + texel, p.y, p.z)) - field.Sample(XMFLOAT3(p.x - texel, p.y, p.z)),
+		field.Sample(XMFLOAT3(p.x, p.y + texel, p.z)) - field.Sample(XMFLOAT3(p.x, p.y - texel, p.z)),
+		field.Sample(XMFLOAT3(p.x, p.y, p.z + texel)) - field.Sample(XMFLOAT3(p.x, p.y, p.z - texel)),
+		0);
+	float gradientLength = XMVectorGetX(XMVector3Length(gradient));
+	if (gradientLength < HAIR_CONSTRAINT_EPSILON)
+		return position;
+	return position + gradient / gradientLength * (margin - distance);
+}
+
+// Same for four strands, one lane at a time since every lane samples somewhere else
+static void SolveCollisionLanes(StrandLanes& p, const HairCollisionField& field, float margin)
+{
+	XMMATRIX m;
+	m.r[0] = p.x;
+	m.r[1] = p.y;
+	m.r[2] = p.z;
+	m.r[3] = XMVectorZero();
+	m = XMMatrixTranspose(m);
+	for (int lane = 0; lane < 4; lane++)
+		m.r[lane] = SolveCollision(m.r[lane], field, margin);
+	m = XMMatrixTranspose(m);
+	p = { m.r[0], m.r[1], m.r[2] };
+}
+
+// Drag towards the wind's velocity, relative to how the vertex is already moving
+static XMVECTOR GetWindAcceleration(FXMVECTOR position, FXMVECTOR prevPosition, const HairSolverFields& fields, float windDrag, float deltaTime)
+{
+	XMFLOAT3 worldPos;
+	XMStoreFloat3(&worldPos, XMVector3Transform(position, XMLoadFloat4x4(&fields.World)));
+	XMFLOAT3 wind = WindNoise::Sample(*fields.Wind, worldPos);
+	XMVECTOR objectWind = XMVector3TransformNormal(XMLoadFloat3(&wind), XMLoadFloat4x4(&fields.WorldInverse));
+	return (objectWind - (position - prevPosition) / deltaTime) * windDrag;
+}
+
+// Four strands at once, one constraint per lane
+static void SolveDistanceLanes(StrandLanes& p0, StrandLanes& p1, FXMVECTOR restLength, float invMass0, float invMass1, FXMVECTOR stiffness)
+{
+	XMVECTOR epsilon = XMVectorReplicate(HAIR_CONSTRAINT_EPSILON);
+	StrandLanes delta = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+	XMVECTOR len = XMVectorSqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+	XMVECTOR scale = (len - restLength) / XMVectorMax(len, epsilon) * stiffness * (1.0f / (invMass0 + invMass1));
+	scale = XMVectorSelect(XMVectorZero(), scale, XMVectorGreater(len, epsilon));
+
+	XMVECTOR w0 = scale * invMass0;
+	XMVECTOR w1 = scale * invMass1;
+	p0 = { p0.x + delta.x * w0, p0.y + delta.y * w0, p0.z + delta.z * w0 };
+	p1 = { p1.x - delta.x * w1, p1.y - delta.y * w1, p1.z - delta.z * w1 };
+}
+
+// Runs the solver on one strand with already adjusted settings
+static void SolveStrand(HairSimVertex* strand, const HairRestVertex* rest, const unsigned int* physicsData, int vertsPerStrand, const HairSolverSettings& adjusted, const HairExternalForces& forces, float deltaTime,
+	const HairSolverFields* fields)
+{
+	XMVECTOR positions[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR prevPositions[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR restPositions[HAIR_MAX_VERTS_PER_STRAND];
+	HairVertexPhysics physics[HAIR_MAX_VERTS_PER_STRAND];
+
+	XMVECTOR force = XMLoadFloat3(&forces.Force) * HAIR_FORCE_ACCELERATION;
+	XMMATRIX inertia = XMLoadFloat4x4(&forces.Inertia) * adjusted.Inertia;
+	bool windy = fields && fields->Wind && adjusted.WindDrag > 0 && deltaTime > 0;
+	bool volume = fields && fields->Volume && (adjusted.VolumePressure > 0 || adjusted.VolumeFriction > 0);
+	for (int i = 0; i < vertsPerStrand; i++)
+	{
+		// Pushed apart from and dragged along with the hair around it, the pinned root excepted
+		HairSimVertex vertex = strand[i];
+		if (volume && i > 0)
+			fields->Volume->SolveVertex(vertex, adjusted.VolumePressure, adjusted.VolumeFriction, deltaTime);
+		positions[i] = XMLoadFloat3(&vertex.Position);
+		prevPositions[i] = XMLoadFloat3(&vertex.PreviousPosition);
+		restPositions[i] = XMLoadFloat3(&rest[i].OriginalPosition);
+		physics[i] = HairUnpackPhysics(physicsData ? physicsData[i] : HAIR_PHYSICS_DEFAULT);
+
+		XMVECTOR acceleration = force + XMVector3Transform(restPositions[i], inertia);
+		if (windy)
+			acceleration += GetWindAcceleration(positions[i], prevPositions[i], *fields, adjusted.WindDrag, deltaTime);
+		VerletIntegrate(positions[i], prevPositions[i], acceleration, std::min(adjusted.Damping * physics[i].Damping, 1.0f), deltaTime);
+	}
+
+	// Root pin
+	positions[0] = restPositions[0];
+	prevPositions[0] = restPositions[0];
+
+	for (int iteration = 0; iteration < adjusted.Iterations; iteration++)
+	{
+		for (int j = 1; j < vertsPerStrand; j++)
+			positions[j] = SolveShape(positions[j], restPositions[j], std::min(adjusted.ShapeStiffness * physics[j].Stiffness, 1.0f));
+
+		for (int k = 0; k < vertsPerStrand - 1; k++)
+		{
+			float restLength = XMVectorGetX(XMVector3Length(restPositions[k + 1] - restPositions[k])) * physics[k + 1].LengthScale;
+			SolveDistance(positions[k], positions[k + 1], restLength, k == 0 ? 0.0f : 1.0f, 1.0f, adjusted.DistanceStiffness);
+		}
+
+		for (int b = 0; b < vertsPerStrand - 2; b++)
+		{
+			float restLength = XMVectorGetX(XMVector3Length(restPositions[b + 2] - restPositions[b])) * physics[b + 2].LengthScale;
+			SolveDistance(positions[b], positions[b + 2], restLength, b == 0 ? 0.0f : 1.0f, 1.0f, std::min(adjusted.BendStiffness * physics[b + 2].Stiffness, 1.0f));
+		}
+
+		for (int p = 1; p < vertsPerStrand; p++)
+			positions[p] = SolveShape(positions[p], restPositions[p], physics[p].PinWeight);
+
+		// Last, so nothing ends the iteration inside the mesh
+		if (fields && fields->Collision)
+		{
+			for (int c = 1; c < vertsPerStrand; c++)
+				positions[c] = SolveCollision(positions[c], *fields->Collision, fields->CollisionMargin);
+		}
+	}
+
+	for (int v = 0; v < vertsPerStrand; v++)
+	{
+		XMStoreFloat3(&strand[v].Position, positions[v]);
+		XMStoreFloat3(&strand[v].PreviousPosition, prevPositions[v]);
+	}
+}
+
+float HairSimulator::GetIterationStiffness(float stiffness, int iterations)
+{
+	// Applying k' every iteration closes the same fraction of the error as k applied once
+	stiffness = std::min(std::max(stiffness, 0.0f), 1.0f);
+	return 1.0f - std::pow(1.0f - stiffness, 1.0f / std::max(iterations, 1));
+}
+
+HairSolverSettings HairSimulator::GetDefaultSettings()
+{
+	HairSolverSettings settings;
+	settings.Iterations = HAIR_DEFAULT_ITERATIONS;
+	settings.Damping = HAIR_DEFAULT_DAMPING;
+	settings.DistanceStiffness = HAIR_DEFAULT_DISTANCE_STIFFNESS;
+	settings.BendStiffness = HAIR_DEFAULT_BEND_STIFFNESS;
+	settings.ShapeStiffness = HAIR_DEFAULT_SHAPE_STIFFNESS;
+	settings.Inertia = HAIR_DEFAULT_INERTIA;
+	settings.WindDrag = HAIR_DEFAULT_WIND_DRAG;
+	settings.VolumePressure = HAIR_DEFAULT_VOLUME_PRESSURE;
+	settings.VolumeFriction = HAIR_DEFAULT_VOLUME_FRICTION;
+	return settings;
+}
+
+XMFLOAT4X4 HairSimulator::GetFrameVelocity(XMFLOAT4X4 world, XMFLOAT4X4 prevWorld, float deltaTime)
+{
+	XMFLOAT4X4 velocity;
+	XMStoreFloat4x4(&velocity, (XMLoadFloat4x4(&world) - XMLoadFloat4x4(&prevWorld)) * (deltaTime > 0 ? 1.0f / deltaTime : 0.0f));
+	return velocity;
+}
+
+XMFLOAT4X4 HairSimulator::GetInertia(XMFLOAT4X4 prevWorld, XMFLOAT4X4 velocity, XMFLOAT4X4 prevVelocity, float deltaTime)
+{
+	// A point fixed to the entity accelerates by rest * acceleration in world space (w comes out 0),
+	// the hair feels the opposite of that. Linear, tangential and centripetal terms all fall out of it,
+	// only the velocity dependent Coriolis term is missing
+	XMMATRIX acceleration = (XMLoadFloat4x4(&velocity) - XMLoadFloat4x4(&prevVelocity)) * (deltaTime > 0 ? 1.0f / deltaTime : 0.0f);
+	XMMATRIX toObject = XMMatrixInverse(0, XMLoadFloat4x4(&prevWorld));
+
+	XMFLOAT4X4 inertia;
+	XMStoreFloat4x4(&inertia, -(acceleration * toObject));
+	return inertia;
+}
+
+float HairSimulator::ClampInertia(XMFLOAT4X4& inertia, XMFLOAT3 boundsCenter, float boundsRadius)
+{
+	XMMATRIX m = XMLoadFloat4x4(&inertia);
+	float linear = XMVectorGetX(XMVector3Length(XMVector3Transform(XMLoadFloat3(&boundsCenter), m)));
+	float angular = sqrtf(XMVectorGetX(XMVector3LengthSq(m.r[0]) + XMVector3LengthSq(m.r[1]) + XMVector3LengthSq(m.r[2])));
+	float acceleration = linear + angular * boundsRadius;
+	if (acceleration > HAIR_MAX_INERTIAL_ACCELERATION)
+	{
+		XMStoreFloat4x4(&inertia, m * (HAIR_MAX_INERTIAL_ACCELERATION / acceleration));
+		acceleration = HAIR_MAX_INERTIAL_ACCELERATION;
+	}
+	return acceleration;
+}
+
+void HairSimulator::Simulate(HairSimVertex* simData, const HairRestVertex* restData, int numOfStrands, int vertsPerStrand,
+	const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData, const HairSolverFields* fields)
+{
+	std::vector<int> allStrands(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		allStrands[i] = i;
+	if (fields && fields->Volume && (settings.VolumePressure > 0 || settings.VolumeFriction > 0))
+		fields->Volume->Splat(simData, allStrands.data(), numOfStrands, vertsPerStrand, deltaTime);
+	SimulateGuides(simData, restData, allStrands.data(), numOfStrands, vertsPerStrand, settings, forces, deltaTime, physicsData, fields);
+}
+
+void HairSimulator::SimulateGuides(HairSimVertex* simData, const HairRestVertex* restData, const int* guideStrands, int numOfGuides, int vertsPerStrand,
+	const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData, const HairSolverFields* fields)
+{
+	HairSolverSettings adjusted = AdjustSettings(settings);
+
+	int guide = 0;
+	for (; guide + 4 <= numOfGuides; guide += 4)
+	{
+		HairSimVertex* strands[4];
+		const HairRestVertex* rests[4];
+		const unsigned int* physics[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			strands[lane] = simData + guideStrands[guide + lane] * vertsPerStrand;
+			rests[lane] = restData + guideStrands[guide + lane] * vertsPerStrand;
+			physics[lane] = physicsData ? physicsData + guideStrands[guide + lane] * vertsPerStrand : 0;
+		}
+		SimulateStrandBatch(strands, rests, physics, vertsPerStrand, adjusted, forces, deltaTime, fields);
+	}
+
+	// Whatever doesn't fill a whole batch goes through the scalar path
+	for (; guide < numOfGuides; guide++)
+	{
+		int first = guideStrands[guide] * vertsPerStrand;
+		SolveStrand(simData + first, restData + first, physicsData ? physicsData + first : 0, vertsPerStrand, adjusted, forces, deltaTime, fields);
+	}
+}
+
+void HairSimulator::InterpolateFollowers(HairSimVertex* simData, const HairRestVertex* restData, const HairFollower* followers, int numOfFollowers, int vertsPerStrand)
+{
+	for (int f = 0; f < numOfFollowers; f++)
+	{
+		const HairFollower& follower = followers[f];
+		for (int v = 0; v < vertsPerStrand; v++)
+		{
+			XMVECTOR offset = XMVectorZero();
+			for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+			{
+				int guideVert = follower.Guides[i] * vertsPerStrand + v;
+				offset += (XMLoadFloat3(&simData[guideVert].Position) - XMLoadFloat3(&restData[guideVert].OriginalPosition)) * follower.Weights[i];
+			}
+
+			int vert = follower.Strand * vertsPerStrand + v;
+			XMStoreFloat3(&simData[vert].Position, XMLoadFloat3(&restData[vert].OriginalPosition) + offset);
+			simData[vert].PreviousPosition = simData[vert].Position;
+		}
+	}
+}
+
+void HairSimulator::BindFollowers(const XMFLOAT3* roots, int numOfStrands, int guideRatio, std::vector<int>& guideStrands, std::vector<HairFollower>& followers)
+{
+	guideRatio = std::max(guideRatio, 1);
+	guideStrands.clear();
+	followers.clear();
+	for (int s = 0; s < numOfStrands; s += guideRatio)
+		guideStrands.push_back(s);
+	if (guideRatio == 1)
+		return;
+
+	// Brute force, this only runs when the groom or the ratio changes
+	for (int s = 0; s < numOfStrands; s++)
+	{
+		if (s % guideRatio == 0)
+			continue;
+
+		int nearest[HAIR_FOLLOWER_GUIDES];
+		float nearestDistance[HAIR_FOLLOWER_GUIDES];
+		for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+		{
+			nearest[i] = guideStrands[0];
+			nearestDistance[i] = FLT_MAX;
+		}
+
+		XMVECTOR root = XMLoadFloat3(&roots[s]);
+		for (int guide : guideStrands)
+		{
+			float distance = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&roots[guide]) - root));
+
+			// Insertion into the short sorted list
+			for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+			{
+				if (distance < nearestDistance[i])
+				{
+					for (int j = HAIR_FOLLOWER_GUIDES - 1; j > i; j--)
+					{
+						nearest[j] = nearest[j - 1];
+						nearestDistance[j] = nearestDistance[j - 1];
+					}
+					nearest[i] = guide;
+					nearestDistance[i] = distance;
+					break;
+				}
+			}
+		}
+
+		// Inverse distance weights, missing guides (fewer than HAIR_FOLLOWER_GUIDES in total) get none
+		HairFollower follower = {};
+		follower.Strand = s;
+		float totalWeight = 0;
+		for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+		{
+			follower.Guides[i] = nearest[i];
+			follower.Weights[i] = nearestDistance[i] == FLT_MAX ? 0.0f : 1.0f / (std::sqrt(nearestDistance[i]) + 0.0001f);
+			totalWeight += follower.Weights[i];
+		}
+		for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+			follower.Weights[i] /= totalWeight;
+		followers.push_back(follower);
+	}
+}
+
+void HairSimulator::SimulateStrand(HairSimVertex* strand, const HairRestVertex* rest, int vertsPerStrand,
+	const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physics, const HairSolverFields* fields)
+{
+	SolveStrand(strand, rest, physics, vertsPerStrand, AdjustSettings(settings), forces, deltaTime, fields);
+}
+
+void HairSimulator::BuildPhysicsTable(const unsigned int* strandPhysics, int numOfStrands, int vertsPerStrand, std::vector<unsigned int>& table)
+{
+	table.resize(numOfStrands * vertsPerStrand);
+	for (int s = 0; s < numOfStrands; s++)
+	{
+		HairVertexPhysics physics = HairUnpackPhysics(strandPhysics ? strandPhysics[s] : HAIR_PHYSICS_DEFAULT);
+		for (int v = 0; v < vertsPerStrand; v++)
+		{
+			float alongStrand = v / (float)(vertsPerStrand - 1);
+			table[s * vertsPerStrand + v] = HairPackPhysics(physics.Stiffness, physics.Damping, physics.LengthScale, physics.PinWeight * (1.0f - alongStrand));
+		}
+	}
+}
+
+// Takes the adjusted settings, SimulateGuides() already did that once for every batch
+void HairSimulator::SimulateStrandBatch(HairSimVertex* strands[4], const HairRestVertex* rests[4], const unsigned int* physics[4], int vertsPerStrand,
+	const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const HairSolverFields* fields)
+{
+	StrandLanes positions[HAIR_MAX_VERTS_PER_STRAND];
+	StrandLanes prevPositions[HAIR_MAX_VERTS_PER_STRAND];
+	StrandLanes restPositions[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR segmentLengths[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR bendLengths[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR shapeStiffness[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR bendStiffness[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR lengthScales[HAIR_MAX_VERTS_PER_STRAND];
+	XMVECTOR pinWeights[HAIR_MAX_VERTS_PER_STRAND];
+
+	// The force is the same for every lane, inertia depends on where the vertex sits
+	float dtSquared = deltaTime * deltaTime;
+	XMVECTOR accelX = XMVectorReplicate(forces.Force.x * HAIR_FORCE_ACCELERATION * dtSquared);
+	XMVECTOR accelY = XMVectorReplicate(forces.Force.y * HAIR_FORCE_ACCELERATION * dtSquared);
+	XMVECTOR accelZ = XMVectorReplicate(forces.Force.z * HAIR_FORCE_ACCELERATION * dtSquared);
+	XMFLOAT4X4 inertia;
+	XMStoreFloat4x4(&inertia, XMLoadFloat4x4(&forces.Inertia) * (settings.Inertia * dtSquared));
+	bool windy = fields && fields->Wind && settings.WindDrag > 0 && deltaTime > 0;
+	bool volume = fields && fields->Volume && (settings.VolumePressure > 0 || settings.VolumeFriction > 0);
+
+	HairSimVertex* lanes[HAIR_MAX_VERTS_PER_STRAND][4];
+	for (int i = 0; i < vertsPerStrand; i++)
+	{
+		// Same vertex of four different strands
+		const HairRestVertex* restLanes[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			lanes[i][lane] = &strands[lane][i];
+			restLanes[lane] = &rests[lane][i];
+		}
+
+		// Per vertex physics of each lane, already clamped like the GPU does
+		HairVertexPhysics vertexPhysics[4];
+		for (int lane = 0; lane < 4; lane++)
+			vertexPhysics[lane] = HairUnpackPhysics(physics[lane] ? physics[lane][i] : HAIR_PHYSICS_DEFAULT);
+		XMVECTOR keep = XMVectorSet(
+			1.0f - std::min(settings.Damping * vertexPhysics[0].Damping, 1.0f), 1.0f - std::min(settings.Damping * vertexPhysics[1].Damping, 1.0f),
+			1.0f - std::min(settings.Damping * vertexPhysics[2].Damping, 1.0f), 1.0f - std::min(settings.Damping * vertexPhysics[3].Damping, 1.0f));
+		XMVECTOR stiffness = XMVectorSet(vertexPhysics[0].Stiffness, vertexPhysics[1].Stiffness, vertexPhysics[2].Stiffness, vertexPhysics[3].Stiffness);
+		shapeStiffness[i] = XMVectorMin(stiffness * settings.ShapeStiffness, XMVectorSplatOne());
+		bendStiffness[i] = XMVectorMin(stiffness * settings.BendStiffness, XMVectorSplatOne());
+		lengthScales[i] = XMVectorSet(vertexPhysics[0].LengthScale, vertexPhysics[1].LengthScale, vertexPhysics[2].LengthScale, vertexPhysics[3].LengthScale);
+		pinWeights[i] = XMVectorSet(vertexPhysics[0].PinWeight, vertexPhysics[1].PinWeight, vertexPhysics[2].PinWeight, vertexPhysics[3].PinWeight);
+
+		// The volume and the wind are sampled one lane at a time, every lane looks somewhere else.
+		// The volume goes straight into the strands, they're only read again below
+		if (volume && i > 0)
+		{
+			for (int lane = 0; lane < 4; lane++)
+				fields->Volume->SolveVertex(*lanes[i][lane], settings.VolumePressure, settings.VolumeFriction, deltaTime);
+		}
+		StrandLanes wind = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+		if (windy)
+		{
+			XMMATRIX m;
+			for (int lane = 0; lane < 4; lane++)
+				m.r[lane] = GetWindAcceleration(XMLoadFloat3(&lanes[i][lane]->Position), XMLoadFloat3(&lanes[i][lane]->PreviousPosition), *fields, settings.WindDrag, deltaTime) * dtSquared;
+			m = XMMatrixTranspose(m);
+			wind = { m.r[0], m.r[1], m.r[2] };
+		}
+
+		StrandLanes p = LoadLanes(lanes[i], &HairSimVertex::Position);
+		StrandLanes prev = LoadLanes(lanes[i], &HairSimVertex::PreviousPosition);
+		restPositions[i] = LoadLanes(restLanes, &HairRestVertex::OriginalPosition);
+		const StrandLanes& r = restPositions[i];
+
+		positions[i] = {
+			p.x + (p.x - prev.x) * keep + accelX + wind.x + r.x * inertia._11 + r.y * inertia._21 + r.z * inertia._31 + XMVectorReplicate(inertia._41),
+			p.y + (p.y - prev.y) * keep + accelY + wind.y + r.x * inertia._12 + r.y * inertia._22 + r.z * inertia._32 + XMVectorReplicate(inertia._42),
+			p.z + (p.z - prev.z) * keep + accelZ + wind.z + r.x * inertia._13 + r.y * inertia._23 + r.z * inertia._33 + XMVectorReplicate(inertia._43) };
+		prevPositions[i] = p;
+	}
+
+	// Root pin
+	positions[0] = restPositions[0];
+	prevPositions[0] = restPositions[0];
+
+	// Rest lengths never change during the step
+	for (int k = 0; k < vertsPerStrand - 1; k++)
+	{
+		const StrandLanes& a = restPositions[k];
+		const StrandLanes& b = restPositions[k + 1];
+		segmentLengths[k] = XMVectorSqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y) + (b.z - a.z) * (b.z - a.z)) * lengthScales[k + 1];
+	}
+	for (int k = 0; k < vertsPerStrand - 2; k++)
+	{
+		const StrandLanes& a = restPositions[k];
+		const StrandLanes& b = restPositions[k + 2];
+		bendLengths[k] = XMVectorSqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y) + (b.z - a.z) * (b.z - a.z)) * lengthScales[k + 2];
+	}
+
+	for (int iteration = 0; iteration < settings.Iterations; iteration++)
+	{
+		for (int j = 1; j < vertsPerStrand; j++)
+		{
+			positions[j].x += (restPositions[j].x - positions[j].x) * shapeStiffness[j];
+			positions[j].y += (restPositions[j].y - positions[j].y) * shapeStiffness[j];
+			positions[j].z += (restPositions[j].z - positions[j].z) * shapeStiffness[j];
+		}
+
+		XMVECTOR distanceStiffness = XMVectorReplicate(settings.DistanceStiffness);
+		for (int k = 0; k < vertsPerStrand - 1; k++)
+			SolveDistanceLanes(positions[k], positions[k + 1], segmentLengths[k], k == 0 ? 0.0f : 1.0f, 1.0f, distanceStiffness);
+
+		for (int b = 0; b < vertsPerStrand - 2; b++)
+			SolveDistanceLanes(positions[b], positions[b + 2], bendLengths[b], b == 0 ? 0.0f : 1.0f, 1.0f, bendStiffness[b + 2]);
+
+		for (int p = 1; p < vertsPerStrand; p++)
+		{
+			positions[p].x += (restPositions[p].x - positions[p].x) * pinWeights[p];
+			positions[p].y += (restPositions[p].y - positions[p].y) * pinWeights[p];
+			positions[p].z += (restPositions[p].z - positions[p].z) * pinWeights[p];
+		}
+
+		if (fields && fields->Collision)
+		{
+			for (int c = 1; c < vertsPerStrand; c++)
+				SolveCollisionLanes(positions[c], *fields->Collision, fields->CollisionMargin);
+		}
+	}
+
+	for (int v = 0; v < vertsPerStrand; v++)
+	{
+		StoreLanes(lanes[v], &HairSimVertex::Position, positions[v]);
+		StoreLanes(lanes[v], &HairSimVertex::PreviousPosition, prevPositions[v]);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "HairStrand.h"
+#include "HairShared.h"
+#include "HairPacking.h"
+#include "WindNoise.h"
+
+class HairCollisionField;
+class HairVoxelGrid;
+
+// What the GPU solver samples besides the strands, each one optional like in SimulateHair.hlsl
+struct HairSolverFields
+{
+	// Wind drag (HairSolverSettings::WindDrag) towards the gusts, 0 = no wind.
+	// Sampled in world space and brought back into the hair's with WorldInverse
+	const WindState* Wind;
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverse;
+	// Every vertex but the root is pushed out to CollisionMargin from the surface, last in every iteration
+	const HairCollisionField* Collision;
+	float CollisionMargin;
+	// Hair-hair pressure and friction (HairSolverSettings::VolumePressure and VolumeFriction), before integrating.
+	// Simulate() and HairParallelSimulator splat the guides into it first, SimulateGuides() only samples it
+	HairVoxelGrid* Volume;
+};
+
+// --------------------------------------------------------
+// CPU reference implementation of SimulateHair.hlsl
+//
+// Solves every guide at LOD 0 and never lets a strand sleep.
+// LOD, cluster culling and sleeping are GPU only, so
+// recordings turn all three off.
+//
+// Only depends on DirectXMath so it can run headless
+// (no device, no window) for regression tests and profiling.
+// Strands are laid out exactly like the GPU hair buffers:
+// vertsPerStrand consecutive vertices each, root first, with
+// the hot simulation stream and the cold rest stream side by side.
+// --------------------------------------------------------
+class HairSimulator
+{
+public:
+	// Simulates every strand, four strands at a time in SIMD lanes
+	// physicsData = one HairPackPhysics value per vertex, 0 uses HAIR_PHYSICS_DEFAULT everywhere
+	// fields = 0 leaves out everything HairSolverFields holds
+	static void Simulate(HairSimVertex* simData, const HairRestVertex* restData, int numOfStrands, int vertsPerStrand,
+		const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData = 0, const HairSolverFields* fields = 0);
+
+	// Same, but only for the listed guide strands like the GPU does
+	static void SimulateGuides(HairSimVertex* simData, const HairRestVertex* restData, const int* guideStrands, int numOfGuides, int vertsPerStrand,
+		const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physicsData = 0, const HairSolverFields* fields = 0);
+
+	// Port of InterpolateHair.hlsl, rebuilds the followers from the simulated guides
+	static void InterpolateFollowers(HairSimVertex* simData, const HairRestVertex* restData, const HairFollower* followers, int numOfFollowers, int vertsPerStrand);
+
+	// Every guideRatio'th strand becomes a guide, every other strand follows its nearest guides by root position
+	static void BindFollowers(const DirectX::XMFLOAT3* roots, int numOfStrands, int guideRatio, std::vector<int>& guideStrands, std::vector<HairFollower>& followers);
+
+	// Straight port of SimulateHair() for a single strand, used for the leftover strands
+	static void SimulateStrand(HairSimVertex* strand, const HairRestVertex* rest, int vertsPerStrand,
+		const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const unsigned int* physics = 0, const HairSolverFields* fields = 0);
+
+	// Per vertex physics table from one packed value per strand. Everything but the pin
+	// weight is the same along the strand, the pin weight fades out from root to tip
+	static void BuildPhysicsTable(const unsigned int* strandPhysics, int numOfStrands, int vertsPerStrand, std::vector<unsigned int>& table);
+
+	// Per iteration stiffness so the result doesn't depend on the iteration count
+	static float GetIterationStiffness(float stiffness, int iterations);
+	static HairSolverSettings GetDefaultSettings();
+
+	// How the object space frame moves between two world matrices, per second
+	static DirectX::XMFLOAT4X4 GetFrameVelocity(DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 prevWorld, float deltaTime);
+	// HairExternalForces::Inertia from the last two frame velocities: minus the frame's acceleration,
+	// taken back into object space so it can be applied to the rest positions directly.
+	// prevWorld is the matrix between the two velocities, where the acceleration is centred
+	static DirectX::XMFLOAT4X4 GetInertia(DirectX::XMFLOAT4X4 prevWorld, DirectX::XMFLOAT4X4 velocity, DirectX::XMFLOAT4X4 prevVelocity, float deltaTime);
+	// Bounds the inertia over the hair's bounding sphere and scales it down to HAIR_MAX_INERTIAL_ACCELERATION,
+	// so a teleport is just a hard shove. Returns the bound after clamping
+	static float ClampInertia(DirectX::XMFLOAT4X4& inertia, DirectX::XMFLOAT3 boundsCenter, float boundsRadius);
+
+private:
+	static void SimulateStrandBatch(HairSimVertex* strands[4], const HairRestVertex* rests[4], const unsigned int* physics[4], int vertsPerStrand,
+		const HairSolverSettings& settings, const HairExternalForces& forces, float deltaTime, const HairSolverFields* fields);
+};
@@ -0,0 +1,48 @@
+#include "HairStepScheduler.h"
+
+#include <algorithm>
+
+HairStepScheduler::HairStepScheduler(float fixedStep, int maxSubsteps)
+{
+	SetFixedStep(fixedStep);
+	SetMaxSubsteps(maxSubsteps);
+	Reset();
+}
+
+int HairStepScheduler::Advance(float deltaTime)
+{
+	accumulator += std::max(deltaTime, 0.0f);
+	substeps = std::min((int)(accumulator / fixedStep), maxSubsteps);
+	accumulator -= substeps * fixedStep;
+
+	// Too far behind to catch up, keep less than a step and let the hair lag
+	if (accumulator >= fixedStep)
+	{
+		float keep = accumulator - fixedStep * (int)(accumulator / fixedStep);
+		droppedTime += accumulator - keep;
+		accumulator = keep;
+	}
+	return substeps;
+}
+
+void HairStepScheduler::Reset()
+{
+	accumulator = 0;
+	substeps = 0;
+	droppedTime = 0;
+}
+
+float HairStepScheduler::GetInterpolation()
+{
+	return std::min(accumulator / fixedStep, 1.0f);
+}
+
+void HairStepScheduler::SetFixedStep(float step)
+{
+	fixedStep = std::max(step, 0.0001f);
+}
+
+void HairStepScheduler::SetMaxSubsteps(int substeps)
+{
+	maxSubsteps = std::max(substeps, 1);
+}
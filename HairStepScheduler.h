@@ -0,0 +1,39 @@
+#pragma once
+
+#include "HairShared.h"
+
+// --------------------------------------------------------
+// Fixed timestep accumulator for the hair simulation
+//
+// Frame time goes in, a whole number of fixed steps comes out.
+// Whatever is left over is how far the drawn hair should be
+// interpolated between the last two simulated states.
+// --------------------------------------------------------
+class HairStepScheduler
+{
+public:
+	HairStepScheduler(float fixedStep = HAIR_FIXED_TIMESTEP, int maxSubsteps = HAIR_MAX_SUBSTEPS);
+
+	// Adds the frame's time and returns how many fixed steps to simulate now
+	int Advance(float deltaTime);
+	void Reset();
+
+	// 0 = draw the previous state, 1 = draw the newest one
+	float GetInterpolation();
+
+	void SetFixedStep(float step);
+	void SetMaxSubsteps(int substeps);
+	float GetFixedStep() { return fixedStep; }
+	int GetMaxSubsteps() { return maxSubsteps; }
+
+	// What the last Advance() did, and the simulation time thrown away so far
+	int GetSubsteps() { return substeps; }
+	float GetDroppedTime() { return droppedTime; }
+
+private:
+	float fixedStep;
+	int maxSubsteps;
+	float accumulator;
+	int substeps;
+	float droppedTime;
+};
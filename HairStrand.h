@@ -1,19 +1,76 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include "HairShared.h"
 
 // --------------------------------------------------------
-// A custom vertex definition
+// Hair vertex data, split by how often it's touched
 //
-// You will eventually ADD TO this, and/or make more of these!
+// Must match HairGenerics.hlsli member for member!
 // --------------------------------------------------------
-struct HairStrand
+
+// Hot stream: read and written by every simulation step.
+// The hair state ring holds it packed (see HairPacking.h)
+struct HairSimVertex
 {
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
+	DirectX::XMFLOAT3 PreviousPosition;	// Verlet integration
+};
+
+// Cold stream: written once by CreateHair, after that only moved along
+// with a deforming surface (see Mesh::UpdateHairSurface).
+// The simulation only reads OriginalPosition, the rest is for drawing
+struct HairRestVertex
+{
+	DirectX::XMFLOAT3 OriginalPosition;
 	DirectX::XMFLOAT3 Normal;		// Lighting
 	DirectX::XMFLOAT3 Tangent;	// Lighting
-	DirectX::XMFLOAT3 Acceleration;	// Simulating physics
-	DirectX::XMFLOAT3 Speed;	// Simulating physics
 	DirectX::XMFLOAT2 UV;			// Texture mapping
-	DirectX::XMFLOAT3 OriginalPosition;
-};
\ No newline at end of file
+};
+
+// Tuning for the position based dynamics solver.
+// Stiffnesses are 0-1 and independent of the iteration count
+struct HairSolverSettings
+{
+	int Iterations;
+	float Damping;
+	float DistanceStiffness;	// Keeps segment lengths
+	float BendStiffness;		// Keeps the angle between neighbouring segments
+	float ShapeStiffness;		// Pulls the strand back to its groomed shape
+	float Inertia;				// Scales HairExternalForces::Inertia, 0 = the hair ignores how the entity moves
+	float WindDrag;				// Towards the wind field's velocity, the CPU solver samples it through HairSolverFields
+	float VolumePressure;		// Pushes vertices out of crowded voxels, 0 = strands pass through each other
+	float VolumeFriction;		// Drags vertices towards their voxel's velocity
+};
+
+// Everything pushing on the hair for one step, in the hair's object space
+struct HairExternalForces
+{
+	DirectX::XMFLOAT3 Force;			// Uniform, times HAIR_FORCE_ACCELERATION
+	// Pseudo acceleration from the entity accelerating and turning, rest position (w = 1) times this.
+	// Row vectors like the world matrix, all zero for an entity that isn't accelerating
+	DirectX::XMFLOAT4X4 Inertia;
+};
+
+// A strand that isn't simulated, rebuilt every step from the
+// guides around it by moving it as much as they moved
+struct HairFollower
+{
+	int Strand;
+	int Guides[HAIR_FOLLOWER_GUIDES];	// Strand indices of the guides
+	float Weights[HAIR_FOLLOWER_GUIDES];	// Sum to one
+};
+
+// Where a root sits on the mesh it grows from
+struct HairRootBinding
+{
+	int Triangle;						// First index is Triangle * 3
+	DirectX::XMFLOAT3 Barycentrics;
+};
+
+// Per strand values kept in a baked groom (see HairGroomCache)
+struct HairStrandParams
+{
+	float Length;		// Root to tip along the rest pose
+	float Width;		// At the root
+};
@@ -0,0 +1,89 @@
+#include "HairTextureReadback.h"
+
+HairUVMap HairTextureReadback::ReadUVMap(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture)
+{
+	HairUVMap map;
+	if (!texture)
+		return map;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	texture->GetResource(resource.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> source;
+	if (FAILED(resource.As(&source)))
+		return map;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	source->GetDesc(&desc);
+
+	bool swapRedBlue = false;
+	int pixelSize = 4;
+	switch (desc.Format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		swapRedBlue = true;
+		break;
+	case DXGI_FORMAT_R8_UNORM:
+		pixelSize = 1;
+		break;
+	default:
+		return map;
+	}
+
+	// Copy just the top mip somewhere the CPU can read it
+	D3D11_TEXTURE2D_DESC stagingDesc = desc;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+	if (FAILED(device->CreateTexture2D(&stagingDesc, 0, staging.GetAddressOf())))
+		return map;
+	context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, source.Get(), 0, 0);
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		return map;
+
+	map.Width = desc.Width;
+	map.Height = desc.Height;
+	map.Texels.resize(desc.Width * desc.Height);
+	for (UINT y = 0; y < desc.Height; y++)
+	{
+		const unsigned char* row = (const unsigned char*)mapped.pData + y * mapped.RowPitch;
+		for (UINT x = 0; x < desc.Width; x++)
+		{
+			const unsigned char* pixel = row + x * pixelSize;
+			unsigned int texel;
+			if (pixelSize == 1)
+				texel = pixel[0] | (pixel[0] << 8) | (pixel[0] << 16) | 0xFF000000;
+			else if (swapRedBlue)
+				texel = pixel[2] | (pixel[1] << 8) | (pixel[0] << 16) | (pixel[3] << 24);
+			else
+				texel = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (pixel[3] << 24);
+			map.Texels[y * desc.Width + x] = texel;
+		}
+	}
+	context->Unmap(staging.Get(), 0);
+	return map;
+}
+
+HairDensityMask HairTextureReadback::ReadDensityMask(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture)
+{
+	HairUVMap map = ReadUVMap(device, context, texture);
+
+	HairDensityMask mask;
+	mask.Width = map.Width;
+	mask.Height = map.Height;
+	mask.Values.resize(map.Texels.size());
+	for (size_t i = 0; i < map.Texels.size(); i++)
+		mask.Values[i] = (map.Texels[i] & 0xFF) / 255.0f;
+	return mask;
+}
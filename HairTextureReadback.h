@@ -0,0 +1,25 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "HairRootSampler.h"
+
+// --------------------------------------------------------
+// Turns textures into the CPU side maps HairRootSampler and
+// the physics table read
+//
+// The only part of root placement that needs a device, kept
+// apart so the sampler itself builds without Direct3D.
+// --------------------------------------------------------
+class HairTextureReadback
+{
+public:
+	// Reads the top mip of a texture back to the CPU, 8 bit RGBA/BGRA/R formats only (R is greyscale)
+	static HairUVMap ReadUVMap(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture);
+
+	// The red channel of ReadUVMap
+	static HairDensityMask ReadDensityMask(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture);
+};
@@ -6,6 +6,14 @@ cbuffer externalData : register(b0)
 	matrix worldInverseTranspose;
 	matrix view;
 	matrix projection;
+	float3 cameraPosition;
+	float hairWidth;		// Already scaled up for the strands this LOD skips
+	int vertsPerStrand;
+	int lodSegments;
+	float stateInterpolation;	// From PrevHairData (0) to HairData (1), see HairStepScheduler
+	float stateScale;		// See HairPacking.h
+	int guideStep;			// Draws every guideStep'th entry of guideStrands, 0 = every strand
+	int tessellation;		// Drawn pieces per LOD segment
 };
 // Out of the vertex shader (and eventually input to the PS)
 struct VertexToPixel
@@ -14,34 +22,90 @@ struct VertexToPixel
 	float2 uv				: TEXCOORD;
 	float3 normal			: NORMAL;
 	float3 tangent			: TANGENT;
+	float3 strandDirection	: STRAND;	// Along the strand towards the tip, what the hair is shaded by
 	float3 worldPos			: POSITION; // The world position of this vertex
 	float4 prevScreenPos	: SCREEN_POS0;// The world position of this vertex last frame
 	float4 currentScreenPos	: SCREEN_POS1;
 };
 
-StructuredBuffer<HairStrand> HairData	:	register(t0);
+StructuredBuffer<HairPackedVertex> HairData	:	register(t0);
+StructuredBuffer<HairRestVertex> HairRestData	:	register(t1);
+StructuredBuffer<HairPackedVertex> PrevHairData	:	register(t2);
+StructuredBuffer<int> guideStrands	:	register(t3);
 
+// Between the last two simulation steps, so the hair moves smoothly at any frame rate
+float3 LoadPosition(uint index, float3 root)
+{
+	float3 prevPosition = HairUnpackVertex(PrevHairData.Load(index), root, stateScale).Position;
+	return lerp(prevPosition, HairUnpackVertex(HairData.Load(index), root, stateScale).Position, stateInterpolation);
+}
+
+// Two ribbon vertices per point along a Catmull-Rom curve through the simulated vertices.
+// No index buffer, the corner comes straight out of the vertex ID (see HairRibbon.h)
 VertexToPixel main(uint id : SV_VertexID)
 {
 	// Set up output
 	VertexToPixel output;
-	HairStrand input = HairData.Load(id);
-	//input.Position = input.Position - float3(0, -2.5f, -5.0f);
+	HairRibbonCorner ribbon = HairExpandRibbon(id, lodSegments * tessellation);
+	uint strand = guideStep > 0 ? guideStrands[ribbon.Strand * guideStep] : ribbon.Strand;
+	uint first = strand * vertsPerStrand;
+	float side = (float)ribbon.Side;
+
+	// The LOD segment this point is on and the LOD vertices either side of it
+	int segment = HairRibbonSegment(ribbon.Vertex, lodSegments, tessellation);
+	float t = HairRibbonSegmentT(ribbon.Vertex, segment, tessellation);
+	uint v0 = first + LODVertex(max(segment - 1, 0), lodSegments, vertsPerStrand);
+	uint v1 = first + LODVertex(segment, lodSegments, vertsPerStrand);
+	uint v2 = first + LODVertex(segment + 1, lodSegments, vertsPerStrand);
+	uint v3 = first + LODVertex(min(segment + 2, lodSegments), lodSegments, vertsPerStrand);
+
+	float3 root = HairRestData.Load(first).OriginalPosition;
+	float3 p0 = LoadPosition(v0, root);
+	float3 p1 = LoadPosition(v1, root);
+	float3 p2 = LoadPosition(v2, root);
+	float3 p3 = LoadPosition(v3, root);
+
+	// Past the root and tip the strand carries straight on, so the ends don't bunch up
+	if (segment == 0)
+		p0 = 2.0f * p1 - p2;
+	if (segment == lodSegments - 1)
+		p3 = 2.0f * p2 - p1;
+	float4 weights = HairCatmullRomWeights(t);
+	float4 tangentWeights = HairCatmullRomTangentWeights(t);
+	float3 position = p0 * weights.x + p1 * weights.y + p2 * weights.z + p3 * weights.w;
+	float3 direction = p0 * tangentWeights.x + p1 * tangentWeights.y + p2 * tangentWeights.z + p3 * tangentWeights.w;
+
+	// Lighting and the taper are blended between the two rest vertices
+	HairRestVertex rest1 = HairRestData.Load(v1);
+	HairRestVertex rest2 = HairRestData.Load(v2);
+	float3 normal = lerp(rest1.Normal, rest2.Normal, t);
+	float3 tangent = lerp(rest1.Tangent, rest2.Tangent, t);
+	float alongStrand = lerp(rest1.UV.y, rest2.UV.y, t);
+
+	float3 worldPos = mul(world, float4(position, 1.0f)).xyz;
+	float3 strandDir = mul((float3x3)world, direction);
+	float3 toCamera = cameraPosition - worldPos;
+
+	// Face the camera, tapering to nothing at the tip
+	float3 sideDir = normalize(cross(strandDir, toCamera));
+	worldPos += sideDir * (side - 0.5f) * hairWidth * (1.0f - alongStrand);
+
 	// Calculate output position
-	matrix worldViewProj = mul(projection, mul(view, world));
-	output.screenPosition = mul(worldViewProj, float4(input.Position, 1.0f));
+	matrix viewProj = mul(projection, view);
+	output.screenPosition = mul(viewProj, float4(worldPos, 1.0f));
 	output.currentScreenPos = output.screenPosition;
 
 	// Calculate the world position of this vertex (to be used
 	// in the pixel shader when we do point/spot lights)
-	output.worldPos = mul(world, float4(input.Position, 1.0f)).xyz;
+	output.worldPos = worldPos;
 
 	// Make sure the other vectors are in WORLD space, not "local" space
-	output.normal = normalize(mul((float3x3)worldInverseTranspose, input.Normal));
-	output.tangent = normalize(mul((float3x3)world, input.Tangent)); // Tangent doesn't need inverse transpose!
+	output.normal = normalize(mul((float3x3)worldInverseTranspose, normal));
+	output.tangent = normalize(mul((float3x3)world, tangent)); // Tangent doesn't need inverse transpose!
+	output.strandDirection = normalize(strandDir);
 
 	// Pass the UV through
-	output.uv = input.UV;
+	output.uv = float2(side, alongStrand);
 
 	return output;
-}
\ No newline at end of file
+}
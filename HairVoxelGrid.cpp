@@ -0,0 +1,146 @@
+#include "HairVoxelGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+HairVoxelGrid::HairVoxelGrid(int resolution)
+{
+	this->resolution = std::max(resolution, 2);
+	cells.resize(this->resolution * this->resolution * this->resolution, XMFLOAT4(0, 0, 0, 0));
+	SetBounds(XMFLOAT3(0, 0, 0), 1.0f);
+}
+
+void HairVoxelGrid::SetBounds(XMFLOAT3 center, float radius)
+{
+	boundsMin = XMFLOAT3(center.x - radius, center.y - radius, center.z - radius);
+	cellSize = radius * 2.0f / resolution;
+}
+
+void HairVoxelGrid::Splat(const HairSimVertex* simData, const int* guideStrands, int numOfGuides, int vertsPerStrand, float deltaTime)
+{
+	std::fill(cells.begin(), cells.end(), XMFLOAT4(0, 0, 0, 0));
+	float invDelta = deltaTime > 0 ? 1.0f / deltaTime : 0.0f;
+
+	for (int g = 0; g < numOfGuides; g++)
+	{
+		const HairSimVertex* strand = simData + guideStrands[g] * vertsPerStrand;
+		for (int v = 0; v < vertsPerStrand; v++)
+		{
+			XMFLOAT3 position = strand[v].Position;
+			XMFLOAT3 velocity(
+				(position.x - strand[v].PreviousPosition.x) * invDelta,
+				(position.y - strand[v].PreviousPosition.y) * invDelta,
+				(position.z - strand[v].PreviousPosition.z) * invDelta);
+
+			// Into the 8 cells around it, cell centres are at +0.5
+			float gx = (position.x - boundsMin.x) / cellSize - 0.5f;
+			float gy = (position.y - boundsMin.y) / cellSize - 0.5f;
+			float gz = (position.z - boundsMin.z) / cellSize - 0.5f;
+			int ix = (int)std::floor(gx);
+			int iy = (int)std::floor(gy);
+			int iz = (int)std::floor(gz);
+			float fx = gx - ix;
+			float fy = gy - iy;
+			float fz = gz - iz;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				int cx = ix + (corner & 1);
+				int cy = iy + ((corner >> 1) & 1);
+				int cz = iz + ((corner >> 2) & 1);
+				if (cx < 0 || cy < 0 || cz < 0 || cx >= resolution || cy >= resolution || cz >= resolution)
+					continue;
+
+				float weight = ((corner & 1) ? fx : 1.0f - fx) * (((corner >> 1) & 1) ? fy : 1.0f - fy) * (((corner >> 2) & 1) ? fz : 1.0f - fz);
+				XMFLOAT4& cell = cells[(cz * resolution + cy) * resolution + cx];
+				cell.x += weight;
+				cell.y += velocity.x * weight;
+				cell.z += velocity.y * weight;
+				cell.w += velocity.z * weight;
+			}
+		}
+	}
+
+	// Momentum to average velocity, like ResolveHairVoxels
+	for (XMFLOAT4& cell : cells)
+	{
+		if (cell.x <= 0)
+			continue;
+		cell.y /= cell.x;
+		cell.z /= cell.x;
+		cell.w /= cell.x;
+	}
+}
+
+void HairVoxelGrid::Apply(HairSimVertex* simData, const int* guideStrands, int numOfGuides, int vertsPerStrand, const HairSolverSettings& settings, float deltaTime) const
+{
+	if (settings.VolumePressure <= 0 && settings.VolumeFriction <= 0)
+		return;
+
+	// The root is pinned, so it's left alone
+	for (int g = 0; g < numOfGuides; g++)
+	{
+		HairSimVertex* strand = simData + guideStrands[g] * vertsPerStrand;
+		for (int v = 1; v < vertsPerStrand; v++)
+			SolveVertex(strand[v], settings.VolumePressure, settings.VolumeFriction, deltaTime);
+	}
+}
+
+XMFLOAT4 HairVoxelGrid::Sample(XMFLOAT3 position) const
+{
+	float gx = (position.x - boundsMin.x) / cellSize - 0.5f;
+	float gy = (position.y - boundsMin.y) / cellSize - 0.5f;
+	float gz = (position.z - boundsMin.z) / cellSize - 0.5f;
+	int ix = (int)std::floor(gx);
+	int iy = (int)std::floor(gy);
+	int iz = (int)std::floor(gz);
+	float fx = gx - ix;
+	float fy = gy - iy;
+	float fz = gz - iz;
+
+	XMVECTOR result = XMVectorZero();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		int cx = std::min(std::max(ix + (corner & 1), 0), resolution - 1);
+		int cy = std::min(std::max(iy + ((corner >> 1) & 1), 0), resolution - 1);
+		int cz = std::min(std::max(iz + ((corner >> 2) & 1), 0), resolution - 1);
+		float weight = ((corner & 1) ? fx : 1.0f - fx) * (((corner >> 1) & 1) ? fy : 1.0f - fy) * (((corner >> 2) & 1) ? fz : 1.0f - fz);
+		result += XMLoadFloat4(&cells[(cz * resolution + cy) * resolution + cx]) * weight;
+	}
+
+	XMFLOAT4 sample;
+	XMStoreFloat4(&sample, result);
+	return sample;
+}
+
+void HairVoxelGrid::SolveVertex(HairSimVertex& vertex, float pressure, float friction, float deltaTime) const
+{
+	XMFLOAT4 cell = Sample(vertex.Position);
+	if (cell.x <= 0)
+		return;
+
+	XMVECTOR position = XMLoadFloat3(&vertex.Position);
+	XMVECTOR prevPosition = XMLoadFloat3(&vertex.PreviousPosition);
+
+	// Friction: part of the way towards how the hair around it is moving
+	if (deltaTime > 0)
+	{
+		XMVECTOR velocity = (position - prevPosition) / deltaTime;
+		velocity += (XMVectorSet(cell.y, cell.z, cell.w, 0) - velocity) * friction;
+		prevPosition = position - velocity * deltaTime;
+	}
+
+	// Pressure: down the density gradient, relative to how crowded it already is.
+	// Both positions move so the push doesn't turn into velocity
+	XMFLOAT3 p = vertex.Position;
+	XMVECTOR gradient = XMVectorSet(
+		Sample(XMFLOAT3(p.x + cellSize, p.y, p.z)).x - Sample(XMFLOAT3(p.x - cellSize, p.y, p.z)).x,
+		Sample(XMFLOAT3(p.x, p.y + cellSize, p.z)).x - Sample(XMFLOAT3(p.x, p.y - cellSize, p.z)).x,
+		Sample(XMFLOAT3(p.x, p.y, p.z + cellSize)).x - Sample(XMFLOAT3(p.x, p.y, p.z - cellSize)).x,
+		0) * 0.5f;
+	XMVECTOR push = XMVector3ClampLength(-gradient * (pressure * cellSize / std::max(cell.x, 1.0f)), 0.0f, cellSize * 0.5f);
+
+	XMStoreFloat3(&vertex.Position, position + push);
+	XMStoreFloat3(&vertex.PreviousPosition, prevPosition + push);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "HairStrand.h"
+#include "HairShared.h"
+
+// --------------------------------------------------------
+// Density and velocity of the hair on a grid, for hair-hair
+// interaction without any pairwise tests
+//
+// CPU reference of SplatHairVoxels.hlsl, ResolveHairVoxels.hlsl
+// and SolveVolume() in HairPhysicsHelper.hlsli. Cells are
+// resolution^3 over a cube in the hair's object space, sampled
+// at their centres like the GPU's 3D texture. Every vertex is
+// O(1): splatted into 8 cells, corrected from 7 samples.
+// --------------------------------------------------------
+class HairVoxelGrid
+{
+public:
+	HairVoxelGrid(int resolution = HAIR_VOXEL_RESOLUTION);
+
+	// The cube the grid covers, anything outside reads as the nearest edge cell
+	void SetBounds(DirectX::XMFLOAT3 center, float radius);
+
+	// Clears the grid and adds every vertex of the listed strands, velocities from the Verlet state
+	void Splat(const HairSimVertex* simData, const int* guideStrands, int numOfGuides, int vertsPerStrand, float deltaTime);
+
+	// Friction and pressure for every vertex but the root, run before the solver step like the GPU does
+	void Apply(HairSimVertex* simData, const int* guideStrands, int numOfGuides, int vertsPerStrand, const HairSolverSettings& settings, float deltaTime) const;
+	// The same for a single vertex, what HairSimulator calls while integrating
+	void SolveVertex(HairSimVertex& vertex, float pressure, float friction, float deltaTime) const;
+
+	// x = density, yzw = average velocity. Trilinear, clamped like the GPU sampler
+	DirectX::XMFLOAT4 Sample(DirectX::XMFLOAT3 position) const;
+
+	int GetResolution() const { return resolution; }
+	DirectX::XMFLOAT3 GetBoundsMin() const { return boundsMin; }
+	float GetCellSize() const { return cellSize; }
+
+private:
+	int resolution;
+	DirectX::XMFLOAT3 boundsMin;
+	float cellSize;
+	std::vector<DirectX::XMFLOAT4> cells;	// x fastest, then y, then z
+};
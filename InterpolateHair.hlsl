@@ -0,0 +1,39 @@
+#include "HairGenerics.hlsli"
+
+cbuffer HAIR_INTERPOLATE_CONSTANT	: register(b0)
+{
+	int numOfFollowers;
+	int vertsPerStrand;
+	float stateScale;		// See HairPacking.h
+}
+
+StructuredBuffer<HairFollower> followers	: register(t0);
+StructuredBuffer<HairRestVertex> restData	: register(t1);
+// Guides were just simulated into this slot, only follower strands get written
+RWStructuredBuffer<HairPackedVertex> hairData	: register(u0);
+
+// One thread per follower vertex, moved by the weighted offset of its guides from their rest pose
+[numthreads(64, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	int index = DTid.x;
+	int followerID = index / vertsPerStrand;
+	if (followerID >= numOfFollowers)
+		return;
+	int segmentID = index % vertsPerStrand;
+
+	HairFollower follower = followers[followerID];
+	float3 offset = float3(0, 0, 0);
+	for (int i = 0; i < HAIR_FOLLOWER_GUIDES; i++)
+	{
+		int guideRoot = follower.Guides[i] * vertsPerStrand;
+		int guideVert = guideRoot + segmentID;
+		float3 guidePosition = HairUnpackVertex(hairData[guideVert], restData[guideRoot].OriginalPosition, stateScale).Position;
+		offset += (guidePosition - restData[guideVert].OriginalPosition) * follower.Weights[i];
+	}
+
+	int root = follower.Strand * vertsPerStrand;
+	int vert = root + segmentID;
+	float3 position = restData[vert].OriginalPosition + offset;
+	hairData[vert] = HairPackVertex(position, position, restData[root].OriginalPosition, stateScale);
+}
@@ -1,14 +1,24 @@
 #include "Mesh.h"
 #include "Assets.h"
 #include "HairStrand.h"
+#include "HairShared.h"
 #include "ShaderVertex.h"
+#include "HairSimulator.h"
+#include "ObjLoader.h"
+#include "HairHash.h"
+#include "HairTextureReadback.h"
 #include <memory>
 #include <DirectXMath.h>
 #include <vector>
 #include <fstream>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 
 using namespace DirectX;
 
+unsigned int Mesh::hairBufferAllocations = 0;
+
 Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
 {
 	numOfVerts = numVerts;
@@ -16,175 +26,20 @@ Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numInd
 	hasFur = false;
 }
 
-Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur) : Mesh(vertArray, numVerts, indexArray, numIndices, device)
+Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur, int hairSegments, int hairGuideRatio, float hairDensity) : Mesh(vertArray, numVerts, indexArray, numIndices, device)
 {
 	if (hasFur)
-		CreateHairBuffers(vertArray, numVerts, device);
+		CreateHairBuffers(vertArray, numVerts, indexArray, numIndices, hairSegments, hairGuideRatio, hairDensity, device);
 	this->hasFur = hasFur;
 }
 
-Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur)
+Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur, int hairSegments, int hairGuideRatio, float hairDensity)
 {
-	// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
-		return;
-
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
 	std::vector<Vertex> verts;           // Verts we're assembling
 	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			//  If the model is missing any of these, this 
-			//  code will not handle the file correctly!
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-			}
-		}
-	}
-
-	// Close the file and create the actual buffers
-	obj.close();
-
+	if (!ObjLoader::Load(objFile, verts, indices))
+		return;
+	unsigned int vertCounter = (unsigned int)verts.size();
 
 	// - At this point, "verts" is a vector of Vertex structs, and can be used
 	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
@@ -202,7 +57,15 @@ Mesh::Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, boo
 	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
 
 	if (hasFur)
-		CreateHairBuffers(&verts[0], vertCounter, device);
+	{
+		// The baked groom, collision field and recordings sit next to the model
+		std::string basePath = objFile;
+		basePath = basePath.substr(0, basePath.find_last_of('.'));
+		hairGroomPath = basePath + ".groom";
+		hairCollisionPath = basePath + ".sdf";
+		hairRecordingPath = basePath + ".hrec";
+		CreateHairBuffers(&verts[0], vertCounter, &indices[0], vertCounter, hairSegments, hairGuideRatio, hairDensity, device);
+	}
 	this->hasFur = hasFur;
 }
 
@@ -213,25 +76,61 @@ Mesh::~Mesh(void)
 }
 
 
-void Mesh::SetBuffersAndDrawHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalMap)
+void Mesh::SetBuffersAndDrawHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalMap)
 {
+	hair.Update(context, *this);
+
 	// Set buffers in the input assembler
 	UINT stride = 0;
 	UINT offset = 0;
 	ID3D11Buffer* nullBuffer = 0;
 	context->IASetVertexBuffers(0, 1, &nullBuffer, &stride, &offset);
-	context->IASetIndexBuffer(hairIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+	const HairLODLevel& lod = hairLODs[hair.GetLOD()];
+
+	// Draw whichever slot is the instance's frame latency steps behind the newest one
+	int slotCount = hair.GetStateSlotCount();
+	int drawSlot = (hair.GetCurrentSlot() - hair.GetFrameLatency() + slotCount) % slotCount;
 
 	std::shared_ptr<SimpleVertexShader> vs = Assets::GetInstance().GetVertexShader("HairVS");
 	vs->SetShader();
-	vs->SetShaderResourceView("HairData", hairSRV);
+	vs->SetShaderResourceView("HairData", hair.GetStateSlot(drawSlot).srv);
+	vs->SetShaderResourceView("HairRestData", hairRestSRV);
+	vs->SetShaderResourceView("guideStrands", hairGuideSRV);
+
+	// Blend in from the step before by however much of a step hasn't been simulated yet.
+	// Needs a slot beyond the latency, otherwise the one before is the one being written next
+	if (hair.GetFrameLatency() + 2 <= slotCount)
+	{
+		vs->SetShaderResourceView("PrevHairData", hair.GetStateSlot((drawSlot - 1 + slotCount) % slotCount).srv);
+		vs->SetFloat("stateInterpolation", hair.GetStepScheduler().GetInterpolation());
+	}
+	else
+	{
+		vs->SetShaderResourceView("PrevHairData", hair.GetStateSlot(drawSlot).srv);
+		vs->SetFloat("stateInterpolation", 1.0f);
+	}
+	vs->SetFloat("hairWidth", hairWidth * lod.widthScale);
+	vs->SetFloat("stateScale", GetHairStateScale());
+	vs->SetInt("vertsPerStrand", vertsPerStrand);
+	vs->SetInt("lodSegments", lod.segments);
+	vs->SetInt("guideStep", lod.drawStep);
+	int tessellation = GetHairTessellation(hair);
+	vs->SetInt("tessellation", tessellation);
 	vs->CopyAllBufferData();
 
 	std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader("HairPS");
 	ps->SetShaderResourceView("NormalMap", normalMap);
 
-	// Draw this mesh's hair
-	context->DrawIndexed(this->numOfVerts * 5, 0, 0);
+	// Draw this mesh's hair, two triangles per piece of each strand segment.
+	// One draw per run of visible clusters, SV_VertexID carries on from the start vertex
+	int verticesPerStrand = lod.segments * tessellation * HAIR_RIBBON_VERTICES_PER_SEGMENT;
+	for (const HairStrandRun& run : hair.GetVisibleRuns(hairGuideStrands, lod.drawStep))
+		context->Draw(run.Count * verticesPerStrand, run.First * verticesPerStrand);
+
+	// Let go of the slots so the simulation can write to them again
+	vs->SetShaderResourceView("HairData", 0);
+	vs->SetShaderResourceView("PrevHairData", 0);
 }
 
 void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device)
@@ -360,142 +259,893 @@ void Mesh::SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context
 	context->DrawIndexed(this->numIndices, 0, 0);
 }
 
-void Mesh::SimulateHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11Device> device, float deltaTime, XMFLOAT3 force)
+void Mesh::SimulateHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, float deltaTime, XMFLOAT3 force, XMFLOAT4X4 world, XMFLOAT4X4 prevWorld, std::shared_ptr<WindField> wind)
 {
+	hair.Update(context, *this);
+	hair.BeginFrame(context, *this);
+	if (hairRootsDirty)
+		UpdateHairRoots(context);
+
+	// A replay throws away what it was given, a recording keeps it. Both use the frame
+	// before's matrix and no wind, so the file alone is enough to get back here
+	if (hair.RecordFrame(context, deltaTime, force, world, prevWorld))
+		wind = 0;
+	HairExternalForces forces = hair.UpdateForces(*this, deltaTime, force, world, prevWorld, GetHairSolverSettings(hair).Inertia);
+
+	// Same forces for every substep, they only change once a frame
+	int steps = hair.GetStepScheduler().Advance(deltaTime);
+	for (int i = 0; i < steps; i++)
+		StepHair(context, hair, hair.GetStepScheduler().GetFixedStep(), forces, world, wind);
+	hair.EndFrame(context, *this, steps);
+}
+
+bool Mesh::StartHairRecording(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair)
+{
+	hair.StopReplay();
+	if (!hasFur || hair.GetRecordingPath().empty())
+		return false;
+	hair.Update(context, *this);
+
+	int count = numOfStrands * vertsPerStrand;
+	std::vector<HairRestVertex> rest(count);
+	if (!ReadBackHairBuffer(device, context, hairRestBuffer.Get(), rest.data()))
+		return false;
+	std::vector<XMFLOAT3> restPositions(count);
+	for (int i = 0; i < count; i++)
+		restPositions[i] = rest[i].OriginalPosition;
+	return hair.StartRecording(context, *this, restPositions);
+}
+
+bool Mesh::StartHairReplay(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair)
+{
+	return hasFur && hair.StartReplay(device, context, *this);
+}
+
+void Mesh::StepHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, float deltaTime, const HairExternalForces& forces, XMFLOAT4X4 world, std::shared_ptr<WindField> wind)
+{
+	// Inertia too small to move anything past the sleep distance lets the hair rest
+	bool moved = hair.GetInertialAcceleration() * deltaTime * deltaTime >= HAIR_SLEEP_DISTANCE;
+	bool pushed = forces.Force.x != 0 || forces.Force.y != 0 || forces.Force.z != 0;
+	const HairSolverSettings& settings = GetHairSolverSettings(hair);
+	bool windy = wind && settings.WindDrag > 0;
+	bool wake = false;
+	if (!hair.BeginStep(pushed || moved || windy, wake))
+		return;
+
+	const HairLODLevel& lod = hairLODs[hair.GetLOD()];
+	bool volume = settings.VolumePressure > 0 || settings.VolumeFriction > 0;
+	if (volume)
+		SplatHairVoxels(hair.GetStateSlot(hair.GetCurrentSlot()).srv, lod, deltaTime);
+
 	std::shared_ptr<SimpleComputeShader> simulateCS = Assets::GetInstance().GetComputeShader("SimulateHair");
 	simulateCS->SetShader();
 	simulateCS->SetFloat("deltaTime", deltaTime);
-	simulateCS->SetFloat3("force", force);
-	simulateCS->SetUnorderedAccessView("hairData", hairUAV, 0);
+	simulateCS->SetFloat("stateScale", GetHairStateScale());
+	simulateCS->SetFloat3("force", forces.Force);
+	simulateCS->SetMatrix4x4("inertia", forces.Inertia);
+	XMFLOAT4X4 worldInverse;
+	XMStoreFloat4x4(&worldInverse, XMMatrixInverse(0, XMLoadFloat4x4(&world)));
+	simulateCS->SetMatrix4x4("world", world);
+	simulateCS->SetMatrix4x4("worldInverse", worldInverse);
+	simulateCS->SetFloat("windDrag", windy ? settings.WindDrag : 0.0f);
+	simulateCS->SetInt("useCollision", GetHairCollision(hair) ? 1 : 0);
+	simulateCS->SetFloat3("collisionMin", hairCollisionField.GetBoundsMin());
+	simulateCS->SetFloat("collisionSize", hairCollisionField.GetCellSize() * hairCollisionResolution);
+	simulateCS->SetFloat("collisionMargin", HAIR_COLLISION_MARGIN);
+	simulateCS->SetShaderResourceView("collisionField", hairCollisionSRV);
+	simulateCS->SetFloat3("voxelMin", XMFLOAT3(hairBoundsCenter.x - hairBoundsRadius, hairBoundsCenter.y - hairBoundsRadius, hairBoundsCenter.z - hairBoundsRadius));
+	simulateCS->SetFloat("voxelCellSize", hairBoundsRadius * 2.0f / HAIR_VOXEL_RESOLUTION);
+	simulateCS->SetFloat("volumePressure", volume ? settings.VolumePressure : 0.0f);
+	simulateCS->SetFloat("volumeFriction", volume ? settings.VolumeFriction : 0.0f);
+	simulateCS->SetShaderResourceView("voxelField", hairVoxelFieldSRV);
+	simulateCS->SetSamplerState("clampSampler", hairClampSampler);
+	if (windy)
+		wind->SetShaderWind(simulateCS.get());
+	simulateCS->SetInt("numOfGuides", lod.simulatedStrands);
+	simulateCS->SetInt("guideStep", lod.guideStep);
+	simulateCS->SetInt("vertsPerStrand", vertsPerStrand);
+	simulateCS->SetInt("lodSegments", lod.segments);
+	simulateCS->SetInt("iterations", settings.Iterations);
+	simulateCS->SetFloat("damping", settings.Damping);
+	simulateCS->SetFloat("distanceStiffness", HairSimulator::GetIterationStiffness(settings.DistanceStiffness, settings.Iterations));
+	simulateCS->SetFloat("bendStiffness", HairSimulator::GetIterationStiffness(settings.BendStiffness, settings.Iterations));
+	simulateCS->SetFloat("shapeStiffness", HairSimulator::GetIterationStiffness(settings.ShapeStiffness, settings.Iterations));
+	simulateCS->SetShaderResourceView("restData", hairRestSRV);
+	simulateCS->SetShaderResourceView("guideStrands", hairGuideSRV);
+	// A replay brings its own table if the groom's isn't the one it was recorded with
+	simulateCS->SetShaderResourceView("physicsTable", hair.GetReplayPhysicsSRV() ? hair.GetReplayPhysicsSRV() : hairPhysicsSRV);
+	hair.SetSimulateShaderResources(simulateCS.get(), wake);
 	simulateCS->CopyAllBufferData();
-	simulateCS->DispatchByThreads(numOfVerts * 5, 1, 1);
 
+	hair.DispatchStep(context, simulateCS.get(), lod.simulatedStrands, wake);
+	simulateCS->SetShaderResourceView("voxelField", 0);
 
-	D3D11_BUFFER_DESC newHairBufferDesc;
-	newHairBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	newHairBufferDesc.ByteWidth = (sizeof(HairStrand)) * numOfVerts * 5; // Number of vertices
-	newHairBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	newHairBufferDesc.CPUAccessFlags = 0;
-	newHairBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	newHairBufferDesc.StructureByteStride = sizeof(HairStrand);
-	device->CreateBuffer(&newHairBufferDesc, 0, newHairBuffer.GetAddressOf());
-	context->CopyResource(newHairBuffer.Get(), initialHairBuffer.Get());
+	// Fill in everything that wasn't simulated from the guides, lower LODs don't draw followers at all
+	if (lod.interpolateFollowers && numOfFollowers > 0)
+	{
+		std::shared_ptr<SimpleComputeShader> interpolateCS = Assets::GetInstance().GetComputeShader("InterpolateHair");
+		interpolateCS->SetShader();
+		interpolateCS->SetInt("numOfFollowers", numOfFollowers);
+		interpolateCS->SetInt("vertsPerStrand", vertsPerStrand);
+		interpolateCS->SetFloat("stateScale", GetHairStateScale());
+		interpolateCS->SetShaderResourceView("followers", hairFollowerSRV);
+		interpolateCS->SetShaderResourceView("restData", hairRestSRV);
+		interpolateCS->SetUnorderedAccessView("hairData", hair.GetStateSlot(hair.GetCurrentSlot()).uav);
+		interpolateCS->CopyAllBufferData();
+		interpolateCS->DispatchByThreads(numOfFollowers * vertsPerStrand, 1, 1);
+		interpolateCS->SetUnorderedAccessView("hairData", 0);
+	}
+}
 
-	D3D11_SHADER_RESOURCE_VIEW_DESC hairSRVDesc = {};
-	hairSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
-	hairSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	hairSRVDesc.Buffer.NumElements = numOfVerts;
-	hairSRVDesc.Buffer.FirstElement = 0;
-	device->CreateShaderResourceView(newHairBuffer.Get(), &hairSRVDesc, hairSRV.GetAddressOf());
+// Density and velocity of every guide vertex this LOD simulates, from the newest state.
+// The grid covers the hair's bounding sphere (see CreateRootBuffers)
+void Mesh::SplatHairVoxels(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> state, const HairLODLevel& lod, float deltaTime)
+{
+	std::shared_ptr<SimpleComputeShader> splatCS = Assets::GetInstance().GetComputeShader("SplatHairVoxels");
+	splatCS->SetShader();
+	splatCS->SetFloat3("voxelMin", XMFLOAT3(hairBoundsCenter.x - hairBoundsRadius, hairBoundsCenter.y - hairBoundsRadius, hairBoundsCenter.z - hairBoundsRadius));
+	splatCS->SetFloat("voxelCellSize", hairBoundsRadius * 2.0f / HAIR_VOXEL_RESOLUTION);
+	splatCS->SetFloat("deltaTime", deltaTime);
+	splatCS->SetFloat("stateScale", GetHairStateScale());
+	splatCS->SetInt("numOfGuides", lod.simulatedStrands);
+	splatCS->SetInt("guideStep", lod.guideStep);
+	splatCS->SetInt("vertsPerStrand", vertsPerStrand);
+	splatCS->SetInt("lodSegments", lod.segments);
+	splatCS->SetShaderResourceView("hairData", state);
+	splatCS->SetShaderResourceView("guideStrands", hairGuideSRV);
+	splatCS->SetShaderResourceView("restData", hairRestSRV);
+	splatCS->SetUnorderedAccessView("voxelCells", hairVoxelCellsUAV);
+	splatCS->CopyAllBufferData();
+	splatCS->DispatchByThreads(lod.simulatedStrands * (lod.segments + 1), 1, 1);
+	splatCS->SetUnorderedAccessView("voxelCells", 0);
+	splatCS->SetShaderResourceView("hairData", 0);
+
+	std::shared_ptr<SimpleComputeShader> resolveCS = Assets::GetInstance().GetComputeShader("ResolveHairVoxels");
+	resolveCS->SetShader();
+	resolveCS->SetUnorderedAccessView("voxelCells", hairVoxelCellsUAV);
+	resolveCS->SetUnorderedAccessView("voxelField", hairVoxelFieldUAV);
+	resolveCS->DispatchByThreads(HAIR_VOXEL_RESOLUTION, HAIR_VOXEL_RESOLUTION, HAIR_VOXEL_RESOLUTION);
+	resolveCS->SetUnorderedAccessView("voxelCells", 0);
+	resolveCS->SetUnorderedAccessView("voxelField", 0);
+}
+
+std::shared_ptr<HairInstance> Mesh::CreateHairInstance(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!hasFur)
+		return 0;
+	if (!hairGrown)
+		SetBuffersAndCreateHair(device, context);
+
+	// Entities sharing the model record into files of their own, numbered in the order they were made
+	std::string recordingPath = hairRecordingPath;
+	if (!hairRecordingPath.empty() && hairInstanceCount > 0)
+		recordingPath = hairRecordingPath.substr(0, hairRecordingPath.find_last_of('.')) + "." + std::to_string(hairInstanceCount) + ".hrec";
+	hairInstanceCount++;
+
+	std::shared_ptr<HairInstance> hair = std::make_shared<HairInstance>(recordingPath);
+	hair->Update(context, *this);
+	return hair;
 }
 
 void Mesh::SetBuffersAndCreateHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 {
-	std::shared_ptr<SimpleComputeShader> hairCS = Assets::GetInstance().GetComputeShader("CreateHair");
-
-	hairCS->SetShader();
-	hairCS->SetShaderResourceView("vertexData", shaderVertexSRV);
-	hairCS->SetUnorderedAccessView("hairData", hairUAV, 0);
-	hairCS->SetFloat("length", 0.5f);
-	hairCS->SetFloat("width", .01f);
-	hairCS->CopyAllBufferData();
-	hairCS->DispatchByThreads(numOfVerts * 5, 1, 1);
-
-	D3D11_BUFFER_DESC newHairBufferDesc;
-	newHairBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	newHairBufferDesc.ByteWidth = (sizeof(HairStrand)) * numOfVerts * 5; // Number of vertices
-	newHairBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-	newHairBufferDesc.CPUAccessFlags = 0;
-	newHairBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	newHairBufferDesc.StructureByteStride = sizeof(HairStrand);
-	device->CreateBuffer(&newHairBufferDesc, 0, newHairBuffer.GetAddressOf());
-	context->CopyResource(newHairBuffer.Get(), initialHairBuffer.Get());
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC hairSRVDesc = {};
-	hairSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
-	hairSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	hairSRVDesc.Buffer.NumElements = numOfVerts;
-	hairSRVDesc.Buffer.FirstElement = 0;
-	device->CreateShaderResourceView(newHairBuffer.Get(), &hairSRVDesc, hairSRV.GetAddressOf());
-}
-
-void Mesh::CreateHairBuffers(Vertex* vertArray, int numVerts, Microsoft::WRL::ComPtr<ID3D11Device> device)
-{
-	ShaderVertex* vertexInfo = new ShaderVertex[numVerts];
-	for (int i = 0; i < numVerts; i++)
+	// A baked groom is already in the buffers
+	if (!hairGroomLoaded)
+	{
+		std::shared_ptr<SimpleComputeShader> hairCS = Assets::GetInstance().GetComputeShader("CreateHair");
+
+		hairCS->SetShader();
+		hairCS->SetShaderResourceView("vertexData", shaderVertexSRV);
+		hairCS->SetUnorderedAccessView("hairData", hairInitialStateUAV);
+		hairCS->SetUnorderedAccessView("restData", hairRestUAV);
+		hairCS->SetFloat("length", hairLength);
+		hairCS->SetInt("numOfStrands", numOfStrands);
+		hairCS->SetInt("vertsPerStrand", vertsPerStrand);
+		hairCS->SetFloat("stateScale", GetHairStateScale());
+		hairCS->CopyAllBufferData();
+		hairCS->DispatchByThreads(numOfStrands * vertsPerStrand, 1, 1);
+		hairCS->SetUnorderedAccessView("hairData", 0);
+		hairCS->SetUnorderedAccessView("restData", 0);
+
+		// Baked on request or at shutdown (BakeHairGroom), so the next start only has to map the file
+		hairGroomDirty = true;
+	}
+
+	// Every instance starts over from the new hair the next time it's used
+	hairGrown = true;
+	hairGroomVersion++;
+
+	// Grown on the undeformed surface, moved back onto the deformed one if there is one
+	if (hairSurfaceBuffer)
+	{
+		CreateSurfaceBindingBuffers(device, context);
+		hairRootsDirty = true;
+	}
+}
+
+bool Mesh::UpdateHairSurface(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Vertex* verts, int numVerts)
+{
+	if (!hasFur || numVerts != (int)hairSurfaceVerts.size())
+		return false;
+	if (!hairBoundRestBuffer)
+		CreateSurfaceBindingBuffers(device, context);
+
+	context->UpdateSubresource(hairSurfaceBuffer.Get(), 0, 0, verts, 0, 0);
+	hairRootsDirty = true;
+	WakeHair();
+	return true;
+}
+
+// The deformed surface, the roots' triangles and a copy of the rest pose to move from every time
+void Mesh::CreateSurfaceBindingBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	auto createStructured = [&](D3D11_USAGE usage, unsigned int stride, unsigned int count, const void* initial,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = usage;
+		desc.ByteWidth = stride * count;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = initial;
+		CreateHairBuffer(&desc, initial ? &data : 0, buffer.ReleaseAndGetAddressOf(), device);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = count;
+		device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.ReleaseAndGetAddressOf());
+	};
+
+	// The indices and bindings are only used through their views, which keep them alive.
+	// The surface keeps its last deformation across regrowing
+	Microsoft::WRL::ComPtr<ID3D11Buffer> viewedOnly;
+	if (!hairSurfaceBuffer)
+	{
+		createStructured(D3D11_USAGE_DEFAULT, sizeof(Vertex), (unsigned int)hairSurfaceVerts.size(), hairSurfaceVerts.data(), hairSurfaceBuffer, hairSurfaceSRV);
+		createStructured(D3D11_USAGE_IMMUTABLE, sizeof(unsigned int), (unsigned int)hairSurfaceIndices.size(), hairSurfaceIndices.data(), viewedOnly, hairSurfaceIndexSRV);
+	}
+	createStructured(D3D11_USAGE_IMMUTABLE, sizeof(HairRootBinding), numOfStrands, hairRootBindings.data(), viewedOnly, hairBindingSRV);
+	createStructured(D3D11_USAGE_DEFAULT, sizeof(HairRestVertex), numOfStrands * vertsPerStrand, 0, hairBoundRestBuffer, hairBoundRestSRV);
+	context->CopyResource(hairBoundRestBuffer.Get(), hairRestBuffer.Get());
+}
+
+// One thread per root, the rest pose follows the triangle it's bound to
+void Mesh::UpdateHairRoots(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	std::shared_ptr<SimpleComputeShader> rootsCS = Assets::GetInstance().GetComputeShader("UpdateHairRoots");
+	rootsCS->SetShader();
+	rootsCS->SetInt("numOfStrands", numOfStrands);
+	rootsCS->SetInt("vertsPerStrand", vertsPerStrand);
+	rootsCS->SetShaderResourceView("surfaceVerts", hairSurfaceSRV);
+	rootsCS->SetShaderResourceView("surfaceIndices", hairSurfaceIndexSRV);
+	rootsCS->SetShaderResourceView("rootBindings", hairBindingSRV);
+	rootsCS->SetShaderResourceView("boundRoots", shaderVertexSRV);
+	rootsCS->SetShaderResourceView("boundRest", hairBoundRestSRV);
+	rootsCS->SetUnorderedAccessView("restData", hairRestUAV);
+	rootsCS->CopyAllBufferData();
+	rootsCS->DispatchByThreads(numOfStrands, 1, 1);
+	rootsCS->SetUnorderedAccessView("restData", 0);
+	hairRootsDirty = false;
+}
+
+void Mesh::SetHairSegmentCount(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int segments)
+{
+	if (!hasFur)
+		return;
+
+	segments = min(max(segments, 1), HAIR_MAX_VERTS_PER_STRAND - 1);
+	if (segments == vertsPerStrand - 1)
+		return;
+
+	vertsPerStrand = segments + 1;
+	hairGroomLoaded = false;
+	CreateStrandBuffers(device);
+	CreateHairLODs();
+	SetBuffersAndCreateHair(device, context);
+}
+
+void Mesh::SetHairDensity(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, float density)
+{
+	if (!hasFur)
+		return;
+
+	hairDensity = min(max(density, 0.0f), HAIR_MAX_ROOT_DENSITY);
+	RegrowHair(device, context);
+}
+
+void Mesh::SetHairDensityMask(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mask)
+{
+	if (!hasFur)
+		return;
+
+	hairDensityMask = HairTextureReadback::ReadDensityMask(device, context, mask);
+	RegrowHair(device, context);
+}
+
+void Mesh::SetHairPhysicsMap(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> map)
+{
+	if (!hasFur)
+		return;
+
+	// Only the table changes, the strands stay where they are
+	hairPhysicsMap = HairTextureReadback::ReadUVMap(device, context, map);
+	BuildHairPhysics();
+	CreatePhysicsBuffer(device, hairPhysics, hairPhysicsSRV);
+	WakeHair();
+
+	// Kept with the groom the next time it's baked
+	hairGroomDirty = true;
+}
+
+void Mesh::SetHairGuideRatio(Microsoft::WRL::ComPtr<ID3D11Device> device, int ratio)
+{
+	if (!hasFur)
+		return;
+
+	ratio = min(max(ratio, 1), HAIR_MAX_GUIDE_RATIO);
+	if (ratio == hairGuideRatio)
+		return;
+
+	// Bindings only depend on the roots, the state ring stays as it is
+	hairGuideRatio = ratio;
+	CreateGuideBuffers(device);
+	CreateHairLODs();
+	WakeHair();
+}
+
+void Mesh::ResetHairLOD(HairInstance& hair)
+{
+	hair.ResetLOD();
+}
+
+void Mesh::RequestHairLOD(HairInstance& hair, XMFLOAT4X4 world, XMFLOAT4X4 view, XMFLOAT4X4 projection)
+{
+	if (hasFur)
+		hair.RequestLOD(*this, world, view, projection);
+}
+
+int Mesh::GetHairTessellation(HairInstance& hair)
+{
+	return hair.GetTessellation(*this);
+}
+
+void Mesh::SetHairStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, int slotCount, int frameLatency)
+{
+	if (hasFur)
+		hair.SetStateRing(device, context, *this, slotCount, frameLatency);
+}
+
+HRESULT Mesh::CreateHairBuffer(D3D11_BUFFER_DESC* desc, D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	HRESULT hr = device->CreateBuffer(desc, initialData, buffer);
+	if (SUCCEEDED(hr))
+		hairBufferAllocations++;
+	return hr;
+}
+
+void Mesh::CreateHairBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, int hairSegments, int guideRatio, float density, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	// Keep the surface around so the roots can be resampled later
+	hairSurfaceVerts.assign(vertArray, vertArray + numVerts);
+	hairSurfaceIndices.assign(indexArray, indexArray + numIndices);
+	hairDensity = min(max(density, 0.0f), HAIR_MAX_ROOT_DENSITY);
+
+	vertsPerStrand = min(max(hairSegments, 1), HAIR_MAX_VERTS_PER_STRAND - 1) + 1;
+	hairLength = 0.5f;
+	hairWidth = 0.01f;
+	hairSolverSettings = HairSimulator::GetDefaultSettings();
+	hairGuideRatio = min(max(guideRatio, 1), HAIR_MAX_GUIDE_RATIO);
+	hairRootsDirty = false;
+	hairGrown = false;
+	hairInstanceCount = 0;
+	hairGroomVersion = 0;
+	hairWakeGeneration = 0;
+
+	// Use the baked groom if it was made with these same settings
+	HairGroomCache groom;
+	hairGroomLoaded = !hairGroomPath.empty() && groom.Open(hairGroomPath) && IsHairGroomCurrent(groom.GetHeader());
+	hairGroomDirty = false;
+	CreateRootBuffers(device, hairGroomLoaded ? &groom : 0);
+
+	CreateStrandBuffers(device, hairGroomLoaded ? &groom : 0);
+	CreateGuideBuffers(device);
+	CreateHairLODs();
+
+	hairCollisionEnabled = true;
+	hairCollisionResolution = HAIR_SDF_DEFAULT_RESOLUTION;
+	CreateCollisionField(device);
+	CreateVoxelBuffers(device);
+}
+
+// Everything sized by the strand count and segment count
+void Mesh::CreateStrandBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, HairGroomCache* groom)
+{
+	//Create the rest data, written once by CreateHair and only read after that
+	D3D11_BUFFER_DESC rbd = {};
+	rbd.Usage = D3D11_USAGE_DEFAULT;
+	rbd.ByteWidth = sizeof(HairRestVertex) * numOfStrands * vertsPerStrand;
+	rbd.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	rbd.CPUAccessFlags = 0;
+	rbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	rbd.StructureByteStride = sizeof(HairRestVertex);
+	D3D11_SUBRESOURCE_DATA restData = {};
+	restData.pSysMem = groom ? groom->GetRest() : 0;
+	CreateHairBuffer(&rbd, groom ? &restData : 0, hairRestBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC restUAVDesc = {};
+	restUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	restUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	restUAVDesc.Buffer.FirstElement = 0;
+	restUAVDesc.Buffer.NumElements = numOfStrands * vertsPerStrand;
+	device->CreateUnorderedAccessView(hairRestBuffer.Get(), &restUAVDesc, hairRestUAV.ReleaseAndGetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC restSRVDesc = {};
+	restSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	restSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	restSRVDesc.Buffer.FirstElement = 0;
+	restSRVDesc.Buffer.NumElements = numOfStrands * vertsPerStrand;
+	device->CreateShaderResourceView(hairRestBuffer.Get(), &restSRVDesc, hairRestSRV.ReleaseAndGetAddressOf());
+
+	// Bound to the old roots, made again for the new ones once the hair has been created
+	hairBindingSRV.Reset();
+	hairBoundRestBuffer.Reset();
+	hairBoundRestSRV.Reset();
+
+	// Per vertex physics, authored in the groom or looked up from the physics map at the roots
+	if (groom)
 	{
-		vertexInfo[i].Position = vertArray[i].Position;
-		vertexInfo[i].Normal = vertArray[i].Normal;
-		vertexInfo[i].Tangent = vertArray[i].Tangent;
-		vertexInfo[i].UV = vertArray[i].UV;
-		vertexInfo[i].padding = 0;
+		hairPhysics.assign(groom->GetPhysics(), groom->GetPhysics() + numOfStrands * vertsPerStrand);
+		KeepAuthoredHairPhysics();
 	}
+	else
+		BuildHairPhysics();
+	CreatePhysicsBuffer(device, hairPhysics, hairPhysicsSRV);
+
+	// What every instance's state ring starts out as, CreateHair fills it if there's no groom
+	D3D11_BUFFER_DESC sbd = {};
+	sbd.Usage = D3D11_USAGE_DEFAULT;
+	sbd.ByteWidth = sizeof(HairPackedVertex) * numOfStrands * vertsPerStrand;
+	sbd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	sbd.CPUAccessFlags = 0;
+	sbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	sbd.StructureByteStride = sizeof(HairPackedVertex);
+	D3D11_SUBRESOURCE_DATA stateData = {};
+	stateData.pSysMem = groom ? groom->GetState() : 0;
+	CreateHairBuffer(&sbd, groom ? &stateData : 0, hairInitialStateBuffer.ReleaseAndGetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC stateUAVDesc = {};
+	stateUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	stateUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	stateUAVDesc.Buffer.FirstElement = 0;
+	stateUAVDesc.Buffer.NumElements = numOfStrands * vertsPerStrand;
+	device->CreateUnorderedAccessView(hairInitialStateBuffer.Get(), &stateUAVDesc, hairInitialStateUAV.ReleaseAndGetAddressOf());
+}
+
+void Mesh::BuildHairPhysics()
+{
+	// Without a map each strand takes what was authored on the root closest to it, the defaults if nothing was
+	std::vector<int> nearest;
+	if (hairPhysicsMap.Width == 0)
+		HairRootSampler::FindNearest(hairAuthoredRoots.data(), (int)hairAuthoredRoots.size(), hairRoots.data(), numOfStrands, nearest);
+
+	std::vector<unsigned int> strandPhysics(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+	{
+		if (hairPhysicsMap.Width == 0)
+		{
+			strandPhysics[i] = nearest[i] >= 0 ? hairAuthoredPhysics[nearest[i]] : HAIR_PHYSICS_DEFAULT;
+			continue;
+		}
+		Vertex root = HairRootSampler::Evaluate(hairSurfaceVerts.data(), hairSurfaceIndices.data(), hairRootBindings[i]);
+		strandPhysics[i] = hairPhysicsMap.Sample(root.UV, HAIR_PHYSICS_DEFAULT);
+	}
+	HairSimulator::BuildPhysicsTable(strandPhysics.data(), numOfStrands, vertsPerStrand, hairPhysics);
+}
+
+// The table as it is now becomes what a regrow carries over, one value per strand with the root it belongs to
+void Mesh::KeepAuthoredHairPhysics()
+{
+	hairAuthoredRoots = hairRoots;
+	hairAuthoredPhysics.resize(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		hairAuthoredPhysics[i] = hairPhysics[i * vertsPerStrand];
+}
+
+unsigned int Mesh::GetHairPhysicsHash()
+{
+	if (hairPhysicsMap.Width == 0)
+		return 0;
+	return HairHashBytes(hairPhysicsMap.Texels.data(), hairPhysicsMap.Texels.size() * sizeof(unsigned int));
+}
+
+void Mesh::CreatePhysicsBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const std::vector<unsigned int>& physics, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	D3D11_BUFFER_DESC pbd = {};
+	pbd.Usage = D3D11_USAGE_IMMUTABLE;
+	pbd.ByteWidth = sizeof(unsigned int) * (unsigned int)physics.size();
+	pbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	pbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	pbd.StructureByteStride = sizeof(unsigned int);
+	D3D11_SUBRESOURCE_DATA physicsData = {};
+	physicsData.pSysMem = physics.data();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> physicsBuffer;
+	CreateHairBuffer(&pbd, &physicsData, physicsBuffer.GetAddressOf(), device);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC physicsSRVDesc = {};
+	physicsSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	physicsSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	physicsSRVDesc.Buffer.NumElements = (unsigned int)physics.size();
+	device->CreateShaderResourceView(physicsBuffer.Get(), &physicsSRVDesc, srv.ReleaseAndGetAddressOf());
+}
+
+// Picks the guides and binds every other strand to its nearest ones
+void Mesh::CreateGuideBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	std::vector<HairFollower> followers;
+	HairSimulator::BindFollowers(&hairRoots[0], numOfStrands, hairGuideRatio, hairGuideStrands, followers);
+	numOfGuides = (int)hairGuideStrands.size();
+	numOfFollowers = (int)followers.size();
+
+	D3D11_BUFFER_DESC gbd = {};
+	gbd.Usage = D3D11_USAGE_IMMUTABLE;
+	gbd.ByteWidth = sizeof(int) * numOfGuides;
+	gbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	gbd.CPUAccessFlags = 0;
+	gbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	gbd.StructureByteStride = sizeof(int);
+	D3D11_SUBRESOURCE_DATA guideData = {};
+	guideData.pSysMem = &hairGuideStrands[0];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> guideBuffer;
+	CreateHairBuffer(&gbd, &guideData, guideBuffer.GetAddressOf(), device);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC guideSRVDesc = {};
+	guideSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	guideSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	guideSRVDesc.Buffer.FirstElement = 0;
+	guideSRVDesc.Buffer.NumElements = numOfGuides;
+	device->CreateShaderResourceView(guideBuffer.Get(), &guideSRVDesc, hairGuideSRV.ReleaseAndGetAddressOf());
+
+	// Every strand is a guide, nothing to interpolate
+	hairFollowerSRV.Reset();
+	if (numOfFollowers == 0)
+		return;
+
+	D3D11_BUFFER_DESC fbd = gbd;
+	fbd.ByteWidth = sizeof(HairFollower) * numOfFollowers;
+	fbd.StructureByteStride = sizeof(HairFollower);
+	D3D11_SUBRESOURCE_DATA followerData = {};
+	followerData.pSysMem = &followers[0];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> followerBuffer;
+	CreateHairBuffer(&fbd, &followerData, followerBuffer.GetAddressOf(), device);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC followerSRVDesc = guideSRVDesc;
+	followerSRVDesc.Buffer.NumElements = numOfFollowers;
+	device->CreateShaderResourceView(followerBuffer.Get(), &followerSRVDesc, hairFollowerSRV.GetAddressOf());
+}
+
+// Level 0 draws every strand at full detail, the others fewer guides with fewer segments.
+// Nothing to upload, HairVS expands the ribbons from the vertex ID
+void Mesh::CreateHairLODs()
+{
+	for (int level = 0; level < HAIR_LOD_LEVELS; level++)
+	{
+		HairLODLevel& lod = hairLODs[level];
+		lod.guideStep = level == 0 ? 1 : 1 << (level - 1);
+		lod.drawStep = level == 0 ? 0 : lod.guideStep;
+		lod.segments = max((vertsPerStrand - 1) >> level, 1);
+		lod.interpolateFollowers = level == 0;
+		lod.simulatedStrands = (numOfGuides + lod.guideStep - 1) / lod.guideStep;
+		lod.drawnStrands = level == 0 ? numOfStrands : lod.simulatedStrands;
+		lod.widthScale = (float)numOfStrands / lod.drawnStrands;
+		lod.vertexCount = lod.drawnStrands * lod.segments * HAIR_RIBBON_VERTICES_PER_SEGMENT;
+	}
+}
+
+// Samples the roots by surface area and uploads them for CreateHair
+void Mesh::CreateRootBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, HairGroomCache* groom)
+{
+	std::vector<ShaderVertex> sampledRoots;
+	const ShaderVertex* vertexInfo;
+	if (groom)
+	{
+		// Straight out of the mapped file
+		numOfStrands = groom->GetHeader()->NumOfStrands;
+		hairRootBindings.assign(groom->GetBindings(), groom->GetBindings() + numOfStrands);
+		vertexInfo = groom->GetRoots();
+	}
+	else
+	{
+		HairRootSampler::Sample(hairSurfaceVerts.data(), hairSurfaceIndices.data(), (int)hairSurfaceIndices.size(), hairDensity, hairRootSeed, &hairDensityMask, hairRootBindings);
+
+		// Always at least one strand so none of the hair buffers end up empty
+		if (hairRootBindings.empty())
+			hairRootBindings.push_back({ 0, XMFLOAT3(1.0f / 3, 1.0f / 3, 1.0f / 3) });
+		numOfStrands = (int)hairRootBindings.size();
+
+		// Neighbouring roots next to each other, so every cluster of strands is a range of indices
+		std::vector<Vertex> roots(numOfStrands);
+		std::vector<XMFLOAT3> positions(numOfStrands);
+		for (int i = 0; i < numOfStrands; i++)
+		{
+			roots[i] = HairRootSampler::Evaluate(hairSurfaceVerts.data(), hairSurfaceIndices.data(), hairRootBindings[i]);
+			positions[i] = roots[i].Position;
+		}
+		std::vector<int> order;
+		HairClusters::SortStrands(positions.data(), numOfStrands, order);
+		std::vector<HairRootBinding> sortedBindings(numOfStrands);
+		for (int i = 0; i < numOfStrands; i++)
+			sortedBindings[i] = hairRootBindings[order[i]];
+		hairRootBindings.swap(sortedBindings);
+
+		sampledRoots.resize(numOfStrands);
+		for (int i = 0; i < numOfStrands; i++)
+		{
+			const Vertex& root = roots[order[i]];
+			sampledRoots[i].Position = root.Position;
+			sampledRoots[i].Normal = root.Normal;
+			sampledRoots[i].Tangent = root.Tangent;
+			sampledRoots[i].UV = root.UV;
+			sampledRoots[i].padding = 0;
+		}
+		vertexInfo = sampledRoots.data();
+	}
+
+	hairRoots.resize(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		hairRoots[i] = vertexInfo[i].Position;
 
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC sbd;
 	sbd.Usage = D3D11_USAGE_IMMUTABLE;
-	sbd.ByteWidth = (sizeof(ShaderVertex)) * numVerts; // Number of vertices
+	sbd.ByteWidth = (sizeof(ShaderVertex)) * numOfStrands; // Number of roots
 	sbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 	sbd.CPUAccessFlags = 0;
 	sbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 	sbd.StructureByteStride = sizeof(ShaderVertex);
 	D3D11_SUBRESOURCE_DATA initialVertexData;
 	initialVertexData.pSysMem = vertexInfo;
-	device->CreateBuffer(&sbd, &initialVertexData, sb.GetAddressOf());
+	CreateHairBuffer(&sbd, &initialVertexData, sb.ReleaseAndGetAddressOf(), device);
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC shaderVertexDesc = {};
 	shaderVertexDesc.Format = DXGI_FORMAT_UNKNOWN;
 	shaderVertexDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	shaderVertexDesc.Buffer.NumElements = numVerts * 5;
+	shaderVertexDesc.Buffer.NumElements = numOfStrands;
 	shaderVertexDesc.Buffer.FirstElement = 0;
 	shaderVertexDesc.Buffer.ElementWidth = sizeof(ShaderVertex);
-	device->CreateShaderResourceView(sb.Get(), &shaderVertexDesc, shaderVertexSRV.GetAddressOf());
-
-	//Create buffer for information on hair
-	D3D11_BUFFER_DESC hbd;
-	hbd.Usage = D3D11_USAGE_DEFAULT;
-	hbd.ByteWidth = sizeof(HairStrand) * numVerts * 5; 
-	hbd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-	hbd.CPUAccessFlags = 0;
-	hbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-	hbd.StructureByteStride = sizeof(HairStrand);
-	device->CreateBuffer(&hbd, 0, initialHairBuffer.GetAddressOf());
-
-	D3D11_UNORDERED_ACCESS_VIEW_DESC hairDesc = {};
-	hairDesc.Format = DXGI_FORMAT_UNKNOWN;
-	hairDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-	hairDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_COUNTER;
-	hairDesc.Buffer.FirstElement = 0;
-	hairDesc.Buffer.NumElements = numVerts;
-	device->CreateUnorderedAccessView(initialHairBuffer.Get(), &hairDesc, hairUAV.GetAddressOf());
-
-	//Create hair index buffer
-	int numIndices = numOfVerts * 9;
-	unsigned int* indicies = new unsigned int[numIndices];
-	int count = 0;
-	for (int i = 0; i < numOfVerts * 5; i += 5)
+	device->CreateShaderResourceView(sb.Get(), &shaderVertexDesc, shaderVertexSRV.ReleaseAndGetAddressOf());
+
+	// Bounding sphere of the roots, grown by the longest a strand can get
+	XMVECTOR rootMin = XMLoadFloat3(&hairRoots[0]);
+	XMVECTOR rootMax = rootMin;
+	for (int i = 1; i < numOfStrands; i++)
+	{
+		rootMin = XMVectorMin(rootMin, XMLoadFloat3(&hairRoots[i]));
+		rootMax = XMVectorMax(rootMax, XMLoadFloat3(&hairRoots[i]));
+	}
+	XMVECTOR center = (rootMin + rootMax) * 0.5f;
+	XMStoreFloat3(&hairBoundsCenter, center);
+	hairBoundsRadius = XMVectorGetX(XMVector3Length(rootMax - center)) + hairLength * 1.15f;
+
+	std::vector<XMFLOAT3> rootNormals(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+		rootNormals[i] = vertexInfo[i].Normal;
+	hairClusters.Build(hairRoots.data(), rootNormals.data(), numOfStrands, hairLength * 1.15f);
+}
+
+// Everything hangs off the roots, so rebuild it all and grow the hair again
+void Mesh::RegrowHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	hairGroomLoaded = false;
+	CreateRootBuffers(device);
+	CreateStrandBuffers(device);
+	CreateGuideBuffers(device);
+	CreateHairLODs();
+	SetBuffersAndCreateHair(device, context);
+}
+
+bool Mesh::IsHairGroomCurrent(const HairGroomHeader* header)
+{
+	unsigned int surfaceHash = HairHashBytes(hairSurfaceVerts.data(), hairSurfaceVerts.size() * sizeof(Vertex));
+	surfaceHash = HairHashBytes(hairSurfaceIndices.data(), hairSurfaceIndices.size() * sizeof(unsigned int), surfaceHash);
+	// The floats went through a slider and a file, close enough is the same groom
+	return header->VertsPerStrand == (unsigned int)vertsPerStrand &&
+		fabsf(header->Density - hairDensity) <= 1e-4f * max(1.0f, hairDensity) &&
+		fabsf(header->Length - hairLength) <= 1e-5f &&
+		header->RootSeed == hairRootSeed &&
+		header->SurfaceHash == surfaceHash &&
+		(hairPhysicsMap.Width == 0 || header->PhysicsHash == GetHairPhysicsHash()) &&
+		hairDensityMask.Width == 0;
+}
+
+void Mesh::BakeHairGroom(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!hasFur || !hairGroomDirty || hairGroomPath.empty())
+		return;
+
+	SaveHairGroom(device, context);
+	hairGroomDirty = false;
+}
+
+// Reads the freshly created hair back and writes it next to the model
+void Mesh::SaveHairGroom(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Masks come from textures at runtime, not worth baking
+	if (hairDensityMask.Width != 0)
+		return;
+
+	int numOfHairVerts = numOfStrands * vertsPerStrand;
+	std::vector<HairRestVertex> rest(numOfHairVerts);
+	std::vector<HairPackedVertex> state(numOfHairVerts);
+	if (!ReadBackHairBuffer(device, context, hairRestBuffer.Get(), rest.data()))
+		return;
+
+	// The initial state may come from an older groom, start from the rest pose like CreateHair does
+	for (int i = 0; i < numOfHairVerts; i++)
 	{
-		indicies[count++] = i;
-		indicies[count++] = i + 1;
-		indicies[count++] = i + 2;
-		indicies[count++] = i + 2;
-		indicies[count++] = i + 1;
-		indicies[count++] = i + 3;
-		indicies[count++] = i + 1;
-		indicies[count++] = i + 4;
-		indicies[count++] = i + 3;
+		const XMFLOAT3& root = rest[i - i % vertsPerStrand].OriginalPosition;
+		state[i] = HairPackVertex(rest[i].OriginalPosition, rest[i].OriginalPosition, root, GetHairStateScale());
 	}
 
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indicies;
+	std::vector<ShaderVertex> roots(numOfStrands);
+	std::vector<HairStrandParams> params(numOfStrands);
+	for (int i = 0; i < numOfStrands; i++)
+	{
+		Vertex root = HairRootSampler::Evaluate(hairSurfaceVerts.data(), hairSurfaceIndices.data(), hairRootBindings[i]);
+		roots[i].Position = root.Position;
+		roots[i].Normal = root.Normal;
+		roots[i].Tangent = root.Tangent;
+		roots[i].UV = root.UV;
+		roots[i].padding = 0;
+
+		params[i].Length = 0;
+		params[i].Width = hairWidth;
+		for (int v = 1; v < vertsPerStrand; v++)
+		{
+			XMVECTOR a = XMLoadFloat3(&rest[i * vertsPerStrand + v - 1].OriginalPosition);
+			XMVECTOR b = XMLoadFloat3(&rest[i * vertsPerStrand + v].OriginalPosition);
+			params[i].Length += XMVectorGetX(XMVector3Length(b - a));
+		}
+	}
+
+	HairGroomHeader header = {};
+	header.NumOfStrands = numOfStrands;
+	header.VertsPerStrand = vertsPerStrand;
+	header.Density = hairDensity;
+	header.Length = hairLength;
+	header.RootSeed = hairRootSeed;
+	header.SurfaceHash = HairHashBytes(hairSurfaceVerts.data(), hairSurfaceVerts.size() * sizeof(Vertex));
+	header.SurfaceHash = HairHashBytes(hairSurfaceIndices.data(), hairSurfaceIndices.size() * sizeof(unsigned int), header.SurfaceHash);
+	header.PhysicsHash = GetHairPhysicsHash();
+	if (HairGroomCache::Write(hairGroomPath, header, roots.data(), hairRootBindings.data(), params.data(), rest.data(), state.data(), hairPhysics.data()))
+		KeepAuthoredHairPhysics();
+}
+
+// Copies a whole GPU buffer into destination, which has to be big enough. Waits for the GPU,
+// so only for one off reads like baking the groom or starting a recording. The staging buffer is
+// kept and only made again for a buffer of another size, and like every readback it isn't counted
+bool Mesh::ReadBackHairBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, ID3D11Buffer* buffer, void* destination)
+{
+	D3D11_BUFFER_DESC desc = {};
+	buffer->GetDesc(&desc);
+	D3D11_BUFFER_DESC stagingDesc = {};
+	if (hairReadback)
+		hairReadback->GetDesc(&stagingDesc);
+	if (stagingDesc.ByteWidth != desc.ByteWidth)
+	{
+		stagingDesc = {};
+		stagingDesc.Usage = D3D11_USAGE_STAGING;
+		stagingDesc.ByteWidth = desc.ByteWidth;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		if (FAILED(device->CreateBuffer(&stagingDesc, 0, hairReadback.ReleaseAndGetAddressOf())))
+			return false;
+	}
+	context->CopyResource(hairReadback.Get(), buffer);
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(hairReadback.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+	memcpy(destination, mapped.pData, desc.ByteWidth);
+	context->Unmap(hairReadback.Get(), 0);
+	return true;
+}
+
+// Signed distance field of the surface the hair grows from, from the cache next to the model if it's current
+void Mesh::CreateCollisionField(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	// Reaches far enough past the mesh for the longest strand
+	float padding = hairLength * 1.2f + HAIR_COLLISION_MARGIN;
+	unsigned int surfaceHash = HairCollisionField::HashSurface(hairSurfaceVerts.data(), (int)hairSurfaceVerts.size(), hairSurfaceIndices.data(), (int)hairSurfaceIndices.size());
+	hairCollisionFromCache = !hairCollisionPath.empty() && hairCollisionField.Load(hairCollisionPath, surfaceHash, hairCollisionResolution, padding);
+	if (!hairCollisionFromCache)
+	{
+		hairCollisionField.Bake(hairSurfaceVerts.data(), (int)hairSurfaceVerts.size(), hairSurfaceIndices.data(), (int)hairSurfaceIndices.size(), hairCollisionResolution, padding);
+		if (!hairCollisionPath.empty())
+			hairCollisionField.Save(hairCollisionPath);
+	}
 
-	D3D11_BUFFER_DESC ibDesc = {};
-	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.CPUAccessFlags = 0;
-	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibDesc.ByteWidth = sizeof(unsigned int) * numIndices;
-	device->CreateBuffer(&ibDesc, &indexData, hairIB.GetAddressOf());
+	D3D11_TEXTURE3D_DESC texDesc = {};
+	texDesc.Width = hairCollisionResolution;
+	texDesc.Height = hairCollisionResolution;
+	texDesc.Depth = hairCollisionResolution;
+	texDesc.MipLevels = 1;
+	texDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA fieldData = {};
+	fieldData.pSysMem = hairCollisionField.GetDistances().data();
+	fieldData.SysMemPitch = sizeof(float) * hairCollisionResolution;
+	fieldData.SysMemSlicePitch = sizeof(float) * hairCollisionResolution * hairCollisionResolution;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> fieldTexture;
+	device->CreateTexture3D(&texDesc, &fieldData, fieldTexture.GetAddressOf());
+	device->CreateShaderResourceView(fieldTexture.Get(), 0, hairCollisionSRV.ReleaseAndGetAddressOf());
+
+	if (!hairClampSampler)
+	{
+		// Clamped, so outside the field reads as the (positive) distance at its edge
+		D3D11_SAMPLER_DESC sampDesc = {};
+		sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+		device->CreateSamplerState(&sampDesc, hairClampSampler.GetAddressOf());
+	}
+}
 
-	delete[] indicies;
-	delete[] vertexInfo;
+void Mesh::SetHairCollisionResolution(Microsoft::WRL::ComPtr<ID3D11Device> device, int resolution)
+{
+	if (!hasFur)
+		return;
+
+	resolution = min(max(resolution, 8), HAIR_SDF_MAX_RESOLUTION);
+	if (resolution == hairCollisionResolution)
+		return;
+
+	hairCollisionResolution = resolution;
+	CreateCollisionField(device);
+	WakeHair();
+}
+
+// Fixed size, the grid is stretched over whatever the hair's bounds are
+void Mesh::CreateVoxelBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	const int numOfCells = HAIR_VOXEL_RESOLUTION * HAIR_VOXEL_RESOLUTION * HAIR_VOXEL_RESOLUTION;
+
+	// Starts out empty, ResolveHairVoxels empties it again after every step
+	D3D11_BUFFER_DESC cellsDesc = {};
+	cellsDesc.Usage = D3D11_USAGE_DEFAULT;
+	cellsDesc.ByteWidth = sizeof(int) * 4 * numOfCells;
+	cellsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	cellsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	std::vector<int> zeroes(4 * numOfCells, 0);
+	D3D11_SUBRESOURCE_DATA zeroData = {};
+	zeroData.pSysMem = zeroes.data();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> cellsBuffer;
+	CreateHairBuffer(&cellsDesc, &zeroData, cellsBuffer.GetAddressOf(), device);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC cellsUAVDesc = {};
+	cellsUAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	cellsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	cellsUAVDesc.Buffer.NumElements = 4 * numOfCells;
+	cellsUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	device->CreateUnorderedAccessView(cellsBuffer.Get(), &cellsUAVDesc, hairVoxelCellsUAV.ReleaseAndGetAddressOf());
+
+	D3D11_TEXTURE3D_DESC texDesc = {};
+	texDesc.Width = HAIR_VOXEL_RESOLUTION;
+	texDesc.Height = HAIR_VOXEL_RESOLUTION;
+	texDesc.Depth = HAIR_VOXEL_RESOLUTION;
+	texDesc.MipLevels = 1;
+	texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> fieldTexture;
+	device->CreateTexture3D(&texDesc, 0, fieldTexture.GetAddressOf());
+	device->CreateShaderResourceView(fieldTexture.Get(), 0, hairVoxelFieldSRV.ReleaseAndGetAddressOf());
+	device->CreateUnorderedAccessView(fieldTexture.Get(), 0, hairVoxelFieldUAV.ReleaseAndGetAddressOf());
 }
@@ -2,16 +2,43 @@
 
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <vector>
+#include <memory>
 
 #include "Vertex.h"
+#include "HairStrand.h"
+#include "HairPacking.h"
+#include "HairRibbon.h"
+#include "HairShared.h"
+#include "HairRootSampler.h"
+#include "HairGroomCache.h"
+#include "HairStepScheduler.h"
+#include "WindField.h"
+#include "HairCollisionField.h"
+#include "HairRecording.h"
+#include "HairClusters.h"
+#include "HairInstance.h"
+
+// One hair detail level, see HAIR_LOD_LEVELS
+struct HairLODLevel
+{
+	int vertexCount;		// HAIR_RIBBON_VERTICES_PER_SEGMENT per drawn segment, no index buffer
+	int guideStep;			// Simulates every guideStep'th guide
+	int drawStep;			// Draws every drawStep'th guide, 0 = every strand
+	int segments;			// Segments drawn and solved per strand
+	float widthScale;		// Keeps the coverage of the skipped strands
+	int drawnStrands;
+	int simulatedStrands;
+	bool interpolateFollowers;
+};
 
 
 class Mesh
 {
 public:
 	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur);
-	Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur);
+	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur, int hairSegments = HAIR_DEFAULT_SEGMENTS, int hairGuideRatio = HAIR_DEFAULT_GUIDE_RATIO, float hairDensity = HAIR_DEFAULT_ROOT_DENSITY);
+	Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device, bool hasFur, int hairSegments = HAIR_DEFAULT_SEGMENTS, int hairGuideRatio = HAIR_DEFAULT_GUIDE_RATIO, float hairDensity = HAIR_DEFAULT_ROOT_DENSITY);
 	~Mesh(void);
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() { return vb; }
@@ -21,26 +48,204 @@ public:
 
 	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
-	void SimulateHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11Device> device, float deltaTime, DirectX::XMFLOAT3 force);
-	void SetBuffersAndCreateHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
-	void SetBuffersAndDrawHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalMap);
+	// Simulation state for one more entity using this mesh, grows the groom first if nothing has yet
+	std::shared_ptr<HairInstance> CreateHairInstance(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// Runs as many fixed steps as fit in deltaTime (see HairStepScheduler).
+	// world and prevWorld are the entity's, how it moved turns into inertia on the hair.
+	// The wind field is optional, one field is meant to be shared by every entity
+	void SimulateHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, float deltaTime, DirectX::XMFLOAT3 force, DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 prevWorld, std::shared_ptr<WindField> wind = 0);
+	void SetBuffersAndDrawHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalMap);
+
+	// Slot count is clamped to 2 (ping-pong) to HAIR_MAX_STATE_SLOTS, latency is how many
+	// simulation steps the drawn hair trails behind the newest one
+	void SetHairStateRing(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, int slotCount, int frameLatency);
+
+	// Reallocates the strand buffers and regrows the hair, so not something to do every frame
+	void SetHairSegmentCount(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, int segments);
+	int GetHairSegmentCount() const { return vertsPerStrand - 1; }
+	int GetHairStrandCount() const { return numOfStrands; }
+	int GetHairVertsPerStrand() const { return vertsPerStrand; }
+	float GetHairLength() const { return hairLength; }
+
+	// Resamples the roots over the surface and regrows the hair, also not for every frame.
+	// The mask is read back from a texture once, a null texture removes it
+	void SetHairDensity(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, float density);
+	// RGBA over the mesh's UVs, looked up at each root: stiffness, damping, rest length (128 = as is) and root pin weight.
+	// Saved into the groom when it's baked, so it sticks. A null texture goes back to what the groom was authored with
+	void SetHairPhysicsMap(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> map);
+	void SetHairDensityMask(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mask);
+	float GetHairDensity() { return hairDensity; }
+	// True if the hair came out of a baked .groom file instead of the CreateHair pass
+	bool GetHairFromGroomCache() { return hairGroomLoaded; }
+	// Writes the groom next to the model if it changed since it was loaded or last baked.
+	// Reads the hair back from the GPU, so only on request or at shutdown
+	void BakeHairGroom(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	bool GetHairGroomDirty() { return hairGroomDirty; }
+	const std::string& GetHairGroomPath() { return hairGroomPath; }
+	// Range of the packed state ring around each root
+	float GetHairStateScale() const { return hairLength * HAIR_PACKED_POSITION_RANGE; }
+	// Per vertex buffers every instance shares: rest pose, initial state and physics
+	unsigned int GetHairGroomBytes() { return (unsigned int)((sizeof(HairRestVertex) + sizeof(HairPackedVertex) + sizeof(unsigned int)) * numOfStrands * vertsPerStrand); }
+
+	// Keeps the hair outside the mesh it grows from, rebaking on the CPU if the cache is stale
+	void SetHairCollisionResolution(Microsoft::WRL::ComPtr<ID3D11Device> device, int resolution);
+	int GetHairCollisionResolution() { return hairCollisionResolution; }
+	void SetHairCollision(bool enabled) { hairCollisionEnabled = enabled; WakeHair(); }
+	bool GetHairCollision() const { return hairCollisionEnabled; }
+	bool GetHairCollisionFromCache() { return hairCollisionFromCache; }
+	double GetHairCollisionBakeMilliseconds() { return hairCollisionField.GetBakeMilliseconds(); }
+	HairSolverSettings& GetHairSolverSettings() { return hairSolverSettings; }
+	const HairSolverSettings& GetHairSolverSettings() const { return hairSolverSettings; }
+	// What the instance is solved with, a replay's own while it's open
+	const HairSolverSettings& GetHairSolverSettings(HairInstance& hair) { return hair.GetReplaying() ? hair.GetReplaySettings() : hairSolverSettings; }
+	bool GetHairCollision(HairInstance& hair) { return hair.GetReplaying() ? hair.GetReplayCollision() : hairCollisionEnabled; }
+
+	// Only one in every ratio strands is simulated, the others follow their nearest guides
+	void SetHairGuideRatio(Microsoft::WRL::ComPtr<ID3D11Device> device, int ratio);
+	int GetHairGuideRatio() const { return hairGuideRatio; }
+	int GetHairGuideCount() { return numOfGuides; }
+
+	// Each instance gets the finest LOD any view of it asks for and is culled against all of them.
+	// Call ResetHairLOD once a frame, then RequestHairLOD for every view of the instance
+	void ResetHairLOD(HairInstance& hair);
+	void RequestHairLOD(HairInstance& hair, DirectX::XMFLOAT4X4 world, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
+	const HairLODLevel& GetHairLODLevel(int level) const { return hairLODs[level]; }
+	// Drawn pieces per LOD segment of the smoothed strands, from the projected segment length
+	int GetHairTessellation(HairInstance& hair);
+
+	// Moves the roots onto a deformed version of the surface the hair grew from, with the same
+	// vertices and triangles (skinning, morphs). Every root stays on its triangle at the same
+	// barycentric coordinates. Any number of calls a frame cost one pass in SimulateHair.
+	// The surface is the mesh's, so every instance moves with it. False if the vertex count doesn't match
+	bool UpdateHairSurface(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const Vertex* verts, int numVerts);
+
+	// Wakes every instance, for changes to the groom or its settings (see HairInstance::Wake)
+	void WakeHair() { hairWakeGeneration++; }
+
+	// What every instance is built from and checks against, see HairInstance::Update
+	int GetHairGroomVersion() const { return hairGroomVersion; }
+	unsigned int GetHairWakeGeneration() const { return hairWakeGeneration; }
+	ID3D11Buffer* GetHairInitialState() const { return hairInitialStateBuffer.Get(); }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetHairRestSRV() const { return hairRestSRV; }
+	const std::vector<unsigned int>& GetHairPhysics() const { return hairPhysics; }
+	const HairCollisionField& GetHairCollisionField() const { return hairCollisionField; }
+	const HairClusters& GetHairClusters() const { return hairClusters; }
+	DirectX::XMFLOAT3 GetHairBoundsCenter() const { return hairBoundsCenter; }
+	float GetHairBoundsRadius() const { return hairBoundsRadius; }
+
+	// Records what SimulateHair gets for one instance from here on into its file next to the model (see HairRecording.h
+	// and HairInstance::GetRecordingPath), starting from its current state. Recording and replaying both leave the wind
+	// out, it isn't part of the file
+	bool StartHairRecording(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair);
+	// Drives the instance from its recording instead of SimulateHair's arguments until it runs out, checking
+	// the state against the recorded checksums. Only that instance takes the recording's solver settings,
+	// collision and physics, the groom keeps its own
+	bool StartHairReplay(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair);
+
+	// Every hair state ring and simulation buffer ever created by any mesh, should stop growing
+	// after startup. Staging buffers for readbacks aren't counted
+	static unsigned int GetHairBufferAllocationCount() { return hairBufferAllocations; }
+	// Counted in GetHairBufferAllocationCount, for the instances' buffers as well as the groom's
+	static HRESULT CreateHairBuffer(D3D11_BUFFER_DESC* desc, D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	// One HairPackPhysics per strand vertex, the groom's or a replay's
+	static void CreatePhysicsBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, const std::vector<unsigned int>& physics, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vb;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> sb;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderVertexSRV;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> initialHairBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> newHairBuffer;
-	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> hairUAV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> hairRestBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> hairRestUAV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairRestSRV;
+	// Reused by ReadBackHairBuffer
+	Microsoft::WRL::ComPtr<ID3D11Buffer> hairReadback;
+	// What CreateHair grew (or the groom held), every instance starts out from it
+	Microsoft::WRL::ComPtr<ID3D11Buffer> hairInitialStateBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> hairInitialStateUAV;
+	bool hairGrown;
+	int hairGroomVersion;	// Goes up every time the hair is grown, instances of older ones are rebuilt
+	unsigned int hairWakeGeneration;
+	int numOfStrands;
+	int vertsPerStrand;
+	float hairLength;
+	float hairWidth;
+	HairSolverSettings hairSolverSettings;
+	std::vector<Vertex> hairSurfaceVerts;
+	std::vector<unsigned int> hairSurfaceIndices;
+	std::vector<HairRootBinding> hairRootBindings;
+	// Only made once the surface deforms, see UpdateHairSurface
+	Microsoft::WRL::ComPtr<ID3D11Buffer> hairSurfaceBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairSurfaceSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairSurfaceIndexSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairBindingSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> hairBoundRestBuffer;	// The rest pose as the hair was grown
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairBoundRestSRV;
+	bool hairRootsDirty;
+	HairDensityMask hairDensityMask;
+	HairUVMap hairPhysicsMap;
+	std::vector<unsigned int> hairPhysics;	// HairPackPhysics per strand vertex
+	// What the groom was authored with, one HairPackPhysics per strand and the root it sits on.
+	// Used instead of the map when there isn't one, so regrowing doesn't lose it
+	std::vector<DirectX::XMFLOAT3> hairAuthoredRoots;
+	std::vector<unsigned int> hairAuthoredPhysics;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairPhysicsSRV;
+	float hairDensity;
+	std::string hairGroomPath;
+	bool hairGroomLoaded;
+	bool hairGroomDirty;	// Regrown or repainted since the .groom was written
+	std::string hairCollisionPath;
+	std::string hairRecordingPath;	// The first instance's, the others are numbered
+	int hairInstanceCount;
+	HairCollisionField hairCollisionField;
+	int hairCollisionResolution;
+	bool hairCollisionEnabled;
+	bool hairCollisionFromCache;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairCollisionSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> hairClampSampler;	// Collision field and voxel grid
+	// Hair-hair interaction, splatted into the buffer then resolved into the texture every step
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> hairVoxelCellsUAV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> hairVoxelFieldUAV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairVoxelFieldSRV;
+	std::vector<DirectX::XMFLOAT3> hairRoots;
+	std::vector<int> hairGuideStrands;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairGuideSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairFollowerSRV;
+	int hairGuideRatio;
+	int numOfGuides;
+	int numOfFollowers;
+	HairLODLevel hairLODs[HAIR_LOD_LEVELS];
+	DirectX::XMFLOAT3 hairBoundsCenter;
+	float hairBoundsRadius;
+	HairClusters hairClusters;	// Copied into every instance, which culls its own
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ib;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> hairIB;
 	int numIndices;
 	int numOfVerts;
 	bool hasFur;
 
 	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
-	void CreateHairBuffers(Vertex* vertArray, int numVerts, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void CreateHairBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, int hairSegments, int guideRatio, float density, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void CreateRootBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, HairGroomCache* groom = 0);
+	void RegrowHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void CreateStrandBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, HairGroomCache* groom = 0);
+	void CreateGuideBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void CreateHairLODs();
+	void CreateCollisionField(Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void BuildHairPhysics();
+	void KeepAuthoredHairPhysics();
+	unsigned int GetHairPhysicsHash();
+	void CreateVoxelBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device);
+	void SplatHairVoxels(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> state, const HairLODLevel& lod, float deltaTime);
+	void SetBuffersAndCreateHair(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void CreateSurfaceBindingBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void UpdateHairRoots(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void StepHair(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, HairInstance& hair, float deltaTime, const HairExternalForces& forces, DirectX::XMFLOAT4X4 world, std::shared_ptr<WindField> wind);
+	bool IsHairGroomCurrent(const HairGroomHeader* header);
+	void SaveHairGroom(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	bool ReadBackHairBuffer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, ID3D11Buffer* buffer, void* destination);
+
+	static unsigned int hairBufferAllocations;
+	const unsigned int hairRootSeed = 1;
 };
 
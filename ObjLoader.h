@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Reads Wavefront .obj files into vertex and index lists
+//
+// Needs no device, so the hair regression tool can load
+// the same models Mesh does without a window.
+// --------------------------------------------------------
+class ObjLoader
+{
+public:
+	// One vertex per index, converted to DirectX's left handed space. No tangents
+	static bool Load(const char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+};
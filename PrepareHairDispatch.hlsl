@@ -0,0 +1,13 @@
+#include "HairShared.h"
+
+// Filled by CopyStructureCount from the active strand list
+ByteAddressBuffer activeCount	: register(t0);
+RWByteAddressBuffer dispatchArgs	: register(u0);
+
+// Turns the number of awake strands into thread groups for the next SimulateHair
+[numthreads(1, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint count = activeCount.Load(0);
+	dispatchArgs.Store3(0, uint3((count + HAIR_SIMULATE_GROUP_SIZE - 1) / HAIR_SIMULATE_GROUP_SIZE, 1, 1));
+}
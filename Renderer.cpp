@@ -1,5 +1,6 @@
 #include "Renderer.h"
 #include "Assets.h"
+#include "HairSimulator.h"
 #include <DirectXMath.h>
 
 #include "ImGui/imgui.h"
@@ -9,7 +10,7 @@
 using namespace std;
 using namespace DirectX;
 Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain, Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV,
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::shared_ptr<Terrain> terrainPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::shared_ptr<Terrain> terrainPTR, std::shared_ptr<WindField> windPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
 	std::vector<Light>& Lights, HWND hWnd)
 	:
 		lights(Lights),
@@ -25,6 +26,7 @@ Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::
 	windowHeight = WindowHeight;
 	sky = SkyPTR;
 	terrain = terrainPTR;
+	wind = windPTR;
 	for (int i = 0; i < sizeof(terrainGenDimensions) / sizeof(int); i++)
 	{
 		if (terrainGenDimensions[i] == terrain->GetDimension()) {
@@ -172,7 +174,7 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 		// Draw the entity
 		ge->Draw(context, camera);
 
-		if (ge->GetMesh()->GetHasFur())
+		if (ge->GetHair())
 		{
 			std::shared_ptr<SimpleVertexShader> vs = Assets::GetInstance().GetVertexShader("HairVS");
 			vs->SetShader();
@@ -180,25 +182,25 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 			vs->SetMatrix4x4("worldInverseTranspose", ge->GetTransform()->GetWorldInverseTransposeMatrix());
 			vs->SetMatrix4x4("view", camera->GetView());
 			vs->SetMatrix4x4("projection", camera->GetProjection());
+			vs->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
 			vs->CopyAllBufferData();
 			std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader("HairPS");
 			ps->SetShader();
-			ps->SetFloat("metalVal", 0.0f);
-			ps->SetFloat("roughnessVal", 0.0f);
+			ps->SetInt("shadingModel", hairShadingModel);
 			ps->SetData("lights", (void*)(&lights[0]), sizeof(Light) * (int)lights.size());
 			ps->SetInt("lightCount", lights.size());
 			ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
-			ps->SetInt("specIBLTotalMipLevels", sky->GetNumOfMipLevels());
-			ps->SetShaderResourceView("BrdfLookUpMap", sky->GetBrdfLookUp());
 			ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
-			ps->SetShaderResourceView("SpecularIBLMap", sky->getConvolvedSpecularMap());
+			ps->SetShaderResourceView("HairLongitudinalLUT", hairLongitudinalLUT);
+			ps->SetShaderResourceView("HairAzimuthalLUT", hairAzimuthalLUT);
+			ps->SetShaderResourceView("HairColorBlendLUT", hairColorBlendLUT);
 			ps->SetSamplerState("ClampSampler", ppSampler);
 			ps->CopyAllBufferData();
 
 
 
 			context->RSSetState(hairRast.Get());
-			ge->GetMesh()->SetBuffersAndDrawHair(context, ge->GetMaterial()->GetTextureSRV("NormalMap"));
+			ge->GetMesh()->SetBuffersAndDrawHair(context, *ge->GetHair(), ge->GetMaterial()->GetTextureSRV("NormalMap"));
 			context->RSSetState(0);
 		}
 	}
@@ -421,6 +423,237 @@ void Renderer::DrawUI(vector<shared_ptr<Material>> materials, float deltaTime)
 			ImGui::NewLine();
 		}
 	}
+	if (ImGui::CollapsingHeader("Wind")) {
+		WindSettings windSettings = wind->GetSettings();
+		bool windChanged = ImGui::DragFloat3("Velocity", &windSettings.Velocity.x, 0.05f, -10.0f, 10.0f);
+		windChanged |= ImGui::SliderFloat("Turbulence", &windSettings.Turbulence, 0.0f, 5.0f);
+		windChanged |= ImGui::SliderFloat("Gust Frequency", &windSettings.Frequency, 0.05f, 2.0f);
+		if (windChanged)
+			wind->SetSettings(windSettings);
+		ImGui::Text("Cells regenerated this frame = %d of %d", wind->GetCellsUpdated(), WIND_FIELD_RESOLUTION * WIND_FIELD_RESOLUTION * WIND_FIELD_RESOLUTION);
+	}
+	// Track this every frame, even with the header closed
+	unsigned int hairAllocations = Mesh::GetHairBufferAllocationCount();
+	unsigned int hairAllocationsThisFrame = hairAllocations - lastHairBufferAllocations;
+	lastHairBufferAllocations = hairAllocations;
+	if (ImGui::CollapsingHeader("Hair")) {
+		ImGui::Text("Hair buffer allocations = %u (%u this frame)", hairAllocations, hairAllocationsThisFrame);
+		ImGui::Text("Simulation bytes per strand = %u (interleaved layout was %u)", HairBenchmark::GetBytesPerStrand(), HairBenchmark::GetAoSBytesPerStrand());
+
+		if (hairBenchmarkTask.valid() && hairBenchmarkTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			hairBenchmark = hairBenchmarkTask.get();
+		if (hairBenchmarkTask.valid())
+			ImGui::Text("Benchmarking CPU solver...");
+		else if (ImGui::Button("Benchmark CPU Solver"))
+			hairBenchmarkTask = std::async(std::launch::async, HairBenchmark::Run, 20000, 120, HAIR_DEFAULT_SEGMENTS + 1);
+		if (hairBenchmark.steps > 0)
+			ImGui::Text("%d strands: %.3f ms per step, %.3f ms more with the voxel grid", hairBenchmark.numOfStrands,
+				hairBenchmark.millisecondsPerStep, hairBenchmark.voxelMillisecondsPerStep);
+
+		// Runs the CPU reference with and without packing, takes a moment
+		if (hairQuantizationTask.valid() && hairQuantizationTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			hairQuantization = hairQuantizationTask.get();
+		if (hairQuantizationTask.valid())
+			ImGui::Text("Measuring state quantization...");
+		else if (ImGui::Button("Measure State Quantization"))
+			hairQuantizationTask = std::async(std::launch::async, HairBenchmark::MeasureQuantization, 1000, 600, HAIR_DEFAULT_SEGMENTS + 1);
+		if (hairQuantization.steps > 0)
+			ImGui::Text("Packed state error over %d steps: max = %.6f, mean = %.6f (%u bytes per vertex, floats were %u)",
+				hairQuantization.steps, hairQuantization.maxPositionError, hairQuantization.meanPositionError,
+				hairQuantization.packedBytesPerVertex, hairQuantization.floatBytesPerVertex);
+
+		// Same groom at every power of two up to the core count, also a few seconds
+		if (hairScalingTask.valid() && hairScalingTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			hairScaling = hairScalingTask.get();
+		if (hairScalingTask.valid())
+			ImGui::Text("Measuring CPU solver scaling...");
+		else if (ImGui::Button("Measure CPU Solver Scaling"))
+			hairScalingTask = std::async(std::launch::async, HairParallelSimulator::MeasureScaling, 20000, 120, 0, HAIR_DEFAULT_SEGMENTS + 1);
+		if (hairScaling.runs > 0)
+		{
+			ImGui::Text("%d strands in batches of %d, %s across thread counts", hairScaling.numOfStrands, hairScaling.batchStrands,
+				hairScaling.deterministic ? "identical" : "NOT identical");
+			for (int run = 0; run < hairScaling.runs; run++)
+				ImGui::Text("%d threads: %.3f ms per step (x%.2f), %d batches stolen", hairScaling.threadCounts[run], hairScaling.millisecondsPerStep[run],
+					hairScaling.millisecondsPerStep[0] / hairScaling.millisecondsPerStep[run], hairScaling.stolenBatches[run]);
+		}
+
+		// Every model's hair against its golden state, several seconds. Same as running HairRegressionTool,
+		// which is also the only way to update the golden states
+		if (hairRegressionTask.valid() && hairRegressionTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			hairRegression = hairRegressionTask.get();
+		if (hairRegressionTask.valid())
+			ImGui::Text("Running hair regression...");
+		else if (ImGui::Button("Run Hair Regression"))
+			hairRegressionTask = std::async(std::launch::async, HairRegression::RunAll, hairRegressionFolder, false, HAIR_REGRESSION_FRAMES, 0);
+		for (auto& result : hairRegression)
+		{
+			ImGui::Text("%s: %s, max error %.6f, %.3f ms per frame (max %.3f, golden %.3f)", result.model.c_str(), HairRegression::GetStatusName(result.status),
+				result.maxError, result.meanFrameMilliseconds, result.maxFrameMilliseconds, result.goldenFrameMilliseconds);
+		}
+		if (!hairRegression.empty())
+			ImGui::Text("%d of %d models failed", HairRegression::GetFailedCount(hairRegression), (int)hairRegression.size());
+
+		const char* shadingModels[] = { "Kajiya-Kay", "Marschner" };
+		ImGui::Combo("Shading", &hairShadingModel, shadingModels, 2);
+		if (hairShadingModel == HAIR_SHADING_MARSCHNER)
+		{
+			// Any change means baking the tables again, so only once the button is pressed
+			ImGui::SliderAngle("Highlight Shift", &hairShadingParams.LongitudinalShift, -15.0f, 0.0f);
+			ImGui::SliderAngle("Highlight Width", &hairShadingParams.LongitudinalWidth, 2.0f, 20.0f);
+			ImGui::SliderAngle("Azimuthal Width", &hairShadingParams.AzimuthalWidth, 5.0f, 60.0f);
+			ImGui::SliderFloat("Index Of Refraction", &hairShadingParams.Eta, 1.2f, 2.0f);
+			if (ImGui::Button("Bake Shading Tables"))
+				CreateHairShading(hairShadingPath);
+			if (hairShadingFromCache)
+				ImGui::Text("Shading tables = loaded from cache");
+			else
+				ImGui::Text("Shading tables = baked in %.1f ms", hairShading.GetBakeMilliseconds());
+		}
+
+		for (int i = 0; i < entities.size(); i++)
+		{
+			std::shared_ptr<Mesh> mesh = entities[i]->GetMesh();
+			std::shared_ptr<HairInstance> hair = entities[i]->GetHair();
+			if (!hair)
+				continue;
+			ImGui::PushID(i);
+			std::string label = "Entity " + std::to_string(i + 1);
+			if (ImGui::TreeNode(label.c_str()))
+			{
+				int slots = hair->GetStateSlotCount();
+				int latency = hair->GetFrameLatency();
+				bool changed = ImGui::SliderInt("State Slots", &slots, 2, HAIR_MAX_STATE_SLOTS);
+				changed |= ImGui::SliderInt("Frame Latency", &latency, 0, slots - 1);
+				if (changed)
+					mesh->SetHairStateRing(device, context, *hair, slots, latency);
+
+				// Segments, density, guides, solver settings and collision belong to the groom, shared by every entity using the mesh
+
+				int segments = mesh->GetHairSegmentCount();
+				if (ImGui::SliderInt("Segments", &segments, 1, HAIR_MAX_VERTS_PER_STRAND - 1))
+					mesh->SetHairSegmentCount(device, context, segments);
+
+				// Regrowing is slow, so only when the value is entered
+				float density = mesh->GetHairDensity();
+				if (ImGui::InputFloat("Strands Per Unit Area", &density, 10.0f, 100.0f, "%.0f", ImGuiInputTextFlags_EnterReturnsTrue))
+					mesh->SetHairDensity(device, context, density);
+
+				int guideRatio = mesh->GetHairGuideRatio();
+				if (ImGui::SliderInt("Guide Ratio", &guideRatio, 1, HAIR_MAX_GUIDE_RATIO))
+					mesh->SetHairGuideRatio(device, guideRatio);
+				ImGui::Text("Simulated strands = %d of %d", mesh->GetHairGuideCount(), mesh->GetHairStrandCount());
+				ImGui::Text("Groom = %s%s", mesh->GetHairFromGroomCache() ? "mapped from baked cache" : "generated", mesh->GetHairGroomDirty() ? ", not baked yet" : "");
+				// Also baked at shutdown
+				if (mesh->GetHairGroomDirty())
+				{
+					ImGui::SameLine();
+					if (ImGui::Button("Bake Groom"))
+						mesh->BakeHairGroom(device, context);
+				}
+				ImGui::Text("Shared groom = %.1f KB, this entity's state ring = %.1f KB packed, +-%.3f around the roots",
+					mesh->GetHairGroomBytes() / 1024.0f, hair->GetStateBytes() / 1024.0f, mesh->GetHairStateScale());
+				ImGui::Text("Awake strands = %d, steps skipped asleep = %d", hair->GetActiveStrandCount(), hair->GetSkippedSteps());
+
+				HairStepScheduler& scheduler = hair->GetStepScheduler();
+				int stepRate = (int)(1.0f / scheduler.GetFixedStep() + 0.5f);
+				if (ImGui::SliderInt("Steps Per Second", &stepRate, 30, 240))
+					scheduler.SetFixedStep(1.0f / stepRate);
+				int maxSubsteps = scheduler.GetMaxSubsteps();
+				if (ImGui::SliderInt("Max Substeps", &maxSubsteps, 1, 8))
+					scheduler.SetMaxSubsteps(maxSubsteps);
+				ImGui::Text("Substeps this frame = %d, interpolation = %.2f, dropped = %.2fs", scheduler.GetSubsteps(), scheduler.GetInterpolation(), scheduler.GetDroppedTime());
+
+				int forcedLOD = hair->GetForcedLOD();
+				if (ImGui::SliderInt("Forced LOD (-1 = auto)", &forcedLOD, -1, HAIR_LOD_LEVELS - 1))
+					hair->SetForcedLOD(forcedLOD);
+				ImGui::Text("LOD %d, projected size = %.3f", hair->GetLOD(), hair->GetProjectedSize());
+				bool clusterCulling = hair->GetClusterCulling();
+				if (ImGui::Checkbox("Cluster Culling", &clusterCulling))
+					hair->SetClusterCulling(clusterCulling);
+				ImGui::Text("Visible clusters = %d of %d, %d strands each", hair->GetClusters().GetVisibleCount(), hair->GetClusters().GetClusterCount(), hair->GetClusters().GetClusterSize());
+				int forcedTessellation = hair->GetForcedTessellation();
+				if (ImGui::SliderInt("Forced Tessellation (-1 = auto)", &forcedTessellation, -1, HAIR_MAX_TESSELLATION))
+					hair->SetForcedTessellation(forcedTessellation == 0 ? -1 : forcedTessellation);
+				ImGui::Text("Tessellation = %d pieces per segment", mesh->GetHairTessellation(*hair));
+				for (int level = 0; level < HAIR_LOD_LEVELS; level++)
+				{
+					const HairLODLevel& lod = mesh->GetHairLODLevel(level);
+					ImGui::Text("%s LOD %d: %d drawn, %d simulated, %d segments, %d triangles, width x%.1f",
+						level == hair->GetLOD() ? ">" : " ", level, lod.drawnStrands, lod.simulatedStrands, lod.segments, lod.vertexCount / 3, lod.widthScale);
+				}
+
+				HairSolverSettings& settings = mesh->GetHairSolverSettings();
+				bool settingsChanged = ImGui::SliderInt("Iterations", &settings.Iterations, 1, 16);
+				settingsChanged |= ImGui::SliderFloat("Damping", &settings.Damping, 0.0f, 1.0f);
+				settingsChanged |= ImGui::SliderFloat("Distance Stiffness", &settings.DistanceStiffness, 0.0f, 1.0f);
+				settingsChanged |= ImGui::SliderFloat("Bend Stiffness", &settings.BendStiffness, 0.0f, 1.0f);
+				settingsChanged |= ImGui::SliderFloat("Shape Stiffness", &settings.ShapeStiffness, 0.0f, 1.0f);
+				settingsChanged |= ImGui::SliderFloat("Inertia", &settings.Inertia, 0.0f, 2.0f);
+				settingsChanged |= ImGui::SliderFloat("Wind Drag", &settings.WindDrag, 0.0f, 10.0f);
+				settingsChanged |= ImGui::SliderFloat("Volume Pressure", &settings.VolumePressure, 0.0f, 2.0f);
+				settingsChanged |= ImGui::SliderFloat("Volume Friction", &settings.VolumeFriction, 0.0f, 1.0f);
+				ImGui::Text("Inertial acceleration = %.2f", hair->GetInertialAcceleration());
+				if (settingsChanged)
+					mesh->WakeHair();
+
+				bool collision = mesh->GetHairCollision();
+				if (ImGui::Checkbox("Mesh Collision", &collision))
+					mesh->SetHairCollision(collision);
+				// Rebaking is slow, so only when the value is entered
+				int collisionResolution = mesh->GetHairCollisionResolution();
+				if (ImGui::InputInt("Collision Resolution", &collisionResolution, 8, 32, ImGuiInputTextFlags_EnterReturnsTrue))
+					mesh->SetHairCollisionResolution(device, collisionResolution);
+				if (mesh->GetHairCollisionFromCache())
+					ImGui::Text("Collision field = loaded from cache");
+				else
+					ImGui::Text("Collision field = baked in %.1f ms", mesh->GetHairCollisionBakeMilliseconds());
+
+				// Both stall on a state readback every HAIR_RECORD_CHECKSUM_INTERVAL frames
+				if (hair->GetRecording())
+				{
+					if (ImGui::Button("Stop Recording"))
+						hair->StopRecording();
+					ImGui::SameLine();
+					ImGui::Text("Recorded %d frames", hair->GetRecordedFrames());
+				}
+				else if (hair->GetReplaying())
+				{
+					if (ImGui::Button("Stop Replay"))
+						hair->StopReplay();
+				}
+				else
+				{
+					if (ImGui::Button("Record"))
+						mesh->StartHairRecording(device, context, *hair);
+					ImGui::SameLine();
+					if (ImGui::Button("Replay"))
+						mesh->StartHairReplay(device, context, *hair);
+					ImGui::SameLine();
+					// The first run keeps the CPU's own checksums, every run after that is checked against them
+					if (ImGui::Button("Replay On CPU"))
+					{
+						HairReplay baseline;
+						bool hasBaseline = baseline.Open(hair->GetCPURecordingPath());
+						baseline.Close();
+						hairCPUReplay = hasBaseline ? HairReplay::RunCPU(hair->GetCPURecordingPath()) :
+							HairReplay::RunCPU(hair->GetRecordingPath(), hair->GetCPURecordingPath());
+					}
+				}
+				const HairReplayResult& replay = hair->GetReplayResult();
+				if (replay.rejected || hairCPUReplay.rejected)
+					ImGui::Text("Replay stopped at a frame below LOD 0");
+				if (replay.frames > 0)
+					ImGui::Text("GPU replay: %d frames, %d steps, %d of %d checksums wrong (first after frame %d)",
+						replay.frames, replay.steps, replay.mismatches, replay.checksums, replay.firstMismatchFrame);
+				if (hairCPUReplay.frames > 0)
+					ImGui::Text("CPU replay: %d frames, %d steps at %.3f ms, %d of %d checksums wrong (first after frame %d)",
+						hairCPUReplay.frames, hairCPUReplay.steps, hairCPUReplay.millisecondsPerStep, hairCPUReplay.mismatches, hairCPUReplay.checksums, hairCPUReplay.firstMismatchFrame);
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+	}
 	ImGui::End();
 	ImGui::Render();
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
@@ -460,6 +693,42 @@ void Renderer::CreatePostProcessResources()
 
 }
 
+void Renderer::CreateHairShading(std::string cachePath)
+{
+	hairShadingPath = cachePath;
+	hairShadingFromCache = !cachePath.empty() && hairShading.Load(cachePath, hairShadingParams);
+	if (!hairShadingFromCache)
+	{
+		hairShading.Bake(hairShadingParams);
+		if (!cachePath.empty())
+			hairShading.Save(cachePath);
+	}
+
+	// Immutable, so baking the tables again replaces the textures and their views
+	auto createLUT = [&](const void* texels, DXGI_FORMAT format, unsigned int texelSize, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+	{
+		D3D11_TEXTURE2D_DESC texDesc = {};
+		texDesc.Width = hairShading.GetSize();
+		texDesc.Height = hairShading.GetSize();
+		texDesc.ArraySize = 1;
+		texDesc.MipLevels = 1;
+		texDesc.Format = format;
+		texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		texDesc.SampleDesc.Count = 1;
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = texels;
+		data.SysMemPitch = texelSize * hairShading.GetSize();
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		device->CreateTexture2D(&texDesc, &data, texture.GetAddressOf());
+		device->CreateShaderResourceView(texture.Get(), 0, srv.ReleaseAndGetAddressOf());
+	};
+	createLUT(hairShading.GetLongitudinalTable().data(), DXGI_FORMAT_R32G32B32A32_FLOAT, sizeof(XMFLOAT4), hairLongitudinalLUT);
+	createLUT(hairShading.GetAzimuthalTable().data(), DXGI_FORMAT_R32G32B32A32_FLOAT, sizeof(XMFLOAT4), hairAzimuthalLUT);
+	createLUT(hairShading.GetColorBlendTable().data(), DXGI_FORMAT_R32_FLOAT, sizeof(float), hairColorBlendLUT);
+}
+
 void Renderer::DrawPointLights(std::shared_ptr<Camera> camera)
 {
 	Assets* instance = &Assets::GetInstance();
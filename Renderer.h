@@ -12,8 +12,15 @@
 #include "Emitter.h"
 #include "Sky.h"
 #include "Terrain.h"
+#include "WindField.h"
+#include "HairSimulator.h"
+#include "HairBenchmark.h"
+#include "HairParallelSimulator.h"
+#include "HairShading.h"
+#include "HairRegression.h"
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
+#include <future>
 
 enum RenderTargetType
 { 
@@ -29,7 +36,7 @@ class Renderer
 {
 public:
 	Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain, Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV,
-		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::shared_ptr<Terrain> terrainPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::shared_ptr<Terrain> terrainPTR, std::shared_ptr<WindField> windPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
 		std::vector<Light>& Lights, HWND hWnd);
 	~Renderer();
 	void PreResize();
@@ -38,6 +45,11 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV, Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV);
 
 	void Render(std::shared_ptr<Camera> camera, std::vector<std::shared_ptr<Material>> materials, float deltaTime);
+
+	// Hair shading lookup tables, from the cache at this path if they were baked with the same parameters
+	void CreateHairShading(std::string cachePath);
+	// Where the hair regression finds its models and keeps their golden states
+	void SetHairRegressionFolder(std::string folder) { hairRegressionFolder = folder; }
 private:
 
 	void DrawPointLights(std::shared_ptr<Camera> camera);
@@ -61,6 +73,7 @@ private:
 	int motionBlurMax;
 	std::shared_ptr<Sky> sky;
 	std::shared_ptr<Terrain> terrain;
+	std::shared_ptr<WindField> wind;
 	std::vector<std::shared_ptr<GameEntity>>& entities;
 	std::vector<std::shared_ptr<Emitter>>& emitters;
 	std::vector<Light>& lights;
@@ -80,5 +93,27 @@ private:
 
 	const float frequencyOptions[3] = { 1.0f, 3.0f, 7.0f };
 	float frequency;
+
+	unsigned int lastHairBufferAllocations = 0;
+	// The CPU solver measurements take seconds, they run on their own thread and show up once done
+	std::future<HairBenchmarkResult> hairBenchmarkTask;
+	HairBenchmarkResult hairBenchmark = {};
+	std::future<HairQuantizationResult> hairQuantizationTask;
+	HairQuantizationResult hairQuantization = {};
+	std::future<HairScalingResult> hairScalingTask;
+	HairScalingResult hairScaling = {};
+	HairReplayResult hairCPUReplay = {};
+	std::string hairRegressionFolder;
+	std::future<std::vector<HairRegressionResult>> hairRegressionTask;
+	std::vector<HairRegressionResult> hairRegression;
+
+	HairShading hairShading;
+	HairShadingParams hairShadingParams = HairShading::GetDefaultParams();
+	int hairShadingModel = HAIR_SHADING_MARSCHNER;
+	bool hairShadingFromCache = false;
+	std::string hairShadingPath;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairLongitudinalLUT;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairAzimuthalLUT;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> hairColorBlendLUT;
 };
 
@@ -0,0 +1,21 @@
+#include "HairShared.h"
+
+// Fixed point sums from SplatHairVoxels
+RWByteAddressBuffer voxelCells	: register(u0);
+// x = density, yzw = average velocity, sampled by SimulateHair
+RWTexture3D<float4> voxelField	: register(u1);
+
+// One thread per cell, clears it for the next step once it's read
+[numthreads(HAIR_VOXEL_GROUP_SIZE, HAIR_VOXEL_GROUP_SIZE, HAIR_VOXEL_GROUP_SIZE)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (any(DTid >= HAIR_VOXEL_RESOLUTION))
+		return;
+
+	uint address = ((DTid.z * HAIR_VOXEL_RESOLUTION + DTid.y) * HAIR_VOXEL_RESOLUTION + DTid.x) * 16;
+	float4 sums = (float4)asint(voxelCells.Load4(address)) / HAIR_VOXEL_FIXED_POINT;
+	voxelCells.Store4(address, uint4(0, 0, 0, 0));
+
+	float3 velocity = sums.x > 0 ? sums.yzw / sums.x : 0;
+	voxelField[DTid] = float4(max(sums.x, 0), velocity);
+}
@@ -1,42 +1,201 @@
 #include "HairGenerics.hlsli"
 #include "HairPhysicsHelper.hlsli"
+#include "WindField.hlsli"
 
 cbuffer HAIR_PHYSICS_CONSTANT	: register(b0)
 {
+	matrix inertia;			// Pseudo acceleration from the entity's motion, already scaled (see HairExternalForces)
+	matrix world;			// Wind is sampled in world space and brought back with worldInverse
+	matrix worldInverse;
+	float3 windScroll;
+	float windTurbulence;
+	float3 windVelocity;
+	float windDrag;			// 0 without a wind field
+	float3 collisionMin;	// Corner of the collision field in object space
+	float collisionSize;	// Edge length of the (cubic) collision field
+	float collisionMargin;
+	int useCollision;
+	float3 voxelMin;		// Corner of the hair-hair voxel grid in object space
+	float voxelCellSize;
+	float volumePressure;	// Both 0 when the grid wasn't filled this step
+	float volumeFriction;
+	float stateScale;		// See HairPacking.h
 	float3 force;
 	float deltaTime;
+	int numOfGuides;		// Guides simulated at this LOD
+	int guideStep;			// Every guideStep'th entry of guideStrands
+	int vertsPerStrand;
+	int lodSegments;		// Only these vertices of the strand are solved, see LODVertex
+	int useActiveList;		// 1 = only the strands still awake last step, dispatched indirectly
+	int clusterStrands;		// Strands per cluster, see HairClusters
+	int iterations;
+	float damping;
+	// Already adjusted for the iteration count on the CPU
+	float distanceStiffness;
+	float bendStiffness;
+	float shapeStiffness;
 }
 
-RWStructuredBuffer<HairStrand> hairData	: register(u0);
+// Last step's state in, this step's state out (ping-pong slots, see Mesh::SimulateHair)
+StructuredBuffer<HairPackedVertex> prevHairData	: register(t0);
+StructuredBuffer<HairRestVertex> restData	: register(t1);
+StructuredBuffer<int> guideStrands	: register(t2);
+StructuredBuffer<int> activeStrands	: register(t3);
+ByteAddressBuffer activeCount	: register(t4);
+Texture3D<float4> windField	: register(t5);
+Texture3D<float> collisionField	: register(t6);
+Texture3D<float4> voxelField	: register(t7);
+StructuredBuffer<uint> physicsTable	: register(t8);	// HairPackPhysics per vertex
+StructuredBuffer<uint> clusterVisibility	: register(t9);	// 0 = culled this frame
+SamplerState windSampler	: register(s0);
+SamplerState clampSampler	: register(s1);
+RWStructuredBuffer<HairPackedVertex> hairData	: register(u0);
+// Steps in a row each strand has barely moved, and the strands that are still awake after this step
+RWStructuredBuffer<uint> sleepSteps	: register(u1);
+AppendStructuredBuffer<int> nextActiveStrands	: register(u2);
 
-[numthreads(8, 8, 1)]
+// One thread per guide strand, the whole strand lives in registers while solving.
+// Followers are filled in afterwards by InterpolateHair
+[numthreads(HAIR_SIMULATE_GROUP_SIZE, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-	//Figure out if we're a base vertex
-	//ALTERNATIVE: Don't figure it out? with correct calculations we shouldn't move
-	int index = DTid.x;
-	HairStrand strandInfo = hairData[index];
+	int strand;
+	if (useActiveList)
+	{
+		if (DTid.x >= activeCount.Load(0))
+			return;
+		strand = activeStrands[DTid.x];
+	}
+	else
+	{
+		if ((int)DTid.x >= numOfGuides)
+			return;
+		strand = guideStrands[DTid.x * guideStep];
+	}
+	int lodVerts = lodSegments + 1;
 
-	float2x3 constraints[5] = { 
+	int first = strand * vertsPerStrand;
+	float3 root = restData[first].OriginalPosition;
+
+	// Culled: nothing solved, the strand carries over standing still and falls asleep like a resting one.
+	// Every vertex, not just this LOD's, or the ones in between keep whatever this slot held before
+	if (!clusterVisibility[strand / clusterStrands])
+	{
+		for (int c = 0; c < vertsPerStrand; c++)
+		{
+			int vert = first + c;
+			float3 position = HairUnpackVertex(prevHairData[vert], root, stateScale).Position;
+			hairData[vert] = HairPackVertex(position, position, root, stateScale);
+		}
+		uint culledSteps = sleepSteps[strand] + 1;
+		sleepSteps[strand] = culledSteps;
+		if (culledSteps < HAIR_SLEEP_STEPS)
+			nextActiveStrands.Append(strand);
+		return;
+	}
+
+	float3 positions[HAIR_MAX_VERTS_PER_STRAND];
+	float3 prevPositions[HAIR_MAX_VERTS_PER_STRAND];
+	float3 restPositions[HAIR_MAX_VERTS_PER_STRAND];
+	HairVertexPhysics physics[HAIR_MAX_VERTS_PER_STRAND];
+
+	float3 externalAcceleration = force * HAIR_FORCE_ACCELERATION;
+	float maxExternal = 0;
+	for (int i = 0; i < lodVerts; i++)
+	{
+		int vert = first + LODVertex(i, lodSegments, vertsPerStrand);
+		HairSimVertex vertex = HairUnpackVertex(prevHairData[vert], root, stateScale);
+		positions[i] = vertex.Position;
+		prevPositions[i] = vertex.PreviousPosition;
+		restPositions[i] = restData[vert].OriginalPosition;
+		physics[i] = HairUnpackPhysics(physicsTable[vert]);
+
+		// Pushed apart from and dragged along with the hair around it, the pinned root excepted
+		if (i > 0 && (volumePressure > 0 || volumeFriction > 0))
+		{
+			float3 uvw = (positions[i] - voxelMin) / (voxelCellSize * HAIR_VOXEL_RESOLUTION);
+			SolveVolume(positions[i], prevPositions[i], uvw, 1.0f / HAIR_VOXEL_RESOLUTION, voxelCellSize, volumePressure, volumeFriction, deltaTime, voxelField, clampSampler);
+		}
+
+		// Uploaded untransposed like the world matrix, so it goes on the left the same way
+		float3 inertialAcceleration = mul(inertia, float4(restPositions[i], 1.0f)).xyz;
+
+		// Drag towards the wind's velocity, relative to how the vertex is already moving
+		float3 windAcceleration = 0;
+		if (windDrag > 0)
 		{
-			strandInfo.OriginalPosition.x, strandInfo.OriginalPosition.y, strandInfo.OriginalPosition.z,
-			strandInfo.OriginalPosition.x, strandInfo.OriginalPosition.y, strandInfo.OriginalPosition.z
-		}, {
-			strandInfo.OriginalPosition.x - 0.05f, strandInfo.OriginalPosition.y - 0.05f, strandInfo.OriginalPosition.z - 0.05f,
-			strandInfo.OriginalPosition.x + 0.05f, strandInfo.OriginalPosition.y + 0.05f, strandInfo.OriginalPosition.z + 0.05f
-		}, {
-			strandInfo.OriginalPosition.x, strandInfo.OriginalPosition.y, strandInfo.OriginalPosition.z,
-			strandInfo.OriginalPosition.x, strandInfo.OriginalPosition.y, strandInfo.OriginalPosition.z
-		}, {
-			strandInfo.OriginalPosition.x - 0.05f, strandInfo.OriginalPosition.y - 0.05f, strandInfo.OriginalPosition.z - 0.05f,
-			strandInfo.OriginalPosition.x + 0.05f, strandInfo.OriginalPosition.y + 0.05f, strandInfo.OriginalPosition.z + 0.05f
-		}, {
-			strandInfo.OriginalPosition.x - 0.2f, strandInfo.OriginalPosition.y - 0.2f, strandInfo.OriginalPosition.z - 0.2f,
-			strandInfo.OriginalPosition.x + 0.2f, strandInfo.OriginalPosition.y + 0.2f, strandInfo.OriginalPosition.z + 0.2f
-		} 
-	};
-	float2x3 constraint = constraints[index % 5];
-	strandInfo = SimulateHair(strandInfo, force, deltaTime, constraint);
-
-	hairData[index] = strandInfo;
-}
\ No newline at end of file
+			float3 worldPos = mul(world, float4(positions[i], 1.0f)).xyz;
+			float3 wind = mul((float3x3)worldInverse, SampleWind(windField, windSampler, worldPos, windScroll, windVelocity, windTurbulence));
+			windAcceleration = (wind - (positions[i] - prevPositions[i]) / deltaTime) * windDrag;
+		}
+
+		maxExternal = max(maxExternal, length(inertialAcceleration + windAcceleration));
+		float3 acceleration = externalAcceleration + inertialAcceleration + windAcceleration;
+		VerletIntegrate(positions[i], prevPositions[i], acceleration, min(damping * physics[i].Damping, 1.0f), deltaTime);
+	}
+
+	// Root pin
+	positions[0] = restPositions[0];
+	prevPositions[0] = restPositions[0];
+
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int j = 1; j < lodVerts; j++)
+			positions[j] = SolveShape(positions[j], restPositions[j], min(shapeStiffness * physics[j].Stiffness, 1.0f));
+
+		// The root has no inverse mass, so it never moves
+		for (int k = 0; k < lodVerts - 1; k++)
+		{
+			float restLength = length(restPositions[k + 1] - restPositions[k]) * physics[k + 1].LengthScale;
+			SolveDistance(positions[k], positions[k + 1], restLength, k == 0 ? 0.0f : 1.0f, 1.0f, distanceStiffness);
+		}
+
+		for (int b = 0; b < lodVerts - 2; b++)
+		{
+			float restLength = length(restPositions[b + 2] - restPositions[b]) * physics[b + 2].LengthScale;
+			SolveDistance(positions[b], positions[b + 2], restLength, b == 0 ? 0.0f : 1.0f, 1.0f, min(bendStiffness * physics[b + 2].Stiffness, 1.0f));
+		}
+
+		for (int p = 1; p < lodVerts; p++)
+			positions[p] = SolveShape(positions[p], restPositions[p], physics[p].PinWeight);
+
+		// Last, so nothing ends the iteration inside the mesh
+		if (useCollision)
+		{
+			uint fieldResolution, fieldHeight, fieldDepth;
+			collisionField.GetDimensions(fieldResolution, fieldHeight, fieldDepth);
+			for (int c = 1; c < lodVerts; c++)
+			{
+				float3 uvw = (positions[c] - collisionMin) / collisionSize;
+				positions[c] = SolveCollision(positions[c], uvw, 1.0f / fieldResolution, collisionMargin, collisionField, clampSampler);
+			}
+		}
+	}
+
+	// The vertices this LOD skips follow the solved ones around, keeping their rest offset from the
+	// segment they sit on. Otherwise they'd be left where they were and pop once the LOD goes back up
+	float maxMotion = 0;
+	for (int v = 0; v < lodVerts; v++)
+	{
+		int vert = LODVertex(v, lodSegments, vertsPerStrand);
+		hairData[first + vert] = HairPackVertex(positions[v], prevPositions[v], root, stateScale);
+		maxMotion = max(maxMotion, length(positions[v] - prevPositions[v]));
+
+		int nextVert = v < lodSegments ? LODVertex(v + 1, lodSegments, vertsPerStrand) : vert;
+		for (int s = vert + 1; s < nextVert; s++)
+		{
+			float t = (float)(s - vert) / (nextVert - vert);
+			float3 restOffset = restData[first + s].OriginalPosition - lerp(restPositions[v], restPositions[v + 1], t);
+			float3 position = lerp(positions[v], positions[v + 1], t) + restOffset;
+			float3 prevPosition = lerp(prevPositions[v], prevPositions[v + 1], t) + restOffset;
+			hairData[first + s] = HairPackVertex(position, prevPosition, root, stateScale);
+		}
+	}
+
+	// Any outside force, wind or noticeable inertia keeps everything awake
+	bool quiet = maxMotion < HAIR_SLEEP_DISTANCE && !any(force) && maxExternal * deltaTime * deltaTime < HAIR_SLEEP_DISTANCE;
+	uint quietSteps = quiet ? sleepSteps[strand] + 1 : 0;
+	sleepSteps[strand] = quietSteps;
+	if (quietSteps < HAIR_SLEEP_STEPS)
+		nextActiveStrands.Append(strand);
+}
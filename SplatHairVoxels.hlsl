@@ -0,0 +1,57 @@
+#include "HairGenerics.hlsli"
+#include "HairShared.h"
+
+cbuffer HAIR_VOXEL_CONSTANT	: register(b0)
+{
+	float3 voxelMin;		// Corner of the grid in object space
+	float voxelCellSize;
+	float deltaTime;
+	int numOfGuides;		// Same guides and vertices SimulateHair solves at this LOD
+	int guideStep;
+	int vertsPerStrand;
+	int lodSegments;
+	float stateScale;		// See HairPacking.h
+}
+
+StructuredBuffer<HairPackedVertex> hairData	: register(t0);
+StructuredBuffer<int> guideStrands	: register(t1);
+StructuredBuffer<HairRestVertex> restData	: register(t2);
+// Four fixed point ints per cell: density, then momentum. ResolveHairVoxels empties it again
+RWByteAddressBuffer voxelCells	: register(u0);
+
+// One thread per simulated vertex, spread over the 8 cells around it.
+// Asleep strands are splatted too so the awake ones still bump into them
+[numthreads(64, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	int lodVerts = lodSegments + 1;
+	int guide = DTid.x / lodVerts;
+	if (guide >= numOfGuides)
+		return;
+
+	int strand = guideStrands[guide * guideStep];
+	int first = strand * vertsPerStrand;
+	HairSimVertex vertex = HairUnpackVertex(hairData[first + LODVertex(DTid.x % lodVerts, lodSegments, vertsPerStrand)], restData[first].OriginalPosition, stateScale);
+	float3 velocity = (vertex.Position - vertex.PreviousPosition) / deltaTime;
+
+	// Cell centres are at +0.5, like the texture ResolveHairVoxels writes
+	float3 gridPos = (vertex.Position - voxelMin) / voxelCellSize - 0.5f;
+	int3 baseCell = (int3)floor(gridPos);
+	float3 fraction = gridPos - baseCell;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		int3 offset = int3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+		int3 cell = baseCell + offset;
+		if (any(cell < 0) || any(cell >= HAIR_VOXEL_RESOLUTION))
+			continue;
+
+		float3 weights = offset ? fraction : 1.0f - fraction;
+		float weight = weights.x * weights.y * weights.z;
+		uint address = ((cell.z * HAIR_VOXEL_RESOLUTION + cell.y) * HAIR_VOXEL_RESOLUTION + cell.x) * 16;
+		int4 fixedPoint = (int4)round(float4(weight, velocity * weight) * HAIR_VOXEL_FIXED_POINT);
+		voxelCells.InterlockedAdd(address, fixedPoint.x);
+		voxelCells.InterlockedAdd(address + 4, fixedPoint.y);
+		voxelCells.InterlockedAdd(address + 8, fixedPoint.z);
+		voxelCells.InterlockedAdd(address + 12, fixedPoint.w);
+	}
+}
@@ -0,0 +1,70 @@
+#include "HairGenerics.hlsli"
+
+cbuffer HAIR_CLUSTER_CONSTANT	: register(b0)
+{
+	int numOfStrands;
+	int vertsPerStrand;
+	int clusterStrands;		// Strands per cluster, see HairClusters
+	float stateScale;		// See HairPacking.h
+}
+
+StructuredBuffer<HairPackedVertex> hairData	: register(t0);
+StructuredBuffer<HairRestVertex> restData	: register(t1);
+
+// Must match HairClusterBounds in HairClusters.h
+struct HairClusterBounds
+{
+	float3 Min;
+	float Padding0;
+	float3 Max;
+	float Padding1;
+};
+RWStructuredBuffer<HairClusterBounds> clusterBounds	: register(u0);
+
+groupshared float3 groupMin[HAIR_CLUSTER_GROUP_SIZE];
+groupshared float3 groupMax[HAIR_CLUSTER_GROUP_SIZE];
+
+// One group per cluster, each thread boxes a few of its strands then the group merges the boxes
+[numthreads(HAIR_CLUSTER_GROUP_SIZE, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
+{
+	int first = Gid.x * clusterStrands;
+	int end = min(first + clusterStrands, numOfStrands);
+
+	float3 boundsMin = 3.402823466e+38f;
+	float3 boundsMax = -3.402823466e+38f;
+	for (int strand = first + (int)GI; strand < end; strand += HAIR_CLUSTER_GROUP_SIZE)
+	{
+		int root = strand * vertsPerStrand;
+		float3 rootPosition = restData[root].OriginalPosition;
+		for (int v = 0; v < vertsPerStrand; v++)
+		{
+			float3 position = HairUnpackVertex(hairData[root + v], rootPosition, stateScale).Position;
+			boundsMin = min(boundsMin, position);
+			boundsMax = max(boundsMax, position);
+		}
+	}
+	groupMin[GI] = boundsMin;
+	groupMax[GI] = boundsMax;
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint stride = HAIR_CLUSTER_GROUP_SIZE / 2; stride > 0; stride >>= 1)
+	{
+		if (GI < stride)
+		{
+			groupMin[GI] = min(groupMin[GI], groupMin[GI + stride]);
+			groupMax[GI] = max(groupMax[GI], groupMax[GI + stride]);
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (GI == 0)
+	{
+		HairClusterBounds bounds;
+		bounds.Min = groupMin[0];
+		bounds.Padding0 = 0;
+		bounds.Max = groupMax[0];
+		bounds.Padding1 = 0;
+		clusterBounds[Gid.x] = bounds;
+	}
+}
@@ -0,0 +1,79 @@
+#include "HairGenerics.hlsli"
+
+cbuffer HAIR_ROOT_CONSTANT	: register(b0)
+{
+	int numOfStrands;
+	int vertsPerStrand;
+}
+
+// Must match Vertex.h
+struct SurfaceVertex
+{
+	float3 Position;
+	float2 UV;
+	float3 Normal;
+	float3 Tangent;
+};
+
+// Must match ShaderVertex.h
+struct ShaderVertex
+{
+	float3 Position;
+	float3 Normal;
+	float3 Tangent;
+	float2 UV;
+	float padding;
+};
+
+StructuredBuffer<SurfaceVertex> surfaceVerts	: register(t0);	// The surface as it is now
+StructuredBuffer<uint> surfaceIndices	: register(t1);
+StructuredBuffer<HairRootBinding> rootBindings	: register(t2);
+StructuredBuffer<ShaderVertex> boundRoots	: register(t3);	// The roots as the hair was grown
+StructuredBuffer<HairRestVertex> boundRest	: register(t4);	// The rest pose as the hair was grown
+RWStructuredBuffer<HairRestVertex> restData	: register(u0);
+
+// Normal, tangent and bitangent as the rows, the tangent made perpendicular to the normal
+float3x3 RootFrame(float3 normal, float3 tangent)
+{
+	normal = normalize(normal);
+	tangent -= normal * dot(normal, tangent);
+	if (dot(tangent, tangent) < 0.000001f)
+		tangent = cross(normal, abs(normal.x) < 0.9f ? float3(1, 0, 0) : float3(0, 1, 0));
+	tangent = normalize(tangent);
+	return float3x3(normal, tangent, cross(normal, tangent));
+}
+
+// One thread per strand: the root's triangle is evaluated where the surface is now, and the
+// strand's rest pose is carried along from the frame it was grown in to the frame there now.
+// The state ring is stored relative to the roots, so the simulated hair follows by itself
+[numthreads(64, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	int strand = DTid.x;
+	if (strand >= numOfStrands)
+		return;
+
+	HairRootBinding binding = rootBindings[strand];
+	SurfaceVertex v0 = surfaceVerts[surfaceIndices[binding.Triangle * 3]];
+	SurfaceVertex v1 = surfaceVerts[surfaceIndices[binding.Triangle * 3 + 1]];
+	SurfaceVertex v2 = surfaceVerts[surfaceIndices[binding.Triangle * 3 + 2]];
+	float3 b = binding.Barycentrics;
+	float3 root = v0.Position * b.x + v1.Position * b.y + v2.Position * b.z;
+	float3x3 frame = RootFrame(v0.Normal * b.x + v1.Normal * b.y + v2.Normal * b.z, v0.Tangent * b.x + v1.Tangent * b.y + v2.Tangent * b.z);
+
+	ShaderVertex bound = boundRoots[strand];
+	float3x3 boundFrame = RootFrame(bound.Normal, bound.Tangent);
+
+	// Into the bound frame's coordinates, then back out of the current one
+	float3x3 rotation = mul(transpose(frame), boundFrame);
+
+	int first = strand * vertsPerStrand;
+	for (int v = 0; v < vertsPerStrand; v++)
+	{
+		HairRestVertex rest = boundRest[first + v];
+		rest.OriginalPosition = root + mul(rotation, rest.OriginalPosition - bound.Position);
+		rest.Normal = mul(rotation, rest.Normal);
+		rest.Tangent = mul(rotation, rest.Tangent);
+		restData[first + v] = rest;
+	}
+}
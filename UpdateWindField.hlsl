@@ -0,0 +1,23 @@
+#include "WindField.hlsli"
+
+cbuffer WIND_UPDATE_CONSTANT	: register(b0)
+{
+	int3 regionMin;		// First cell to write, in unwrapped cell coordinates
+	float frequency;
+	int3 regionSize;
+}
+
+RWTexture3D<float4> windField	: register(u0);
+
+// One thread per cell that scrolled into the grid
+[numthreads(WIND_UPDATE_GROUP_SIZE, WIND_UPDATE_GROUP_SIZE, WIND_UPDATE_GROUP_SIZE)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (any((int3)DTid >= regionSize))
+		return;
+
+	int3 cell = regionMin + (int3)DTid;
+	float3 position = (cell + 0.5f) * WIND_FIELD_CELL_SIZE;
+	uint3 texel = (uint3)(((cell % WIND_FIELD_RESOLUTION) + WIND_FIELD_RESOLUTION) % WIND_FIELD_RESOLUTION);
+	windField[texel] = float4(WindTurbulence(position, frequency), 0);
+}
@@ -0,0 +1,120 @@
+#include "WindField.h"
+#include "Assets.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+WindField::WindField(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	: context(context)
+{
+	settings.Velocity = XMFLOAT3(1.0f, 0, 0);
+	settings.Turbulence = WIND_DEFAULT_TURBULENCE;
+	settings.Frequency = WIND_DEFAULT_FREQUENCY;
+	scroll = XMFLOAT3(0, 0, 0);
+	gridMin = XMINT3(0, 0, 0);
+	gridValid = false;
+	cellsUpdated = 0;
+
+	D3D11_TEXTURE3D_DESC texDesc = {};
+	texDesc.Width = WIND_FIELD_RESOLUTION;
+	texDesc.Height = WIND_FIELD_RESOLUTION;
+	texDesc.Depth = WIND_FIELD_RESOLUTION;
+	texDesc.MipLevels = 1;
+	texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	device->CreateTexture3D(&texDesc, 0, fieldTexture.GetAddressOf());
+	device->CreateUnorderedAccessView(fieldTexture.Get(), 0, fieldUAV.GetAddressOf());
+	device->CreateShaderResourceView(fieldTexture.Get(), 0, fieldSRV.GetAddressOf());
+
+	// Wrapping is what makes the grid scroll for free
+	D3D11_SAMPLER_DESC sampDesc = {};
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	device->CreateSamplerState(&sampDesc, wrapSampler.GetAddressOf());
+}
+
+void WindField::Update(float deltaTime, XMFLOAT3 center)
+{
+	scroll.x += settings.Velocity.x * deltaTime;
+	scroll.y += settings.Velocity.y * deltaTime;
+	scroll.z += settings.Velocity.z * deltaTime;
+
+	// The grid lives where the centre is in the unscrolled gusts
+	XMINT3 newMin(
+		(int)floorf((center.x - scroll.x) / WIND_FIELD_CELL_SIZE) - WIND_FIELD_RESOLUTION / 2,
+		(int)floorf((center.y - scroll.y) / WIND_FIELD_CELL_SIZE) - WIND_FIELD_RESOLUTION / 2,
+		(int)floorf((center.z - scroll.z) / WIND_FIELD_CELL_SIZE) - WIND_FIELD_RESOLUTION / 2);
+	XMINT3 shift(newMin.x - gridMin.x, newMin.y - gridMin.y, newMin.z - gridMin.z);
+	gridMin = newMin;
+	cellsUpdated = 0;
+
+	const int res = WIND_FIELD_RESOLUTION;
+	if (!gridValid || abs(shift.x) >= res || abs(shift.y) >= res || abs(shift.z) >= res)
+	{
+		UpdateCells(gridMin, XMINT3(res, res, res));
+		gridValid = true;
+		return;
+	}
+
+	// One slab per axis for the cells that scrolled in, the corners get written twice
+	if (shift.x != 0)
+		UpdateCells(XMINT3(shift.x > 0 ? gridMin.x + res - shift.x : gridMin.x, gridMin.y, gridMin.z), XMINT3(abs(shift.x), res, res));
+	if (shift.y != 0)
+		UpdateCells(XMINT3(gridMin.x, shift.y > 0 ? gridMin.y + res - shift.y : gridMin.y, gridMin.z), XMINT3(res, abs(shift.y), res));
+	if (shift.z != 0)
+		UpdateCells(XMINT3(gridMin.x, gridMin.y, shift.z > 0 ? gridMin.z + res - shift.z : gridMin.z), XMINT3(res, res, abs(shift.z)));
+}
+
+void WindField::UpdateCells(XMINT3 regionMin, XMINT3 regionSize)
+{
+	std::shared_ptr<SimpleComputeShader> windCS = Assets::GetInstance().GetComputeShader("UpdateWindField");
+	windCS->SetShader();
+	windCS->SetData("regionMin", &regionMin, sizeof(XMINT3));
+	windCS->SetData("regionSize", &regionSize, sizeof(XMINT3));
+	windCS->SetFloat("frequency", settings.Frequency);
+	windCS->SetUnorderedAccessView("windField", fieldUAV);
+	windCS->CopyAllBufferData();
+	windCS->DispatchByThreads(regionSize.x, regionSize.y, regionSize.z);
+	windCS->SetUnorderedAccessView("windField", 0);
+	cellsUpdated += regionSize.x * regionSize.y * regionSize.z;
+}
+
+void WindField::SetShaderWind(ISimpleShader* shader)
+{
+	shader->SetShaderResourceView("windField", fieldSRV);
+	shader->SetSamplerState("windSampler", wrapSampler);
+	shader->SetFloat3("windScroll", scroll);
+	shader->SetFloat3("windVelocity", settings.Velocity);
+	shader->SetFloat("windTurbulence", settings.Turbulence);
+}
+
+XMFLOAT3 WindField::Sample(XMFLOAT3 worldPosition)
+{
+	return WindNoise::Sample(GetState(), worldPosition);
+}
+
+WindState WindField::GetState()
+{
+	WindState state;
+	state.Scroll = scroll;
+	state.Velocity = settings.Velocity;
+	state.Turbulence = settings.Turbulence;
+	state.Frequency = settings.Frequency;
+	return state;
+}
+
+void WindField::SetSettings(WindSettings newSettings)
+{
+	// Every cell was built for the old frequency
+	if (newSettings.Frequency != settings.Frequency)
+		gridValid = false;
+	settings = newSettings;
+	settings.Turbulence = std::max(settings.Turbulence, 0.0f);
+	settings.Frequency = std::max(settings.Frequency, 0.001f);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+
+#include "SimpleShader.h"
+#include "WindShared.h"
+#include "WindNoise.h"
+
+struct WindSettings
+{
+	DirectX::XMFLOAT3 Velocity;	// Mean wind, the gusts are carried along at this speed
+	float Turbulence;				// Strength of the gusts on top of the mean, units/s
+	float Frequency;				// Gusts per unit, changing it rebuilds the whole grid
+};
+
+// --------------------------------------------------------
+// A world space wind velocity field shared by everything
+// that wants wind (hair, particles)
+//
+// The gusts are layered noise that never changes shape, it's
+// carried along by the mean wind instead. The grid around the
+// camera wraps in every direction, so each frame only the cells
+// that scrolled in are regenerated (UpdateWindField.hlsl).
+// --------------------------------------------------------
+class WindField
+{
+public:
+	WindField(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// Moves the gusts along and keeps the grid centred on center
+	void Update(float deltaTime, DirectX::XMFLOAT3 center);
+
+	// windField, windSampler, windScroll, windVelocity and windTurbulence,
+	// for any shader that calls SampleWind() from WindField.hlsli
+	void SetShaderWind(ISimpleShader* shader);
+
+	// SampleWind() on the CPU, straight from the noise instead of the grid
+	DirectX::XMFLOAT3 Sample(DirectX::XMFLOAT3 worldPosition);
+	// Where the gusts are right now, for WindNoise and the CPU hair solver
+	WindState GetState();
+
+	WindSettings GetSettings() { return settings; }
+	void SetSettings(WindSettings newSettings);
+	int GetCellsUpdated() { return cellsUpdated; }
+
+private:
+	void UpdateCells(DirectX::XMINT3 regionMin, DirectX::XMINT3 regionSize);
+
+	WindSettings settings;
+	DirectX::XMFLOAT3 scroll;
+	DirectX::XMINT3 gridMin;		// Unwrapped cell coordinates of the grid's corner
+	bool gridValid;
+	int cellsUpdated;
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> fieldTexture;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> fieldUAV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> fieldSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> wrapSampler;
+};
@@ -0,0 +1,35 @@
+// Include guard
+#ifndef _WINDFIELD_HLSL
+#define _WINDFIELD_HLSL
+#include "HelperMethods.hlsli"
+#include "WindShared.h"
+
+// Gusts around the mean wind, roughly -1 to 1 per axis.
+// WindNoise.cpp has the CPU version, keep them in sync!
+float3 WindTurbulence(float3 position, float frequency)
+{
+	float3 result = 0;
+	float amplitude = 1.0f;
+	for (int octave = 0; octave < WIND_OCTAVES; octave++)
+	{
+		// Three lookups far apart in the noise, one per axis
+		float3 p = position * frequency;
+		float3 layer = float3(noise(p), noise(p + float3(31.7f, 0, 0)), noise(p + float3(0, 47.3f, 0)));
+		result += (layer * 2.0f - 1.0f) * amplitude;
+		frequency *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return result;
+}
+
+/*
+* World space wind velocity at a point, see WindField::SetShaderWind for the parameters.
+* The grid holds the gusts at their scrolled position and wraps, so a wrapping sampler
+* at the unscrolled position finds the right cell without knowing where the grid is
+*/
+float3 SampleWind(Texture3D<float4> field, SamplerState wrapSampler, float3 worldPos, float3 scroll, float3 velocity, float turbulence)
+{
+	float3 uvw = (worldPos - scroll) / (WIND_FIELD_RESOLUTION * WIND_FIELD_CELL_SIZE);
+	return velocity + field.SampleLevel(wrapSampler, uvw, 0).xyz * turbulence;
+}
+#endif
@@ -0,0 +1,51 @@
+#include "WindNoise.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// Same as hash() and noise() in HelperMethods.hlsli
+static float Hash(float n)
+{
+	float s = sinf(n) * 43758.5453f;
+	return s - floorf(s);
+}
+
+static float Noise(XMFLOAT3 x)
+{
+	XMFLOAT3 p(floorf(x.x), floorf(x.y), floorf(x.z));
+	XMFLOAT3 f(x.x - p.x, x.y - p.y, x.z - p.z);
+	f = XMFLOAT3(f.x * f.x * (3.0f - 2.0f * f.x), f.y * f.y * (3.0f - 2.0f * f.y), f.z * f.z * (3.0f - 2.0f * f.z));
+	float n = p.x + p.y * 57.0f + 113.0f * p.z;
+
+	auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	return lerp(lerp(lerp(Hash(n + 0.0f), Hash(n + 1.0f), f.x),
+		lerp(Hash(n + 57.0f), Hash(n + 58.0f), f.x), f.y),
+		lerp(lerp(Hash(n + 113.0f), Hash(n + 114.0f), f.x),
+			lerp(Hash(n + 170.0f), Hash(n + 171.0f), f.x), f.y), f.z);
+}
+
+XMFLOAT3 WindNoise::Sample(const WindState& state, XMFLOAT3 worldPosition)
+{
+	XMFLOAT3 gust = Turbulence(XMFLOAT3(worldPosition.x - state.Scroll.x, worldPosition.y - state.Scroll.y, worldPosition.z - state.Scroll.z), state.Frequency);
+	return XMFLOAT3(
+		state.Velocity.x + gust.x * state.Turbulence,
+		state.Velocity.y + gust.y * state.Turbulence,
+		state.Velocity.z + gust.z * state.Turbulence);
+}
+
+XMFLOAT3 WindNoise::Turbulence(XMFLOAT3 position, float frequency)
+{
+	XMFLOAT3 result(0, 0, 0);
+	float amplitude = 1.0f;
+	for (int octave = 0; octave < WIND_OCTAVES; octave++)
+	{
+		XMFLOAT3 p(position.x * frequency, position.y * frequency, position.z * frequency);
+		result.x += (Noise(p) * 2.0f - 1.0f) * amplitude;
+		result.y += (Noise(XMFLOAT3(p.x + 31.7f, p.y, p.z)) * 2.0f - 1.0f) * amplitude;
+		result.z += (Noise(XMFLOAT3(p.x, p.y + 47.3f, p.z)) * 2.0f - 1.0f) * amplitude;
+		frequency *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "WindShared.h"
+
+// Where the gusts are and how strong, everything SampleWind() in WindField.hlsli gets
+struct WindState
+{
+	DirectX::XMFLOAT3 Scroll;		// How far the gusts have been carried along
+	DirectX::XMFLOAT3 Velocity;		// Mean wind
+	float Turbulence;
+	float Frequency;
+};
+
+// --------------------------------------------------------
+// CPU port of the wind field's noise
+//
+// Only depends on DirectXMath, so the CPU hair solver can
+// sample the same gusts as WindField without a device.
+// Samples the noise directly instead of the grid, so it's
+// what the GPU's trilinear lookup approximates.
+// --------------------------------------------------------
+class WindNoise
+{
+public:
+	// World space wind velocity at a point, SampleWind() straight from the noise
+	static DirectX::XMFLOAT3 Sample(const WindState& state, DirectX::XMFLOAT3 worldPosition);
+
+	// Port of WindTurbulence()
+	static DirectX::XMFLOAT3 Turbulence(DirectX::XMFLOAT3 position, float frequency);
+};
@@ -0,0 +1,22 @@
+// --------------------------------------------------------
+// Wind field constants shared between C++ and HLSL
+//
+// Only preprocessor defines in here so both compilers
+// can include it - no types or functions!
+// --------------------------------------------------------
+#ifndef _WINDSHARED_H
+#define _WINDSHARED_H
+
+// The grid is RESOLUTION^3 cells of CELL_SIZE units, centred on the camera.
+// It wraps around, so scrolling only rewrites the cells that scrolled in
+#define WIND_FIELD_RESOLUTION 32
+#define WIND_FIELD_CELL_SIZE 0.5f
+#define WIND_UPDATE_GROUP_SIZE 4
+
+// Layers of noise() in the gusts, each twice the frequency and half the strength
+#define WIND_OCTAVES 3
+
+#define WIND_DEFAULT_TURBULENCE 1.0f
+#define WIND_DEFAULT_FREQUENCY 0.25f
+
+#endif